@@ -3,857 +3,7536 @@
 #include <stdlib.h>
 #include <stdarg.h>
 #include <ctype.h>
+#include <errno.h>
+#include <stddef.h>
 #include <stdint.h>
+#include <limits.h>
+#include <float.h>
+#include <math.h>
+#include <locale.h>
+#if defined(__APPLE__) || defined(__FreeBSD__)
+#include <xlocale.h>
+#endif
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <vector>
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if __cplusplus >= 202002L
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#endif
+#ifdef MY_SCANF_TEST
+#include <algorithm>
+#include <memory>
+#include <string>
+#ifndef _WIN32
+#include <signal.h>
+#include <sys/socket.h>
+#endif
+#endif
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#ifdef __linux__
+#include <sys/epoll.h>
+#endif
+#endif
 
 // 检查是否为 GB2312 双字节字符的首字节
 static int is_gb2312_lead_byte(unsigned char c) {
 	return (c >= 0xA1 && c <= 0xFE);
 }
 
-// 跳过空白字符（支持 GB2312 的 ASCII 空白）
-static const char* skip_whitespace(const char* p) {
-	while (isspace((unsigned char)*p)) p++;
-	return p;
+// 格式编译相关的函数供 scan<> 在编译期调用，函数体有多条语句，C++14 起才能声明为 constexpr；
+// C++11 下作为普通函数（scan<> 需要 C++20）
+#if __cplusplus >= 201402L
+#define SCAN_CONSTEXPR14 constexpr
+#else
+#define SCAN_CONSTEXPR14
+#endif
+
+// 格式串中的空白（与 C locale 的 isspace 一致，可在编译期使用）
+static constexpr int scan_is_space(char c) {
+	return c == ' ' || (c >= '\t' && c <= '\r');
 }
 
 // 解析字段宽度或精度
-static int parse_number(const char** f) {
+static SCAN_CONSTEXPR14 int parse_number(const char** f) {
 	int num = 0;
-	while (isdigit(**f)) {
+	while (**f >= '0' && **f <= '9') {
 		num = num * 10 + (**f - '0');
 		(*f)++;
 	}
 	return num;
 }
 
-// 抛出异常提醒函数
-static void throw_format_error(const char* input, const char* format, const char* p, const char* f) {
-	fprintf(stderr, "Format mismatch error:\n");
-	fprintf(stderr, "  Input: %s\n", input);
-	fprintf(stderr, "  Format: %s\n", format);
-	fprintf(stderr, "  Position: input[%ld]='%c', format[%ld]='%c'\n",
-		(long)(p - input), *p ? *p : '\0', (long)(f - format), *f);
+// ================= 错误报告 =================
+// 匹配失败时只把位置和原因记入本线程的 my_scanf_error，不分配内存，也不输出。
+// 需要输出时用 my_scanf_set_diag 安装诊断回调，回调次数按秒限流，避免大批坏数据时刷屏和拖慢解析。
+
+#if defined(__GNUC__)
+#define SCAN_COLD __attribute__((cold, noinline))
+#else
+#define SCAN_COLD
+#endif
+
+// 错误原因
+enum {
+	MY_SCANF_ERR_NONE,    // 没有错误
+	MY_SCANF_ERR_INPUT,   // 格式还没有结束，输入已经用完
+	MY_SCANF_ERR_LITERAL, // 格式中的普通字符或 %% 与输入不符
+	MY_SCANF_ERR_MATCH,   // 转换没有读到合法的字符
+	MY_SCANF_ERR_RANGE,   // 整数超出长度修饰符对应类型的范围
+	MY_SCANF_ERR_FORMAT,  // 非法或不完整的说明符
+	MY_SCANF_ERR_NOMEM,   // %ms 或 %m[...] 分配失败，或 %K 驻留时内存不足
+};
+
+typedef struct my_scanf_error {
+	int code;          // MY_SCANF_ERR_*
+	int spec;          // 说明符序号：格式串中第几个 %（从 0 开始，含 %* 和 %n）；普通字符不符时为其后第一个说明符的序号
+	size_t input_off;  // 出错时的输入位置（流模式下为本次调用已读取的字节数）
+	size_t format_off; // 出错时的格式串位置
+} my_scanf_error;
+
+// 诊断回调收到的信息
+typedef struct my_scanf_diag_info {
+	my_scanf_error err;
+	const char* input;  // 出错时正在解析的输入，不以 '\0' 结尾；流模式下为出错的转换已收集的字符（可能为空）
+	size_t len;
+	const char* at;     // 出错位置，在 [input, input + len] 之内
+	const char* format;
+	unsigned long long dropped; // 上一次回调之后因限流丢弃的报告数
+} my_scanf_diag_info;
+
+typedef void (*my_scanf_diag_fn)(void* ctx, const my_scanf_diag_info* info);
+
+static thread_local my_scanf_error g_scan_error;
+
+static struct scan_diag {
+	std::atomic<my_scanf_diag_fn> fn;
+	std::atomic<void*> ctx;
+	std::atomic<unsigned> limit;     // 每秒最多回调次数，0 表示不限
+	std::atomic<long long> window;   // 当前计数的秒
+	std::atomic<unsigned> used;      // 本秒已回调次数
+	std::atomic<unsigned long long> dropped;
+} g_scan_diag;
+
+static thread_local bool t_scan_in_diag; // 本线程正在执行诊断回调
+
+// 本线程最近一次解析的错误；成功时 code 为 MY_SCANF_ERR_NONE。
+// 并行扫描、流式解析等在工作线程中出错时，记录在对应的工作线程中
+const my_scanf_error* my_scanf_last_error() {
+	return &g_scan_error;
 }
 
-// 支持 GB2312 和扩展格式的 my_sscanf 函数，无需 sizeof(str)
-int my_vsscanf(const char* input, const char* format, va_list args) {
-	int count = 0;          // 成功解析的参数计数
-	const char* p = input;  // 输入字符串指针
-	const char* f = format; // 格式字符串指针
-	bool hasStar = false;
+const char* my_scanf_strerror(int code) {
+	switch (code) {
+	case MY_SCANF_ERR_NONE: return "no error";
+	case MY_SCANF_ERR_INPUT: return "input exhausted";
+	case MY_SCANF_ERR_LITERAL: return "literal mismatch";
+	case MY_SCANF_ERR_MATCH: return "matching failure";
+	case MY_SCANF_ERR_RANGE: return "integer out of range";
+	case MY_SCANF_ERR_FORMAT: return "invalid conversion specification";
+	case MY_SCANF_ERR_NOMEM: return "out of memory";
+	default: return "unknown error";
+	}
+}
 
-	while (*f && (hasStar || *p)) {
-		if (*f == '%') {
-			f++; // 跳过 %
+// 安装诊断回调，fn 为 NULL 时关闭（默认）；max_per_sec 为每秒最多回调次数，0 表示不限。
+// 回调可能在多个线程中同时调用，应在开始解析之前设置。
+// 回调中可以调用本库的解析函数：其中的失败不会再次回调，回调返回后 my_scanf_last_error 恢复为外层的错误
+void my_scanf_set_diag(my_scanf_diag_fn fn, void* ctx, unsigned max_per_sec) {
+	g_scan_diag.fn.store(NULL, std::memory_order_relaxed);
+	g_scan_diag.ctx.store(ctx, std::memory_order_relaxed);
+	g_scan_diag.limit.store(max_per_sec, std::memory_order_relaxed);
+	g_scan_diag.used.store(0, std::memory_order_relaxed);
+	g_scan_diag.dropped.store(0, std::memory_order_relaxed);
+	g_scan_diag.fn.store(fn, std::memory_order_release);
+}
 
-			// 检查 * 标志（跳过赋值）
-			int suppress = 0;
-			if (*f == '*') {
-				hasStar = true;
-				suppress = 1;
-				f++;
-			}
+// 按原先的格式输出到 stderr，可直接作为诊断回调
+void my_scanf_diag_stderr(void* ctx, const my_scanf_diag_info* info) {
+	(void)ctx;
+	const char* at = info->at;
+	const char* end = info->input + info->len;
+	if (info->dropped) fprintf(stderr, "(%llu format errors suppressed)\n", info->dropped);
+	fprintf(stderr, "Format mismatch error: %s\n", my_scanf_strerror(info->err.code));
+	fprintf(stderr, "  Input: %.*s\n", info->len > INT_MAX ? INT_MAX : (int)info->len, info->input);
+	fprintf(stderr, "  Format: %s\n", info->format);
+	fprintf(stderr, "  Position: input[%llu]='%c', format[%llu]='%c'\n",
+		(unsigned long long)info->err.input_off, at < end ? *at : '\0',
+		(unsigned long long)info->err.format_off, info->format[info->err.format_off]);
+}
 
-			// 解析字段宽度
-			int width = parse_number(&f);
+// 按限流决定是否回调，允许时取出之前丢弃的报告数
+static bool scan_diag_admit(unsigned long long* dropped) {
+	unsigned limit = g_scan_diag.limit.load(std::memory_order_relaxed);
+	if (limit) {
+		long long now = (long long)std::chrono::duration_cast<std::chrono::seconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		long long w = g_scan_diag.window.load(std::memory_order_relaxed);
+		if (w != now && g_scan_diag.window.compare_exchange_strong(w, now, std::memory_order_relaxed)) {
+			g_scan_diag.used.store(0, std::memory_order_relaxed);
+		}
+		if (g_scan_diag.used.fetch_add(1, std::memory_order_relaxed) >= limit) {
+			g_scan_diag.dropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+	}
+	*dropped = g_scan_diag.dropped.exchange(0, std::memory_order_relaxed);
+	return true;
+}
 
-			// 解析精度（暂未使用）
-			int precision = -1;
-			if (*f == '.') {
-				f++;
-				if (*f == '*') {
-					precision = va_arg(args, int);
-					f++;
-				}
-				else {
-					precision = parse_number(&f);
-				}
-			}
+// 记录匹配失败；输入以 end 为界，不要求以 '\0' 结尾。p 为出错位置，f 为出错的格式位置，
+// n_base 为 input 之前已读取的字节数（流模式）
+static SCAN_COLD void scan_error(int code, int spec, const char* format, const char* f,
+	const char* input, const char* end, const char* p, size_t n_base) {
+	my_scanf_error* e = &g_scan_error;
+	e->code = code;
+	e->spec = spec;
+	e->input_off = (size_t)(p - input) + n_base;
+	e->format_off = (size_t)(f - format);
 
-			// 检查长度修饰符
-			char length_mod[4] = { 0 }; // 支持 hh, h, l, ll, I64
-			if (*f == 'h') {
-				length_mod[0] = *f++;
-				if (*f == 'h') length_mod[1] = *f++; // hh
-			}
-			else if (*f == 'l') {
-				length_mod[0] = *f++;
-				if (*f == 'l') length_mod[1] = *f++; // ll
-			}
-			else if (*f == 'I' && *(f + 1) == '6' && *(f + 2) == '4') {
-				length_mod[0] = 'I';
-				length_mod[1] = '6';
-				length_mod[2] = '4';
-				f += 3; // I64
-			}
+	my_scanf_diag_fn fn = g_scan_diag.fn.load(std::memory_order_acquire);
+	my_scanf_diag_info info;
+	if (!fn || t_scan_in_diag || !scan_diag_admit(&info.dropped)) return;
+	info.err = *e;
+	info.input = input;
+	info.len = (size_t)(end - input);
+	info.at = p;
+	info.format = format;
+	t_scan_in_diag = true;
+	fn(g_scan_diag.ctx.load(std::memory_order_relaxed), &info);
+	t_scan_in_diag = false;
+	*e = info.err; // 回调中的解析会改写本线程的错误
+}
 
-			// 处理格式说明符
-			switch (*f) {
-			case 'd': case 'i': { // 有符号十进制整数
-				p = skip_whitespace(p);
-				char* end;
-				int64_t val = strtoll(p, &end, 10);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					if (strcmp(length_mod, "hh") == 0) {
-						*va_arg(args, signed char*) = (signed char)val;
-					}
-					else if (length_mod[0] == 'h') {
-						*va_arg(args, short*) = (short)val;
-					}
-					else if (strcmp(length_mod, "ll") == 0) {
-						*va_arg(args, long long*) = val;
-					}
-					else if (strcmp(length_mod, "I64") == 0) {
-						*va_arg(args, int64_t*) = val;
-					}
-					else if (length_mod[0] == 'l') {
-						*va_arg(args, long*) = (long)val;
-					}
-					else {
-						*va_arg(args, int*) = (int)val;
-					}
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'u': { // 无符号十进制整数
-				p = skip_whitespace(p);
-				char* end;
-				uint64_t val = strtoull(p, &end, 10);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					if (strcmp(length_mod, "hh") == 0) {
-						*va_arg(args, unsigned char*) = (unsigned char)val;
-					}
-					else if (length_mod[0] == 'h') {
-						*va_arg(args, unsigned short*) = (unsigned short)val;
-					}
-					else if (length_mod[0] == 'l') {
-						*va_arg(args, unsigned long*) = (unsigned long)val;
-					}
-					else {
-						*va_arg(args, unsigned int*) = (unsigned int)val;
-					}
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'x': case 'X': { // 十六进制整数
-				p = skip_whitespace(p);
-				char* end;
-				uint64_t val = strtoull(p, &end, 16);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					if (strcmp(length_mod, "ll") == 0) {
-						*va_arg(args, unsigned long long*) = val;
-					}
-					else if (length_mod[0] == 'l') {
-						*va_arg(args, unsigned long*) = (unsigned long)val;
-					}
-					else {
-						*va_arg(args, unsigned int*) = (unsigned int)val;
-					}
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'f': { // 浮点数
-				p = skip_whitespace(p);
-				char* end;
-				float val = strtof(p, &end);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					*va_arg(args, float*) = val;
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'p': { // 指针地址（十六进制）
-				p = skip_whitespace(p);
-				if (!*p || (*p != '0' && *(p + 1) != 'x')) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				p += 2; // 跳过 "0x"
-				char* end;
-				uintptr_t val = (uintptr_t)strtoull(p, &end, 16);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					*va_arg(args, void**) = (void*)val;
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 's': { // 字符串（支持 GB2312）
-				p = skip_whitespace(p);
-				if (!*p && !suppress) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					char* str = va_arg(args, char*);
-					size_t size = SIZE_MAX; // 默认最大缓冲区大小
-
-					size_t i = 0;
-					while (*p && !isspace((unsigned char)*p) &&
-						(width == 0 || i < (size_t)width) && i < size - 1) {
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1) && i + 1 < size - 1) {
-							str[i++] = *p++;
-							str[i++] = *p++;
-						}
-						else {
-							str[i++] = *p++;
-						}
-					}
-					str[i] = '\0';
-					if (i == 0) {
-						throw_format_error(input, format, p, f);
-						return count;
-					}
-					count++;
-				}
-				else {
-					int read = 0;
-					while (*p && !isspace((unsigned char)*p) && (width == 0 || width > 0)) {
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-							p += 2;
-							if (width) width -= 2;
-							read = 1;
-						}
-						else {
-							p++;
-							if (width) width--;
-							read = 1;
-						}
-					}
-					if (!read && *p) {
-						throw_format_error(input, format, p, f);
-						return count;
-					}
-				}
-				break;
-			}
-			case '[': { // 扫描集（支持 %[...] 和 %[^...]）
-				f++; // 跳过 [
-				int invert = 0;
+// 长度修饰符
+enum {
+	SCAN_LEN_NONE,
+	SCAN_LEN_HH,
+	SCAN_LEN_H,
+	SCAN_LEN_L,
+	SCAN_LEN_LL,
+	SCAN_LEN_I64,
+	SCAN_LEN_LD,   // L，long double
+	SCAN_LEN_Z,    // z，size_t
+};
 
+// 浮点数说明符
+static constexpr int scan_is_float_conv(char c) {
+	return c == 'f' || c == 'F' || c == 'e' || c == 'E' || c == 'g' || c == 'G' || c == 'a' || c == 'A';
+}
 
-				if (*f == '^') {
-					invert = 1;
-					f++;
-				}
-				char charset[256] = { 0 };
-				int first = 1;
-				while (*f && (*f != ']' || first)) {
-					first = 0;
-					if (*f == '-' && !first && *(f + 1) != ']') {
-						char start = *(f - 1);
-						char end = *(f + 1);
-						for (char c = start; c <= end; c++) {
-							charset[(unsigned char)c] = 1;
-						}
-						f += 2;
-					}
-					else {
-						charset[(unsigned char)*f] = 1;
-						f++;
-					}
-				}
-				if (*f != ']') {
-					throw_format_error(input, format, p, f);
-					return 0;
-				}
-				f++; // 跳过 ]
+// ================= 扫描集 =================
+// %[...] 在编译时转换成 256 位位图和 ASCII 字节的半字节查找表。
+// 查表时以字节的低 4 位选取表项、高 4 位选取表项中的位，SSSE3/AVX2/AVX-512 下用 pshufb
+// 一次判断 16/32/64 个字节，标量路径直接查位图。高位字节（可能是 GB2312 首字节）总是停下，由调用方逐字节处理。
 
-				if (!suppress) {
-					char* str = va_arg(args, char*);
-					size_t size = SIZE_MAX; // 默认最大缓冲区大小
-
-					size_t i = 0;
-					while (*p && (width == 0 || i < (size_t)width) && i < size - 1) {
-						int match = invert ? !charset[(unsigned char)*p] : charset[(unsigned char)*p];
-						if (!match) break;
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1) && i + 1 < size - 1) {
-							str[i++] = *p++;
-							str[i++] = *p++;
-						}
-						else {
-							str[i++] = *p++;
-						}
-					}
-					str[i] = '\0';
-					if (i > 0) {
-						count++;
-					}
-					else {
-						p = skip_whitespace(p);
-						while (*p && !isspace((unsigned char)*p) && charset[(unsigned char)*p]) {
-							p++;
-						}
-						p = skip_whitespace(p);
-					}
-				}
-				else {
-					int read = 0;
-					while (*p && (width == 0 || width > 0)) {
-						int match = invert ? !charset[(unsigned char)*p] : charset[(unsigned char)*p];
-						if (!match) break;
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-							p += 2;
-							if (width) width -= 2;
-							read = 1;
-						}
-						else {
-							p++;
-							if (width) width--;
-							read = 1;
-						}
-					}
-					if (!read) {
-						p = skip_whitespace(p);
-						while (*p && !isspace((unsigned char)*p) && charset[(unsigned char)*p]) {
-							p++;
-						}
-						p = skip_whitespace(p);
-					}
-				}
+typedef struct scan_charset {
+	uint8_t match[32]; // 匹配位图，已按 ^ 取反
+	uint8_t raw[32];   // 方括号中列出的字符，未匹配时的恢复逻辑使用
+	uint8_t nib_lo[16]; // 字节 c < 0x80 时，nib_lo[c & 15] 的第 (c >> 4) 位表示是否匹配；高位字节总是停下
+	uint8_t gb_lead;    // 所有 GB2312 首字节都匹配，成段的双字节字符可整段读取
+} scan_charset;
+
+static constexpr int scan_charset_has(const uint8_t* bits, unsigned char c) {
+	return (bits[c >> 3] >> (c & 7)) & 1;
+}
+
+// 由 raw 位图生成匹配位图和查找表
+static SCAN_CONSTEXPR14 void scan_charset_build(scan_charset* cs, int invert) {
+	for (int i = 0; i < 32; i++) {
+		cs->match[i] = (uint8_t)(invert ? ~cs->raw[i] : cs->raw[i]);
+	}
+	for (int i = 0; i < 16; i++) cs->nib_lo[i] = 0;
+	for (int c = 0; c < 0x80; c++) {
+		if (scan_charset_has(cs->match, (unsigned char)c)) cs->nib_lo[c & 15] |= (uint8_t)(1 << (c >> 4));
+	}
+	cs->gb_lead = 1;
+	for (int c = 0xA1; c <= 0xFE; c++) {
+		if (!scan_charset_has(cs->match, (unsigned char)c)) cs->gb_lead = 0;
+	}
+}
+
+// 返回从 p 开始、最多 n 个字节中，连续属于字符集的 ASCII 字节数。
+// 遇到不匹配的字节或高位字节（可能是 GB2312 首字节）即停止，交给调用方逐字节处理
+static size_t scan_span_set_scalar(const char* p, size_t n, const scan_charset* cs) {
+	size_t i = 0;
+	while (i < n && (unsigned char)p[i] < 0x80 && scan_charset_has(cs->match, (unsigned char)p[i])) i++;
+	return i;
+}
+
+#ifdef SCAN_X86
+// 16 字节中不匹配或为高位字节的位置掩码；内联到各目标函数中，避免 AVX2 代码调用非 VEX 编码的 SSE 函数
+#define SCAN_SET_MISS16(x, tlo, nib, hibit) \
+	((unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128( \
+		_mm_shuffle_epi8(tlo, _mm_and_si128(x, nib)), \
+		_mm_shuffle_epi8(hibit, _mm_and_si128(_mm_srli_epi16(x, 4), nib))), _mm_setzero_si128())))
+
+__attribute__((target("ssse3")))
+static size_t scan_span_set_ssse3(const char* p, size_t n, const scan_charset* cs) {
+	const __m128i tlo = _mm_loadu_si128((const __m128i*)cs->nib_lo);
+	const __m128i nib = _mm_set1_epi8(0x0f);
+	const __m128i hibit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned mask = SCAN_SET_MISS16(x, tlo, nib, hibit);
+		if (mask) return i + __builtin_ctz(mask);
+	}
+	return i + scan_span_set_scalar(p + i, n - i, cs);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_span_set_avx2(const char* p, size_t n, const scan_charset* cs) {
+	const __m128i tlo = _mm_loadu_si128((const __m128i*)cs->nib_lo);
+	const __m128i nib = _mm_set1_epi8(0x0f);
+	const __m128i hibit = _mm_setr_epi8(1, 2, 4, 8, 16, 32, 64, (char)128, 0, 0, 0, 0, 0, 0, 0, 0);
+	size_t i = 0;
+	if (n >= 32) {
+		const __m256i tlo2 = _mm256_broadcastsi128_si256(tlo);
+		const __m256i nib2 = _mm256_broadcastsi128_si256(nib);
+		const __m256i hibit2 = _mm256_broadcastsi128_si256(hibit);
+		for (; i + 32 <= n; i += 32) {
+			__m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+			__m256i row = _mm256_shuffle_epi8(tlo2, _mm256_and_si256(x, nib2));
+			__m256i bit = _mm256_shuffle_epi8(hibit2, _mm256_and_si256(_mm256_srli_epi16(x, 4), nib2));
+			__m256i miss = _mm256_cmpeq_epi8(_mm256_and_si256(row, bit), _mm256_setzero_si256());
+			unsigned mask = (unsigned)_mm256_movemask_epi8(miss);
+			if (mask) return i + __builtin_ctz(mask);
+		}
+	}
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned mask = SCAN_SET_MISS16(x, tlo, nib, hibit);
+		if (mask) return i + __builtin_ctz(mask);
+	}
+	return i + scan_span_set_scalar(p + i, n - i, cs);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_span_set_avx512(const char* p, size_t n, const scan_charset* cs) {
+	// pshufb 在每个 128 位通道内查表，表需要复制到 4 个通道
+	static const uint8_t hibit_bytes[64] = {
+		1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0,
+		1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 4, 8, 16, 32, 64, 128, 0, 0, 0, 0, 0, 0, 0, 0,
+	};
+	uint8_t tlo_bytes[64];
+	for (int k = 0; k < 4; k++) memcpy(tlo_bytes + 16 * k, cs->nib_lo, 16);
+	const __m512i tlo = _mm512_loadu_si512((const void*)tlo_bytes);
+	const __m512i nib = _mm512_set1_epi8(0x0f);
+	const __m512i hibit = _mm512_loadu_si512((const void*)hibit_bytes);
+	size_t i = 0;
+	for (;;) {
+		__mmask64 valid = n - i >= 64 ? ~0ULL : (1ULL << (n - i)) - 1;
+		if (!valid) return n;
+		__m512i x = _mm512_maskz_loadu_epi8(valid, p + i);
+		__m512i row = _mm512_shuffle_epi8(tlo, _mm512_and_si512(x, nib));
+		__m512i bit = _mm512_shuffle_epi8(hibit, _mm512_and_si512(_mm512_srli_epi16(x, 4), nib));
+		uint64_t miss = _mm512_testn_epi8_mask(row, bit) & valid;
+		if (miss) return i + __builtin_ctzll(miss);
+		if (n - i <= 64) return n;
+		i += 64;
+	}
+}
+#endif
+
+// ================= 空白 =================
+// 空白按 C locale 的 isspace 判断（' '、\t、\n、\v、\f、\r），查表实现，不受 setlocale 影响。
+// 跳过空白和查找 %s 词尾的循环各有 SSE2/AVX2/AVX-512 实现。
+
+static const unsigned char scan_space_table[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+	1,
+};
+
+// 返回从 p 开始、最多 n 个字节中，开头连续空白的字节数
+static size_t scan_span_space_scalar(const char* p, size_t n) {
+	size_t i = 0;
+	while (i < n && scan_space_table[(unsigned char)p[i]]) i++;
+	return i;
+}
+
+// 返回开头连续的非空白 ASCII 字节数，遇到空白或高位字节（可能是 GB2312 首字节）即停止
+static size_t scan_span_word_scalar(const char* p, size_t n) {
+	size_t i = 0;
+	while (i < n && (unsigned char)p[i] < 0x80 && !scan_space_table[(unsigned char)p[i]]) i++;
+	return i;
+}
+
+#ifdef SCAN_X86
+// 16 字节中空白字节的位置掩码：x == ' ' 或 x - '\t' <= 4（无符号比较）
+#define SCAN_SPACE16(x) \
+	((unsigned)_mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), \
+		_mm_cmpeq_epi8(_mm_min_epu8(_mm_sub_epi8(x, _mm_set1_epi8('\t')), _mm_set1_epi8(4)), \
+			_mm_sub_epi8(x, _mm_set1_epi8('\t'))))))
+#define SCAN_SPACE32(x) \
+	((unsigned)_mm256_movemask_epi8(_mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')), \
+		_mm256_cmpeq_epi8(_mm256_min_epu8(_mm256_sub_epi8(x, _mm256_set1_epi8('\t')), _mm256_set1_epi8(4)), \
+			_mm256_sub_epi8(x, _mm256_set1_epi8('\t'))))))
+#define SCAN_SPACE64(x) \
+	(_mm512_cmpeq_epi8_mask(x, _mm512_set1_epi8(' ')) | \
+		_mm512_cmple_epu8_mask(_mm512_sub_epi8(x, _mm512_set1_epi8('\t')), _mm512_set1_epi8(4)))
+
+__attribute__((target("sse2")))
+static size_t scan_span_space_sse2(const char* p, size_t n) {
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned stop = ~SCAN_SPACE16(x) & 0xFFFF;
+		if (stop) return i + __builtin_ctz(stop);
+	}
+	return i + scan_span_space_scalar(p + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static size_t scan_span_word_sse2(const char* p, size_t n) {
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned stop = SCAN_SPACE16(x) | (unsigned)_mm_movemask_epi8(x);
+		if (stop) return i + __builtin_ctz(stop);
+	}
+	return i + scan_span_word_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_span_space_avx2(const char* p, size_t n) {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+		unsigned stop = ~SCAN_SPACE32(x);
+		if (stop) return i + __builtin_ctz(stop);
+	}
+	if (i + 16 <= n) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned stop = ~SCAN_SPACE16(x) & 0xFFFF;
+		if (stop) return i + __builtin_ctz(stop);
+		i += 16;
+	}
+	return i + scan_span_space_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_span_word_avx2(const char* p, size_t n) {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+		unsigned stop = SCAN_SPACE32(x) | (unsigned)_mm256_movemask_epi8(x);
+		if (stop) return i + __builtin_ctz(stop);
+	}
+	if (i + 16 <= n) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned stop = SCAN_SPACE16(x) | (unsigned)_mm_movemask_epi8(x);
+		if (stop) return i + __builtin_ctz(stop);
+		i += 16;
+	}
+	return i + scan_span_word_scalar(p + i, n - i);
+}
+
+// AVX-512 的尾部用掩码加载，不读 n 之后的字节
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_span_space_avx512(const char* p, size_t n) {
+	size_t i = 0;
+	for (;;) {
+		__mmask64 valid = n - i >= 64 ? ~0ULL : (1ULL << (n - i)) - 1;
+		if (!valid) return n;
+		__m512i x = _mm512_maskz_loadu_epi8(valid, p + i);
+		uint64_t stop = ~SCAN_SPACE64(x) & valid;
+		if (stop) return i + __builtin_ctzll(stop);
+		if (n - i <= 64) return n;
+		i += 64;
+	}
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_span_word_avx512(const char* p, size_t n) {
+	size_t i = 0;
+	for (;;) {
+		__mmask64 valid = n - i >= 64 ? ~0ULL : (1ULL << (n - i)) - 1;
+		if (!valid) return n;
+		__m512i x = _mm512_maskz_loadu_epi8(valid, p + i);
+		uint64_t stop = (SCAN_SPACE64(x) | _mm512_movepi8_mask(x)) & valid;
+		if (stop) return i + __builtin_ctzll(stop);
+		if (n - i <= 64) return n;
+		i += 64;
+	}
+}
+#endif
+
+// ================= GB2312 =================
+// 输入中绝大多数是 ASCII，各个扫描循环先用上面的向量化实现整段跳过 ASCII，遇到高位字节才进入这里。
+// 连续的中文文本按“首字节 + 高位尾字节”成对整段跳过，段首段尾的特殊情况
+// （非首字节的高位字节、尾字节是 ASCII、超出宽度）仍由调用方逐个字符处理。
+
+// 返回从 p 开始、最多 n 个字节中，开头由完整双字节字符组成的长度（偶数）：
+// 偶数位置都是 GB2312 首字节，所有字节都是高位字节
+static size_t scan_span_gb2312_scalar(const char* p, size_t n) {
+	size_t i = 0;
+	while (i + 1 < n && is_gb2312_lead_byte((unsigned char)p[i]) && (unsigned char)p[i + 1] >= 0x80) i += 2;
+	return i;
+}
+
+#ifdef SCAN_X86
+// 16 字节中不能作为双字节字符一部分的位置掩码：非高位字节，或偶数位置上不是首字节（0xA1-0xFE）
+#define SCAN_GB_STOP16(x) \
+	((~(unsigned)_mm_movemask_epi8(x) & 0xFFFF) | (0x5555 & ~(unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8( \
+		_mm_min_epu8(_mm_sub_epi8(x, _mm_set1_epi8((char)0xA1)), _mm_set1_epi8(0x5D)), \
+		_mm_sub_epi8(x, _mm_set1_epi8((char)0xA1))))))
+#define SCAN_GB_STOP32(x) \
+	(~(unsigned)_mm256_movemask_epi8(x) | (0x55555555u & ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8( \
+		_mm256_min_epu8(_mm256_sub_epi8(x, _mm256_set1_epi8((char)0xA1)), _mm256_set1_epi8(0x5D)), \
+		_mm256_sub_epi8(x, _mm256_set1_epi8((char)0xA1))))))
+
+__attribute__((target("sse2")))
+static size_t scan_span_gb2312_sse2(const char* p, size_t n) {
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned stop = SCAN_GB_STOP16(x);
+		if (stop) return i + (__builtin_ctz(stop) & ~1u);
+	}
+	return i + scan_span_gb2312_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_span_gb2312_avx2(const char* p, size_t n) {
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		__m256i x = _mm256_loadu_si256((const __m256i*)(p + i));
+		unsigned stop = SCAN_GB_STOP32(x);
+		if (stop) return i + (__builtin_ctz(stop) & ~1u);
+	}
+	if (i + 16 <= n) {
+		__m128i x = _mm_loadu_si128((const __m128i*)(p + i));
+		unsigned stop = SCAN_GB_STOP16(x);
+		if (stop) return i + (__builtin_ctz(stop) & ~1u);
+		i += 16;
+	}
+	return i + scan_span_gb2312_scalar(p + i, n - i);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_span_gb2312_avx512(const char* p, size_t n) {
+	size_t i = 0;
+	for (; i + 64 <= n; i += 64) {
+		__m512i x = _mm512_loadu_si512((const void*)(p + i));
+		uint64_t lead = _mm512_cmple_epu8_mask(_mm512_sub_epi8(x, _mm512_set1_epi8((char)0xA1)), _mm512_set1_epi8(0x5D));
+		uint64_t stop = ~_mm512_movepi8_mask(x) | (0x5555555555555555ULL & ~lead);
+		if (stop) return i + (__builtin_ctzll(stop) & ~1u);
+	}
+	return i + scan_span_gb2312_scalar(p + i, n - i);
+}
+#endif
+
+// ================= 数字 =================
+// 十进制和十六进制数字串按 8 字节一组用 SWAR 判断和转换，剩余不足 8 字节时逐字节处理。
+// 逐字节版本作为标量实现保留，两者结果（包括溢出标志）完全相同。
+
+#if defined(_WIN32) || (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define SCAN_SWAR 1
+#endif
+
+static const uint64_t scan_pow10[20] = {
+	1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+	10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL, 100000000000000ULL,
+	1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+	10000000000000000000ULL,
+};
+
+static inline int scan_hex_value(unsigned char c) {
+	if (c >= '0' && c <= '9') return c - '0';
+	c |= 0x20;
+	if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+	return -1;
+}
+
+// 逐字节解析十进制数字串，在 *val 的基础上继续累加，返回数字个数；超出 uint64_t 时 *overflow 置 1
+static size_t scan_digits10_more(const char* p, const char* end, uint64_t* val, int* overflow) {
+	const char* start = p;
+	uint64_t acc = *val;
+	while (p < end && *p >= '0' && *p <= '9') {
+		unsigned d = (unsigned)(*p - '0');
+		if (acc > (UINT64_MAX - d) / 10) *overflow = 1;
+		acc = acc * 10 + d;
+		p++;
+	}
+	*val = acc;
+	return (size_t)(p - start);
+}
+
+static size_t scan_digits16_more(const char* p, const char* end, uint64_t* val, int* overflow) {
+	const char* start = p;
+	uint64_t acc = *val;
+	int d;
+	while (p < end && (d = scan_hex_value((unsigned char)*p)) >= 0) {
+		if (acc >> 60) *overflow = 1;
+		acc = (acc << 4) | (unsigned)d;
+		p++;
+	}
+	*val = acc;
+	return (size_t)(p - start);
+}
+
+// 解析十进制数字串（不含符号），返回数字个数；数值超出 uint64_t 时 *overflow 置 1
+static size_t scan_digits10_scalar(const char* p, const char* end, uint64_t* val, int* overflow) {
+	*val = 0;
+	*overflow = 0;
+	return scan_digits10_more(p, end, val, overflow);
+}
+
+// 解析十六进制数字串（不含前缀），返回数字个数；数值超出 uint64_t 时 *overflow 置 1
+static size_t scan_digits16_scalar(const char* p, const char* end, uint64_t* val, int* overflow) {
+	*val = 0;
+	*overflow = 0;
+	return scan_digits16_more(p, end, val, overflow);
+}
+
+#ifdef SCAN_SWAR
+#define SCAN_ONES 0x0101010101010101ULL
+#define SCAN_HIGH 0x8080808080808080ULL
+
+// 8 个字节中每个字节是否落在 [lo, hi]（要求字节 < 0x80），结果为每字节最高位
+static inline uint64_t scan_swar_in_range(uint64_t v, unsigned char lo, unsigned char hi) {
+	return (v + SCAN_ONES * (0x80 - lo)) & ~(v + SCAN_ONES * (0x7F - hi)) & SCAN_HIGH;
+}
+
+// 掩码中前导的“全是数字”字节数
+static inline size_t scan_swar_leading(uint64_t digit_mask, uint64_t v) {
+	uint64_t stop = (~digit_mask & SCAN_HIGH) | (v & SCAN_HIGH);
+	return stop ? (size_t)(__builtin_ctzll(stop) >> 3) : 8;
+}
+
+static size_t scan_digits10_swar(const char* p, const char* end, uint64_t* val, int* overflow) {
+	const char* start = p;
+	uint64_t acc = 0;
+	*overflow = 0;
+	while (end - p >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		size_t k = scan_swar_leading(scan_swar_in_range(v, '0', '9'), v);
+		if (k == 0) break;
+		// 只保留前 k 个数字，移到高位，低位补 0
+		v -= SCAN_ONES * '0';
+		v <<= 8 * (8 - k);
+		v = v * 10 + (v >> 8);
+		v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+			(((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+		if (acc > (UINT64_MAX - v) / scan_pow10[k]) *overflow = 1;
+		acc = acc * scan_pow10[k] + v;
+		p += k;
+		if (k < 8) {
+			*val = acc;
+			return (size_t)(p - start);
+		}
+	}
+	*val = acc;
+	return (size_t)(p - start) + scan_digits10_more(p, end, val, overflow);
+}
+
+static size_t scan_digits16_swar(const char* p, const char* end, uint64_t* val, int* overflow) {
+	const char* start = p;
+	uint64_t acc = 0;
+	*overflow = 0;
+	while (end - p >= 8) {
+		uint64_t v;
+		memcpy(&v, p, 8);
+		uint64_t hex = scan_swar_in_range(v, '0', '9') | scan_swar_in_range(v | SCAN_ONES * 0x20, 'a', 'f');
+		size_t k = scan_swar_leading(hex, v);
+		if (k == 0) break;
+		// 每字节换成 0-15，再两两合并为 32 位数值
+		v = (v & SCAN_ONES * 0x0F) + 9 * ((v >> 6) & SCAN_ONES);
+		v <<= 8 * (8 - k);
+		v = ((v & 0x000F000F000F000FULL) << 4) | ((v >> 8) & 0x000F000F000F000FULL);
+		v = ((v & 0x000000FF000000FFULL) << 8) | ((v >> 16) & 0x000000FF000000FFULL);
+		v = ((v & 0xFFFF) << 16) | ((v >> 32) & 0xFFFF);
+		if (acc >> (64 - 4 * k)) *overflow = 1;
+		acc = (acc << (4 * k)) | v;
+		p += k;
+		if (k < 8) {
+			*val = acc;
+			return (size_t)(p - start);
+		}
+	}
+	*val = acc;
+	return (size_t)(p - start) + scan_digits16_more(p, end, val, overflow);
+}
+#endif
+
+// ================= 查找字节 =================
+// 行读取时查找换行符（或自定义分隔符）。
+
+// 返回 p 开始的 n 个字节中第一个 c 的位置，没有时返回 n
+static size_t scan_find_byte_scalar(const char* p, size_t n, char c) {
+	size_t i = 0;
+	while (i < n && p[i] != c) i++;
+	return i;
+}
+
+#ifdef SCAN_X86
+__attribute__((target("sse2")))
+static size_t scan_find_byte_sse2(const char* p, size_t n, char c) {
+	const __m128i cc = _mm_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 16 <= n; i += 16) {
+		unsigned hit = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), cc));
+		if (hit) return i + __builtin_ctz(hit);
+	}
+	return i + scan_find_byte_scalar(p + i, n - i, c);
+}
+
+__attribute__((target("avx2")))
+static size_t scan_find_byte_avx2(const char* p, size_t n, char c) {
+	const __m256i cc = _mm256_set1_epi8(c);
+	size_t i = 0;
+	for (; i + 32 <= n; i += 32) {
+		unsigned hit = (unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*)(p + i)), cc));
+		if (hit) return i + __builtin_ctz(hit);
+	}
+	if (i + 16 <= n) {
+		unsigned hit = (unsigned)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)(p + i)), _mm256_castsi256_si128(cc)));
+		if (hit) return i + __builtin_ctz(hit);
+		i += 16;
+	}
+	return i + scan_find_byte_scalar(p + i, n - i, c);
+}
+
+__attribute__((target("avx512f,avx512bw")))
+static size_t scan_find_byte_avx512(const char* p, size_t n, char c) {
+	const __m512i cc = _mm512_set1_epi8(c);
+	size_t i = 0;
+	for (;;) {
+		__mmask64 valid = n - i >= 64 ? ~0ULL : (1ULL << (n - i)) - 1;
+		if (!valid) return n;
+		uint64_t hit = _mm512_mask_cmpeq_epi8_mask(valid, _mm512_maskz_loadu_epi8(valid, p + i), cc);
+		if (hit) return i + __builtin_ctzll(hit);
+		if (n - i <= 64) return n;
+		i += 64;
+	}
+}
+#endif
+
+// ================= CPU 分派 =================
+// 上面各组向量化实现在程序启动时统一选择一次，结果保存在 scan_isa 中，之后直接经函数指针调用。
+// 默认按 cpuid 选择 CPU 支持的最高级别；环境变量 MY_SCANF_ISA 可指定
+// scalar、swar、sse2、ssse3、avx2、avx512 之一，用于对比测试，超出 CPU 能力时降到可用的最高级别。
+// 各级别的结果逐字节相同。
+
+typedef size_t (*scan_span_fn)(const char*, size_t);
+
+typedef struct scan_isa_table {
+	const char* name;
+	scan_span_fn span_space;  // 开头连续空白
+	scan_span_fn span_word;   // 开头连续的非空白 ASCII
+	scan_span_fn span_gb2312; // 开头连续的 GB2312 双字节字符
+	size_t (*span_set)(const char*, size_t, const scan_charset*); // 开头连续属于字符集的 ASCII
+	size_t (*digits10)(const char*, const char*, uint64_t*, int*);
+	size_t (*digits16)(const char*, const char*, uint64_t*, int*);
+	size_t (*find_byte)(const char*, size_t, char); // 查找换行符
+} scan_isa_table;
+
+#ifdef SCAN_SWAR
+#define SCAN_DIGITS_FAST scan_digits10_swar, scan_digits16_swar
+#else
+#define SCAN_DIGITS_FAST scan_digits10_scalar, scan_digits16_scalar
+#endif
+
+// 按级别从低到高排列
+static const scan_isa_table scan_isa_levels[] = {
+	{ "scalar", scan_span_space_scalar, scan_span_word_scalar, scan_span_gb2312_scalar, scan_span_set_scalar,
+		scan_digits10_scalar, scan_digits16_scalar, scan_find_byte_scalar },
+	{ "swar", scan_span_space_scalar, scan_span_word_scalar, scan_span_gb2312_scalar, scan_span_set_scalar,
+		SCAN_DIGITS_FAST, scan_find_byte_scalar },
+#ifdef SCAN_X86
+	{ "sse2", scan_span_space_sse2, scan_span_word_sse2, scan_span_gb2312_sse2, scan_span_set_scalar,
+		SCAN_DIGITS_FAST, scan_find_byte_sse2 },
+	{ "ssse3", scan_span_space_sse2, scan_span_word_sse2, scan_span_gb2312_sse2, scan_span_set_ssse3,
+		SCAN_DIGITS_FAST, scan_find_byte_sse2 },
+	{ "avx2", scan_span_space_avx2, scan_span_word_avx2, scan_span_gb2312_avx2, scan_span_set_avx2,
+		SCAN_DIGITS_FAST, scan_find_byte_avx2 },
+	{ "avx512", scan_span_space_avx512, scan_span_word_avx512, scan_span_gb2312_avx512, scan_span_set_avx512,
+		SCAN_DIGITS_FAST, scan_find_byte_avx512 },
+#endif
+};
+
+// CPU 支持的最高级别在 scan_isa_levels 中的下标
+static int scan_isa_supported() {
+	int best = 1;
+#ifdef SCAN_X86
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2")) best = 2;
+	if (__builtin_cpu_supports("ssse3")) best = 3;
+	if (__builtin_cpu_supports("avx2")) best = 4;
+	if (__builtin_cpu_supports("avx512bw")) best = 5;
+#endif
+	return best;
+}
+
+static scan_isa_table scan_isa_resolve() {
+	int n = (int)(sizeof(scan_isa_levels) / sizeof(scan_isa_levels[0]));
+	int best = scan_isa_supported();
+	const char* want = getenv("MY_SCANF_ISA");
+	if (want) {
+		for (int i = 0; i < n; i++) {
+			if (strcmp(want, scan_isa_levels[i].name) == 0) {
+				if (i < best) best = i;
 				break;
 			}
-			case 'c': { // 单个字符（支持 GB2312）
-				if (!*p && !suppress) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					char* ch = va_arg(args, char*);
-					if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-						*ch++ = *p++;
-						*ch = *p++;
-					}
-					else {
-						*ch = *p++;
-					}
-					count++;
-				}
-				else {
-					if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-						p += 2;
-					}
-					else {
-						p++;
-					}
+		}
+	}
+	return scan_isa_levels[best];
+}
+
+static const scan_isa_table scan_isa = scan_isa_resolve();
+
+// 当前使用的实现级别
+const char* my_scanf_isa() {
+	return scan_isa.name;
+}
+
+// 跳过空白字符。字段之间通常只有一两个空白，先逐字节判断，更长的空白再交给向量化实现
+static inline const char* skip_whitespace(const char* p, const char* end) {
+	if (p >= end || !scan_space_table[(unsigned char)*p]) return p;
+	p++;
+	if (p >= end || !scan_space_table[(unsigned char)*p]) return p;
+	return p + scan_isa.span_space(p, (size_t)(end - p));
+}
+
+// ================= 字段解析 =================
+// 以下函数解析单个字段：*pp 指向字段开头，成功时前移到字段之后，输入以 end 为界。
+// 预编译格式的执行器和 scan<> 模板共用这些函数。
+
+// ---- 整数 ----
+// 字段宽度限制符号、0x 前缀和数字的总长度；超出长度修饰符对应类型范围时报告溢出，不使用 errno。
+
+// 长度修饰符对应的无符号类型最大值
+static uint64_t scan_len_umax(int len_mod) {
+	switch (len_mod) {
+	case SCAN_LEN_HH: return UCHAR_MAX;
+	case SCAN_LEN_H: return USHRT_MAX;
+	case SCAN_LEN_L: return ULONG_MAX;
+	case SCAN_LEN_LL: case SCAN_LEN_I64: return UINT64_MAX;
+	case SCAN_LEN_Z: return SIZE_MAX;
+	default: return UINT_MAX;
+	}
+}
+
+// 解析可选符号、可选 0x 前缀（base 为 16 时）和数字，得到符号与绝对值。
+// 返回 1 成功，0 没有数字，-1 溢出；失败时 *pp 不动
+static int scan_magnitude(const char** pp, const char* end, int width, int base, int* neg, uint64_t* mag) {
+	const char* p = *pp;
+	if (width > 0 && end - p > width) end = p + width;
+	*neg = 0;
+	if (p < end && (*p == '+' || *p == '-')) {
+		*neg = *p == '-';
+		p++;
+	}
+	if (base == 16 && end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' && scan_hex_value((unsigned char)p[2]) >= 0) {
+		p += 2;
+	}
+	int overflow;
+	size_t n = base == 16 ? scan_isa.digits16(p, end, mag, &overflow) : scan_isa.digits10(p, end, mag, &overflow);
+	if (n == 0) return 0;
+	if (overflow) return -1;
+	*pp = p + n;
+	return 1;
+}
+
+// 有符号十进制整数，范围由长度修饰符决定
+static int scan_int(const char** pp, const char* end, int width, int len_mod, int64_t* val) {
+	int neg;
+	uint64_t mag;
+	int r = scan_magnitude(pp, end, width, 10, &neg, &mag);
+	if (r <= 0) return r;
+	uint64_t max = scan_len_umax(len_mod) >> 1;
+	if (mag > max + (uint64_t)neg) return -1;
+	*val = neg ? (int64_t)(0 - mag) : (int64_t)mag;
+	return 1;
+}
+
+// 无符号整数，base 为 10 或 16；带负号时按对应类型取模，与 strtoul 一致
+static int scan_uint(const char** pp, const char* end, int width, int base, int len_mod, uint64_t* val) {
+	int neg;
+	uint64_t mag;
+	int r = scan_magnitude(pp, end, width, base, &neg, &mag);
+	if (r <= 0) return r;
+	uint64_t max = scan_len_umax(len_mod);
+	if (mag > max) return -1;
+	*val = neg ? (0 - mag) & max : mag;
+	return 1;
+}
+
+// ---- 浮点数 ----
+// 十进制数先读出最多 19 位有效数字 w 和十进制指数 q（值为 w * 10^q），不经过 strtod：
+// w 和 10^q 都能精确表示时直接做一次乘除（Clinger 快速路径）；否则用 Eisel-Lemire 算法，
+// 以 128 位截断的 5^q 与 w 相乘，由乘积高位直接得到正确舍入的尾数和指数。
+// 有效数字超过 19 位且截断后无法确定舍入方向、十六进制浮点数以及 long double 的一般情况，
+// 回退到 C locale 下的 strtod 系列函数。小数点固定为 '.'，结果不受 setlocale 影响。
+
+// 5^q 的 128 位近似（高 64 位在前），q 从 -342 到 308，生成方法同 fast_float
+#define SCAN_POW5_MIN -342
+#define SCAN_POW5_MAX 308
+static const uint64_t scan_pow5_128[2 * (SCAN_POW5_MAX - SCAN_POW5_MIN + 1)] = {
+	0xeef453d6923bd65aULL, 0x113faa2906a13b3fULL, 0x9558b4661b6565f8ULL, 0x4ac7ca59a424c507ULL,
+	0xbaaee17fa23ebf76ULL, 0x5d79bcf00d2df649ULL, 0xe95a99df8ace6f53ULL, 0xf4d82c2c107973dcULL,
+	0x91d8a02bb6c10594ULL, 0x79071b9b8a4be869ULL, 0xb64ec836a47146f9ULL, 0x9748e2826cdee284ULL,
+	0xe3e27a444d8d98b7ULL, 0xfd1b1b2308169b25ULL, 0x8e6d8c6ab0787f72ULL, 0xfe30f0f5e50e20f7ULL,
+	0xb208ef855c969f4fULL, 0xbdbd2d335e51a935ULL, 0xde8b2b66b3bc4723ULL, 0xad2c788035e61382ULL,
+	0x8b16fb203055ac76ULL, 0x4c3bcb5021afcc31ULL, 0xaddcb9e83c6b1793ULL, 0xdf4abe242a1bbf3dULL,
+	0xd953e8624b85dd78ULL, 0xd71d6dad34a2af0dULL, 0x87d4713d6f33aa6bULL, 0x8672648c40e5ad68ULL,
+	0xa9c98d8ccb009506ULL, 0x680efdaf511f18c2ULL, 0xd43bf0effdc0ba48ULL, 0x0212bd1b2566def2ULL,
+	0x84a57695fe98746dULL, 0x014bb630f7604b57ULL, 0xa5ced43b7e3e9188ULL, 0x419ea3bd35385e2dULL,
+	0xcf42894a5dce35eaULL, 0x52064cac828675b9ULL, 0x818995ce7aa0e1b2ULL, 0x7343efebd1940993ULL,
+	0xa1ebfb4219491a1fULL, 0x1014ebe6c5f90bf8ULL, 0xca66fa129f9b60a6ULL, 0xd41a26e077774ef6ULL,
+	0xfd00b897478238d0ULL, 0x8920b098955522b4ULL, 0x9e20735e8cb16382ULL, 0x55b46e5f5d5535b0ULL,
+	0xc5a890362fddbc62ULL, 0xeb2189f734aa831dULL, 0xf712b443bbd52b7bULL, 0xa5e9ec7501d523e4ULL,
+	0x9a6bb0aa55653b2dULL, 0x47b233c92125366eULL, 0xc1069cd4eabe89f8ULL, 0x999ec0bb696e840aULL,
+	0xf148440a256e2c76ULL, 0xc00670ea43ca250dULL, 0x96cd2a865764dbcaULL, 0x380406926a5e5728ULL,
+	0xbc807527ed3e12bcULL, 0xc605083704f5ecf2ULL, 0xeba09271e88d976bULL, 0xf7864a44c633682eULL,
+	0x93445b8731587ea3ULL, 0x7ab3ee6afbe0211dULL, 0xb8157268fdae9e4cULL, 0x5960ea05bad82964ULL,
+	0xe61acf033d1a45dfULL, 0x6fb92487298e33bdULL, 0x8fd0c16206306babULL, 0xa5d3b6d479f8e056ULL,
+	0xb3c4f1ba87bc8696ULL, 0x8f48a4899877186cULL, 0xe0b62e2929aba83cULL, 0x331acdabfe94de87ULL,
+	0x8c71dcd9ba0b4925ULL, 0x9ff0c08b7f1d0b14ULL, 0xaf8e5410288e1b6fULL, 0x07ecf0ae5ee44dd9ULL,
+	0xdb71e91432b1a24aULL, 0xc9e82cd9f69d6150ULL, 0x892731ac9faf056eULL, 0xbe311c083a225cd2ULL,
+	0xab70fe17c79ac6caULL, 0x6dbd630a48aaf406ULL, 0xd64d3d9db981787dULL, 0x092cbbccdad5b108ULL,
+	0x85f0468293f0eb4eULL, 0x25bbf56008c58ea5ULL, 0xa76c582338ed2621ULL, 0xaf2af2b80af6f24eULL,
+	0xd1476e2c07286faaULL, 0x1af5af660db4aee1ULL, 0x82cca4db847945caULL, 0x50d98d9fc890ed4dULL,
+	0xa37fce126597973cULL, 0xe50ff107bab528a0ULL, 0xcc5fc196fefd7d0cULL, 0x1e53ed49a96272c8ULL,
+	0xff77b1fcbebcdc4fULL, 0x25e8e89c13bb0f7aULL, 0x9faacf3df73609b1ULL, 0x77b191618c54e9acULL,
+	0xc795830d75038c1dULL, 0xd59df5b9ef6a2417ULL, 0xf97ae3d0d2446f25ULL, 0x4b0573286b44ad1dULL,
+	0x9becce62836ac577ULL, 0x4ee367f9430aec32ULL, 0xc2e801fb244576d5ULL, 0x229c41f793cda73fULL,
+	0xf3a20279ed56d48aULL, 0x6b43527578c1110fULL, 0x9845418c345644d6ULL, 0x830a13896b78aaa9ULL,
+	0xbe5691ef416bd60cULL, 0x23cc986bc656d553ULL, 0xedec366b11c6cb8fULL, 0x2cbfbe86b7ec8aa8ULL,
+	0x94b3a202eb1c3f39ULL, 0x7bf7d71432f3d6a9ULL, 0xb9e08a83a5e34f07ULL, 0xdaf5ccd93fb0cc53ULL,
+	0xe858ad248f5c22c9ULL, 0xd1b3400f8f9cff68ULL, 0x91376c36d99995beULL, 0x23100809b9c21fa1ULL,
+	0xb58547448ffffb2dULL, 0xabd40a0c2832a78aULL, 0xe2e69915b3fff9f9ULL, 0x16c90c8f323f516cULL,
+	0x8dd01fad907ffc3bULL, 0xae3da7d97f6792e3ULL, 0xb1442798f49ffb4aULL, 0x99cd11cfdf41779cULL,
+	0xdd95317f31c7fa1dULL, 0x40405643d711d583ULL, 0x8a7d3eef7f1cfc52ULL, 0x482835ea666b2572ULL,
+	0xad1c8eab5ee43b66ULL, 0xda3243650005eecfULL, 0xd863b256369d4a40ULL, 0x90bed43e40076a82ULL,
+	0x873e4f75e2224e68ULL, 0x5a7744a6e804a291ULL, 0xa90de3535aaae202ULL, 0x711515d0a205cb36ULL,
+	0xd3515c2831559a83ULL, 0x0d5a5b44ca873e03ULL, 0x8412d9991ed58091ULL, 0xe858790afe9486c2ULL,
+	0xa5178fff668ae0b6ULL, 0x626e974dbe39a872ULL, 0xce5d73ff402d98e3ULL, 0xfb0a3d212dc8128fULL,
+	0x80fa687f881c7f8eULL, 0x7ce66634bc9d0b99ULL, 0xa139029f6a239f72ULL, 0x1c1fffc1ebc44e80ULL,
+	0xc987434744ac874eULL, 0xa327ffb266b56220ULL, 0xfbe9141915d7a922ULL, 0x4bf1ff9f0062baa8ULL,
+	0x9d71ac8fada6c9b5ULL, 0x6f773fc3603db4a9ULL, 0xc4ce17b399107c22ULL, 0xcb550fb4384d21d3ULL,
+	0xf6019da07f549b2bULL, 0x7e2a53a146606a48ULL, 0x99c102844f94e0fbULL, 0x2eda7444cbfc426dULL,
+	0xc0314325637a1939ULL, 0xfa911155fefb5308ULL, 0xf03d93eebc589f88ULL, 0x793555ab7eba27caULL,
+	0x96267c7535b763b5ULL, 0x4bc1558b2f3458deULL, 0xbbb01b9283253ca2ULL, 0x9eb1aaedfb016f16ULL,
+	0xea9c227723ee8bcbULL, 0x465e15a979c1cadcULL, 0x92a1958a7675175fULL, 0x0bfacd89ec191ec9ULL,
+	0xb749faed14125d36ULL, 0xcef980ec671f667bULL, 0xe51c79a85916f484ULL, 0x82b7e12780e7401aULL,
+	0x8f31cc0937ae58d2ULL, 0xd1b2ecb8b0908810ULL, 0xb2fe3f0b8599ef07ULL, 0x861fa7e6dcb4aa15ULL,
+	0xdfbdcece67006ac9ULL, 0x67a791e093e1d49aULL, 0x8bd6a141006042bdULL, 0xe0c8bb2c5c6d24e0ULL,
+	0xaecc49914078536dULL, 0x58fae9f773886e18ULL, 0xda7f5bf590966848ULL, 0xaf39a475506a899eULL,
+	0x888f99797a5e012dULL, 0x6d8406c952429603ULL, 0xaab37fd7d8f58178ULL, 0xc8e5087ba6d33b83ULL,
+	0xd5605fcdcf32e1d6ULL, 0xfb1e4a9a90880a64ULL, 0x855c3be0a17fcd26ULL, 0x5cf2eea09a55067fULL,
+	0xa6b34ad8c9dfc06fULL, 0xf42faa48c0ea481eULL, 0xd0601d8efc57b08bULL, 0xf13b94daf124da26ULL,
+	0x823c12795db6ce57ULL, 0x76c53d08d6b70858ULL, 0xa2cb1717b52481edULL, 0x54768c4b0c64ca6eULL,
+	0xcb7ddcdda26da268ULL, 0xa9942f5dcf7dfd09ULL, 0xfe5d54150b090b02ULL, 0xd3f93b35435d7c4cULL,
+	0x9efa548d26e5a6e1ULL, 0xc47bc5014a1a6dafULL, 0xc6b8e9b0709f109aULL, 0x359ab6419ca1091bULL,
+	0xf867241c8cc6d4c0ULL, 0xc30163d203c94b62ULL, 0x9b407691d7fc44f8ULL, 0x79e0de63425dcf1dULL,
+	0xc21094364dfb5636ULL, 0x985915fc12f542e4ULL, 0xf294b943e17a2bc4ULL, 0x3e6f5b7b17b2939dULL,
+	0x979cf3ca6cec5b5aULL, 0xa705992ceecf9c42ULL, 0xbd8430bd08277231ULL, 0x50c6ff782a838353ULL,
+	0xece53cec4a314ebdULL, 0xa4f8bf5635246428ULL, 0x940f4613ae5ed136ULL, 0x871b7795e136be99ULL,
+	0xb913179899f68584ULL, 0x28e2557b59846e3fULL, 0xe757dd7ec07426e5ULL, 0x331aeada2fe589cfULL,
+	0x9096ea6f3848984fULL, 0x3ff0d2c85def7621ULL, 0xb4bca50b065abe63ULL, 0x0fed077a756b53a9ULL,
+	0xe1ebce4dc7f16dfbULL, 0xd3e8495912c62894ULL, 0x8d3360f09cf6e4bdULL, 0x64712dd7abbbd95cULL,
+	0xb080392cc4349decULL, 0xbd8d794d96aacfb3ULL, 0xdca04777f541c567ULL, 0xecf0d7a0fc5583a0ULL,
+	0x89e42caaf9491b60ULL, 0xf41686c49db57244ULL, 0xac5d37d5b79b6239ULL, 0x311c2875c522ced5ULL,
+	0xd77485cb25823ac7ULL, 0x7d633293366b828bULL, 0x86a8d39ef77164bcULL, 0xae5dff9c02033197ULL,
+	0xa8530886b54dbdebULL, 0xd9f57f830283fdfcULL, 0xd267caa862a12d66ULL, 0xd072df63c324fd7bULL,
+	0x8380dea93da4bc60ULL, 0x4247cb9e59f71e6dULL, 0xa46116538d0deb78ULL, 0x52d9be85f074e608ULL,
+	0xcd795be870516656ULL, 0x67902e276c921f8bULL, 0x806bd9714632dff6ULL, 0x00ba1cd8a3db53b6ULL,
+	0xa086cfcd97bf97f3ULL, 0x80e8a40eccd228a4ULL, 0xc8a883c0fdaf7df0ULL, 0x6122cd128006b2cdULL,
+	0xfad2a4b13d1b5d6cULL, 0x796b805720085f81ULL, 0x9cc3a6eec6311a63ULL, 0xcbe3303674053bb0ULL,
+	0xc3f490aa77bd60fcULL, 0xbedbfc4411068a9cULL, 0xf4f1b4d515acb93bULL, 0xee92fb5515482d44ULL,
+	0x991711052d8bf3c5ULL, 0x751bdd152d4d1c4aULL, 0xbf5cd54678eef0b6ULL, 0xd262d45a78a0635dULL,
+	0xef340a98172aace4ULL, 0x86fb897116c87c34ULL, 0x9580869f0e7aac0eULL, 0xd45d35e6ae3d4da0ULL,
+	0xbae0a846d2195712ULL, 0x8974836059cca109ULL, 0xe998d258869facd7ULL, 0x2bd1a438703fc94bULL,
+	0x91ff83775423cc06ULL, 0x7b6306a34627ddcfULL, 0xb67f6455292cbf08ULL, 0x1a3bc84c17b1d542ULL,
+	0xe41f3d6a7377eecaULL, 0x20caba5f1d9e4a93ULL, 0x8e938662882af53eULL, 0x547eb47b7282ee9cULL,
+	0xb23867fb2a35b28dULL, 0xe99e619a4f23aa43ULL, 0xdec681f9f4c31f31ULL, 0x6405fa00e2ec94d4ULL,
+	0x8b3c113c38f9f37eULL, 0xde83bc408dd3dd04ULL, 0xae0b158b4738705eULL, 0x9624ab50b148d445ULL,
+	0xd98ddaee19068c76ULL, 0x3badd624dd9b0957ULL, 0x87f8a8d4cfa417c9ULL, 0xe54ca5d70a80e5d6ULL,
+	0xa9f6d30a038d1dbcULL, 0x5e9fcf4ccd211f4cULL, 0xd47487cc8470652bULL, 0x7647c3200069671fULL,
+	0x84c8d4dfd2c63f3bULL, 0x29ecd9f40041e073ULL, 0xa5fb0a17c777cf09ULL, 0xf468107100525890ULL,
+	0xcf79cc9db955c2ccULL, 0x7182148d4066eeb4ULL, 0x81ac1fe293d599bfULL, 0xc6f14cd848405530ULL,
+	0xa21727db38cb002fULL, 0xb8ada00e5a506a7cULL, 0xca9cf1d206fdc03bULL, 0xa6d90811f0e4851cULL,
+	0xfd442e4688bd304aULL, 0x908f4a166d1da663ULL, 0x9e4a9cec15763e2eULL, 0x9a598e4e043287feULL,
+	0xc5dd44271ad3cdbaULL, 0x40eff1e1853f29fdULL, 0xf7549530e188c128ULL, 0xd12bee59e68ef47cULL,
+	0x9a94dd3e8cf578b9ULL, 0x82bb74f8301958ceULL, 0xc13a148e3032d6e7ULL, 0xe36a52363c1faf01ULL,
+	0xf18899b1bc3f8ca1ULL, 0xdc44e6c3cb279ac1ULL, 0x96f5600f15a7b7e5ULL, 0x29ab103a5ef8c0b9ULL,
+	0xbcb2b812db11a5deULL, 0x7415d448f6b6f0e7ULL, 0xebdf661791d60f56ULL, 0x111b495b3464ad21ULL,
+	0x936b9fcebb25c995ULL, 0xcab10dd900beec34ULL, 0xb84687c269ef3bfbULL, 0x3d5d514f40eea742ULL,
+	0xe65829b3046b0afaULL, 0x0cb4a5a3112a5112ULL, 0x8ff71a0fe2c2e6dcULL, 0x47f0e785eaba72abULL,
+	0xb3f4e093db73a093ULL, 0x59ed216765690f56ULL, 0xe0f218b8d25088b8ULL, 0x306869c13ec3532cULL,
+	0x8c974f7383725573ULL, 0x1e414218c73a13fbULL, 0xafbd2350644eeacfULL, 0xe5d1929ef90898faULL,
+	0xdbac6c247d62a583ULL, 0xdf45f746b74abf39ULL, 0x894bc396ce5da772ULL, 0x6b8bba8c328eb783ULL,
+	0xab9eb47c81f5114fULL, 0x066ea92f3f326564ULL, 0xd686619ba27255a2ULL, 0xc80a537b0efefebdULL,
+	0x8613fd0145877585ULL, 0xbd06742ce95f5f36ULL, 0xa798fc4196e952e7ULL, 0x2c48113823b73704ULL,
+	0xd17f3b51fca3a7a0ULL, 0xf75a15862ca504c5ULL, 0x82ef85133de648c4ULL, 0x9a984d73dbe722fbULL,
+	0xa3ab66580d5fdaf5ULL, 0xc13e60d0d2e0ebbaULL, 0xcc963fee10b7d1b3ULL, 0x318df905079926a8ULL,
+	0xffbbcfe994e5c61fULL, 0xfdf17746497f7052ULL, 0x9fd561f1fd0f9bd3ULL, 0xfeb6ea8bedefa633ULL,
+	0xc7caba6e7c5382c8ULL, 0xfe64a52ee96b8fc0ULL, 0xf9bd690a1b68637bULL, 0x3dfdce7aa3c673b0ULL,
+	0x9c1661a651213e2dULL, 0x06bea10ca65c084eULL, 0xc31bfa0fe5698db8ULL, 0x486e494fcff30a62ULL,
+	0xf3e2f893dec3f126ULL, 0x5a89dba3c3efccfaULL, 0x986ddb5c6b3a76b7ULL, 0xf89629465a75e01cULL,
+	0xbe89523386091465ULL, 0xf6bbb397f1135823ULL, 0xee2ba6c0678b597fULL, 0x746aa07ded582e2cULL,
+	0x94db483840b717efULL, 0xa8c2a44eb4571cdcULL, 0xba121a4650e4ddebULL, 0x92f34d62616ce413ULL,
+	0xe896a0d7e51e1566ULL, 0x77b020baf9c81d17ULL, 0x915e2486ef32cd60ULL, 0x0ace1474dc1d122eULL,
+	0xb5b5ada8aaff80b8ULL, 0x0d819992132456baULL, 0xe3231912d5bf60e6ULL, 0x10e1fff697ed6c69ULL,
+	0x8df5efabc5979c8fULL, 0xca8d3ffa1ef463c1ULL, 0xb1736b96b6fd83b3ULL, 0xbd308ff8a6b17cb2ULL,
+	0xddd0467c64bce4a0ULL, 0xac7cb3f6d05ddbdeULL, 0x8aa22c0dbef60ee4ULL, 0x6bcdf07a423aa96bULL,
+	0xad4ab7112eb3929dULL, 0x86c16c98d2c953c6ULL, 0xd89d64d57a607744ULL, 0xe871c7bf077ba8b7ULL,
+	0x87625f056c7c4a8bULL, 0x11471cd764ad4972ULL, 0xa93af6c6c79b5d2dULL, 0xd598e40d3dd89bcfULL,
+	0xd389b47879823479ULL, 0x4aff1d108d4ec2c3ULL, 0x843610cb4bf160cbULL, 0xcedf722a585139baULL,
+	0xa54394fe1eedb8feULL, 0xc2974eb4ee658828ULL, 0xce947a3da6a9273eULL, 0x733d226229feea32ULL,
+	0x811ccc668829b887ULL, 0x0806357d5a3f525fULL, 0xa163ff802a3426a8ULL, 0xca07c2dcb0cf26f7ULL,
+	0xc9bcff6034c13052ULL, 0xfc89b393dd02f0b5ULL, 0xfc2c3f3841f17c67ULL, 0xbbac2078d443ace2ULL,
+	0x9d9ba7832936edc0ULL, 0xd54b944b84aa4c0dULL, 0xc5029163f384a931ULL, 0x0a9e795e65d4df11ULL,
+	0xf64335bcf065d37dULL, 0x4d4617b5ff4a16d5ULL, 0x99ea0196163fa42eULL, 0x504bced1bf8e4e45ULL,
+	0xc06481fb9bcf8d39ULL, 0xe45ec2862f71e1d6ULL, 0xf07da27a82c37088ULL, 0x5d767327bb4e5a4cULL,
+	0x964e858c91ba2655ULL, 0x3a6a07f8d510f86fULL, 0xbbe226efb628afeaULL, 0x890489f70a55368bULL,
+	0xeadab0aba3b2dbe5ULL, 0x2b45ac74ccea842eULL, 0x92c8ae6b464fc96fULL, 0x3b0b8bc90012929dULL,
+	0xb77ada0617e3bbcbULL, 0x09ce6ebb40173744ULL, 0xe55990879ddcaabdULL, 0xcc420a6a101d0515ULL,
+	0x8f57fa54c2a9eab6ULL, 0x9fa946824a12232dULL, 0xb32df8e9f3546564ULL, 0x47939822dc96abf9ULL,
+	0xdff9772470297ebdULL, 0x59787e2b93bc56f7ULL, 0x8bfbea76c619ef36ULL, 0x57eb4edb3c55b65aULL,
+	0xaefae51477a06b03ULL, 0xede622920b6b23f1ULL, 0xdab99e59958885c4ULL, 0xe95fab368e45ecedULL,
+	0x88b402f7fd75539bULL, 0x11dbcb0218ebb414ULL, 0xaae103b5fcd2a881ULL, 0xd652bdc29f26a119ULL,
+	0xd59944a37c0752a2ULL, 0x4be76d3346f0495fULL, 0x857fcae62d8493a5ULL, 0x6f70a4400c562ddbULL,
+	0xa6dfbd9fb8e5b88eULL, 0xcb4ccd500f6bb952ULL, 0xd097ad07a71f26b2ULL, 0x7e2000a41346a7a7ULL,
+	0x825ecc24c873782fULL, 0x8ed400668c0c28c8ULL, 0xa2f67f2dfa90563bULL, 0x728900802f0f32faULL,
+	0xcbb41ef979346bcaULL, 0x4f2b40a03ad2ffb9ULL, 0xfea126b7d78186bcULL, 0xe2f610c84987bfa8ULL,
+	0x9f24b832e6b0f436ULL, 0x0dd9ca7d2df4d7c9ULL, 0xc6ede63fa05d3143ULL, 0x91503d1c79720dbbULL,
+	0xf8a95fcf88747d94ULL, 0x75a44c6397ce912aULL, 0x9b69dbe1b548ce7cULL, 0xc986afbe3ee11abaULL,
+	0xc24452da229b021bULL, 0xfbe85badce996168ULL, 0xf2d56790ab41c2a2ULL, 0xfae27299423fb9c3ULL,
+	0x97c560ba6b0919a5ULL, 0xdccd879fc967d41aULL, 0xbdb6b8e905cb600fULL, 0x5400e987bbc1c920ULL,
+	0xed246723473e3813ULL, 0x290123e9aab23b68ULL, 0x9436c0760c86e30bULL, 0xf9a0b6720aaf6521ULL,
+	0xb94470938fa89bceULL, 0xf808e40e8d5b3e69ULL, 0xe7958cb87392c2c2ULL, 0xb60b1d1230b20e04ULL,
+	0x90bd77f3483bb9b9ULL, 0xb1c6f22b5e6f48c2ULL, 0xb4ecd5f01a4aa828ULL, 0x1e38aeb6360b1af3ULL,
+	0xe2280b6c20dd5232ULL, 0x25c6da63c38de1b0ULL, 0x8d590723948a535fULL, 0x579c487e5a38ad0eULL,
+	0xb0af48ec79ace837ULL, 0x2d835a9df0c6d851ULL, 0xdcdb1b2798182244ULL, 0xf8e431456cf88e65ULL,
+	0x8a08f0f8bf0f156bULL, 0x1b8e9ecb641b58ffULL, 0xac8b2d36eed2dac5ULL, 0xe272467e3d222f3fULL,
+	0xd7adf884aa879177ULL, 0x5b0ed81dcc6abb0fULL, 0x86ccbb52ea94baeaULL, 0x98e947129fc2b4e9ULL,
+	0xa87fea27a539e9a5ULL, 0x3f2398d747b36224ULL, 0xd29fe4b18e88640eULL, 0x8eec7f0d19a03aadULL,
+	0x83a3eeeef9153e89ULL, 0x1953cf68300424acULL, 0xa48ceaaab75a8e2bULL, 0x5fa8c3423c052dd7ULL,
+	0xcdb02555653131b6ULL, 0x3792f412cb06794dULL, 0x808e17555f3ebf11ULL, 0xe2bbd88bbee40bd0ULL,
+	0xa0b19d2ab70e6ed6ULL, 0x5b6aceaeae9d0ec4ULL, 0xc8de047564d20a8bULL, 0xf245825a5a445275ULL,
+	0xfb158592be068d2eULL, 0xeed6e2f0f0d56712ULL, 0x9ced737bb6c4183dULL, 0x55464dd69685606bULL,
+	0xc428d05aa4751e4cULL, 0xaa97e14c3c26b886ULL, 0xf53304714d9265dfULL, 0xd53dd99f4b3066a8ULL,
+	0x993fe2c6d07b7fabULL, 0xe546a8038efe4029ULL, 0xbf8fdb78849a5f96ULL, 0xde98520472bdd033ULL,
+	0xef73d256a5c0f77cULL, 0x963e66858f6d4440ULL, 0x95a8637627989aadULL, 0xdde7001379a44aa8ULL,
+	0xbb127c53b17ec159ULL, 0x5560c018580d5d52ULL, 0xe9d71b689dde71afULL, 0xaab8f01e6e10b4a6ULL,
+	0x9226712162ab070dULL, 0xcab3961304ca70e8ULL, 0xb6b00d69bb55c8d1ULL, 0x3d607b97c5fd0d22ULL,
+	0xe45c10c42a2b3b05ULL, 0x8cb89a7db77c506aULL, 0x8eb98a7a9a5b04e3ULL, 0x77f3608e92adb242ULL,
+	0xb267ed1940f1c61cULL, 0x55f038b237591ed3ULL, 0xdf01e85f912e37a3ULL, 0x6b6c46dec52f6688ULL,
+	0x8b61313bbabce2c6ULL, 0x2323ac4b3b3da015ULL, 0xae397d8aa96c1b77ULL, 0xabec975e0a0d081aULL,
+	0xd9c7dced53c72255ULL, 0x96e7bd358c904a21ULL, 0x881cea14545c7575ULL, 0x7e50d64177da2e54ULL,
+	0xaa242499697392d2ULL, 0xdde50bd1d5d0b9e9ULL, 0xd4ad2dbfc3d07787ULL, 0x955e4ec64b44e864ULL,
+	0x84ec3c97da624ab4ULL, 0xbd5af13bef0b113eULL, 0xa6274bbdd0fadd61ULL, 0xecb1ad8aeacdd58eULL,
+	0xcfb11ead453994baULL, 0x67de18eda5814af2ULL, 0x81ceb32c4b43fcf4ULL, 0x80eacf948770ced7ULL,
+	0xa2425ff75e14fc31ULL, 0xa1258379a94d028dULL, 0xcad2f7f5359a3b3eULL, 0x096ee45813a04330ULL,
+	0xfd87b5f28300ca0dULL, 0x8bca9d6e188853fcULL, 0x9e74d1b791e07e48ULL, 0x775ea264cf55347eULL,
+	0xc612062576589ddaULL, 0x95364afe032a819eULL, 0xf79687aed3eec551ULL, 0x3a83ddbd83f52205ULL,
+	0x9abe14cd44753b52ULL, 0xc4926a9672793543ULL, 0xc16d9a0095928a27ULL, 0x75b7053c0f178294ULL,
+	0xf1c90080baf72cb1ULL, 0x5324c68b12dd6339ULL, 0x971da05074da7beeULL, 0xd3f6fc16ebca5e04ULL,
+	0xbce5086492111aeaULL, 0x88f4bb1ca6bcf585ULL, 0xec1e4a7db69561a5ULL, 0x2b31e9e3d06c32e6ULL,
+	0x9392ee8e921d5d07ULL, 0x3aff322e62439fd0ULL, 0xb877aa3236a4b449ULL, 0x09befeb9fad487c3ULL,
+	0xe69594bec44de15bULL, 0x4c2ebe687989a9b4ULL, 0x901d7cf73ab0acd9ULL, 0x0f9d37014bf60a11ULL,
+	0xb424dc35095cd80fULL, 0x538484c19ef38c95ULL, 0xe12e13424bb40e13ULL, 0x2865a5f206b06fbaULL,
+	0x8cbccc096f5088cbULL, 0xf93f87b7442e45d4ULL, 0xafebff0bcb24aafeULL, 0xf78f69a51539d749ULL,
+	0xdbe6fecebdedd5beULL, 0xb573440e5a884d1cULL, 0x89705f4136b4a597ULL, 0x31680a88f8953031ULL,
+	0xabcc77118461cefcULL, 0xfdc20d2b36ba7c3eULL, 0xd6bf94d5e57a42bcULL, 0x3d32907604691b4dULL,
+	0x8637bd05af6c69b5ULL, 0xa63f9a49c2c1b110ULL, 0xa7c5ac471b478423ULL, 0x0fcf80dc33721d54ULL,
+	0xd1b71758e219652bULL, 0xd3c36113404ea4a9ULL, 0x83126e978d4fdf3bULL, 0x645a1cac083126eaULL,
+	0xa3d70a3d70a3d70aULL, 0x3d70a3d70a3d70a4ULL, 0xccccccccccccccccULL, 0xcccccccccccccccdULL,
+	0x8000000000000000ULL, 0x0000000000000000ULL, 0xa000000000000000ULL, 0x0000000000000000ULL,
+	0xc800000000000000ULL, 0x0000000000000000ULL, 0xfa00000000000000ULL, 0x0000000000000000ULL,
+	0x9c40000000000000ULL, 0x0000000000000000ULL, 0xc350000000000000ULL, 0x0000000000000000ULL,
+	0xf424000000000000ULL, 0x0000000000000000ULL, 0x9896800000000000ULL, 0x0000000000000000ULL,
+	0xbebc200000000000ULL, 0x0000000000000000ULL, 0xee6b280000000000ULL, 0x0000000000000000ULL,
+	0x9502f90000000000ULL, 0x0000000000000000ULL, 0xba43b74000000000ULL, 0x0000000000000000ULL,
+	0xe8d4a51000000000ULL, 0x0000000000000000ULL, 0x9184e72a00000000ULL, 0x0000000000000000ULL,
+	0xb5e620f480000000ULL, 0x0000000000000000ULL, 0xe35fa931a0000000ULL, 0x0000000000000000ULL,
+	0x8e1bc9bf04000000ULL, 0x0000000000000000ULL, 0xb1a2bc2ec5000000ULL, 0x0000000000000000ULL,
+	0xde0b6b3a76400000ULL, 0x0000000000000000ULL, 0x8ac7230489e80000ULL, 0x0000000000000000ULL,
+	0xad78ebc5ac620000ULL, 0x0000000000000000ULL, 0xd8d726b7177a8000ULL, 0x0000000000000000ULL,
+	0x878678326eac9000ULL, 0x0000000000000000ULL, 0xa968163f0a57b400ULL, 0x0000000000000000ULL,
+	0xd3c21bcecceda100ULL, 0x0000000000000000ULL, 0x84595161401484a0ULL, 0x0000000000000000ULL,
+	0xa56fa5b99019a5c8ULL, 0x0000000000000000ULL, 0xcecb8f27f4200f3aULL, 0x0000000000000000ULL,
+	0x813f3978f8940984ULL, 0x4000000000000000ULL, 0xa18f07d736b90be5ULL, 0x5000000000000000ULL,
+	0xc9f2c9cd04674edeULL, 0xa400000000000000ULL, 0xfc6f7c4045812296ULL, 0x4d00000000000000ULL,
+	0x9dc5ada82b70b59dULL, 0xf020000000000000ULL, 0xc5371912364ce305ULL, 0x6c28000000000000ULL,
+	0xf684df56c3e01bc6ULL, 0xc732000000000000ULL, 0x9a130b963a6c115cULL, 0x3c7f400000000000ULL,
+	0xc097ce7bc90715b3ULL, 0x4b9f100000000000ULL, 0xf0bdc21abb48db20ULL, 0x1e86d40000000000ULL,
+	0x96769950b50d88f4ULL, 0x1314448000000000ULL, 0xbc143fa4e250eb31ULL, 0x17d955a000000000ULL,
+	0xeb194f8e1ae525fdULL, 0x5dcfab0800000000ULL, 0x92efd1b8d0cf37beULL, 0x5aa1cae500000000ULL,
+	0xb7abc627050305adULL, 0xf14a3d9e40000000ULL, 0xe596b7b0c643c719ULL, 0x6d9ccd05d0000000ULL,
+	0x8f7e32ce7bea5c6fULL, 0xe4820023a2000000ULL, 0xb35dbf821ae4f38bULL, 0xdda2802c8a800000ULL,
+	0xe0352f62a19e306eULL, 0xd50b2037ad200000ULL, 0x8c213d9da502de45ULL, 0x4526f422cc340000ULL,
+	0xaf298d050e4395d6ULL, 0x9670b12b7f410000ULL, 0xdaf3f04651d47b4cULL, 0x3c0cdd765f114000ULL,
+	0x88d8762bf324cd0fULL, 0xa5880a69fb6ac800ULL, 0xab0e93b6efee0053ULL, 0x8eea0d047a457a00ULL,
+	0xd5d238a4abe98068ULL, 0x72a4904598d6d880ULL, 0x85a36366eb71f041ULL, 0x47a6da2b7f864750ULL,
+	0xa70c3c40a64e6c51ULL, 0x999090b65f67d924ULL, 0xd0cf4b50cfe20765ULL, 0xfff4b4e3f741cf6dULL,
+	0x82818f1281ed449fULL, 0xbff8f10e7a8921a4ULL, 0xa321f2d7226895c7ULL, 0xaff72d52192b6a0dULL,
+	0xcbea6f8ceb02bb39ULL, 0x9bf4f8a69f764490ULL, 0xfee50b7025c36a08ULL, 0x02f236d04753d5b4ULL,
+	0x9f4f2726179a2245ULL, 0x01d762422c946590ULL, 0xc722f0ef9d80aad6ULL, 0x424d3ad2b7b97ef5ULL,
+	0xf8ebad2b84e0d58bULL, 0xd2e0898765a7deb2ULL, 0x9b934c3b330c8577ULL, 0x63cc55f49f88eb2fULL,
+	0xc2781f49ffcfa6d5ULL, 0x3cbf6b71c76b25fbULL, 0xf316271c7fc3908aULL, 0x8bef464e3945ef7aULL,
+	0x97edd871cfda3a56ULL, 0x97758bf0e3cbb5acULL, 0xbde94e8e43d0c8ecULL, 0x3d52eeed1cbea317ULL,
+	0xed63a231d4c4fb27ULL, 0x4ca7aaa863ee4bddULL, 0x945e455f24fb1cf8ULL, 0x8fe8caa93e74ef6aULL,
+	0xb975d6b6ee39e436ULL, 0xb3e2fd538e122b44ULL, 0xe7d34c64a9c85d44ULL, 0x60dbbca87196b616ULL,
+	0x90e40fbeea1d3a4aULL, 0xbc8955e946fe31cdULL, 0xb51d13aea4a488ddULL, 0x6babab6398bdbe41ULL,
+	0xe264589a4dcdab14ULL, 0xc696963c7eed2dd1ULL, 0x8d7eb76070a08aecULL, 0xfc1e1de5cf543ca2ULL,
+	0xb0de65388cc8ada8ULL, 0x3b25a55f43294bcbULL, 0xdd15fe86affad912ULL, 0x49ef0eb713f39ebeULL,
+	0x8a2dbf142dfcc7abULL, 0x6e3569326c784337ULL, 0xacb92ed9397bf996ULL, 0x49c2c37f07965404ULL,
+	0xd7e77a8f87daf7fbULL, 0xdc33745ec97be906ULL, 0x86f0ac99b4e8dafdULL, 0x69a028bb3ded71a3ULL,
+	0xa8acd7c0222311bcULL, 0xc40832ea0d68ce0cULL, 0xd2d80db02aabd62bULL, 0xf50a3fa490c30190ULL,
+	0x83c7088e1aab65dbULL, 0x792667c6da79e0faULL, 0xa4b8cab1a1563f52ULL, 0x577001b891185938ULL,
+	0xcde6fd5e09abcf26ULL, 0xed4c0226b55e6f86ULL, 0x80b05e5ac60b6178ULL, 0x544f8158315b05b4ULL,
+	0xa0dc75f1778e39d6ULL, 0x696361ae3db1c721ULL, 0xc913936dd571c84cULL, 0x03bc3a19cd1e38e9ULL,
+	0xfb5878494ace3a5fULL, 0x04ab48a04065c723ULL, 0x9d174b2dcec0e47bULL, 0x62eb0d64283f9c76ULL,
+	0xc45d1df942711d9aULL, 0x3ba5d0bd324f8394ULL, 0xf5746577930d6500ULL, 0xca8f44ec7ee36479ULL,
+	0x9968bf6abbe85f20ULL, 0x7e998b13cf4e1ecbULL, 0xbfc2ef456ae276e8ULL, 0x9e3fedd8c321a67eULL,
+	0xefb3ab16c59b14a2ULL, 0xc5cfe94ef3ea101eULL, 0x95d04aee3b80ece5ULL, 0xbba1f1d158724a12ULL,
+	0xbb445da9ca61281fULL, 0x2a8a6e45ae8edc97ULL, 0xea1575143cf97226ULL, 0xf52d09d71a3293bdULL,
+	0x924d692ca61be758ULL, 0x593c2626705f9c56ULL, 0xb6e0c377cfa2e12eULL, 0x6f8b2fb00c77836cULL,
+	0xe498f455c38b997aULL, 0x0b6dfb9c0f956447ULL, 0x8edf98b59a373fecULL, 0x4724bd4189bd5eacULL,
+	0xb2977ee300c50fe7ULL, 0x58edec91ec2cb657ULL, 0xdf3d5e9bc0f653e1ULL, 0x2f2967b66737e3edULL,
+	0x8b865b215899f46cULL, 0xbd79e0d20082ee74ULL, 0xae67f1e9aec07187ULL, 0xecd8590680a3aa11ULL,
+	0xda01ee641a708de9ULL, 0xe80e6f4820cc9495ULL, 0x884134fe908658b2ULL, 0x3109058d147fdcddULL,
+	0xaa51823e34a7eedeULL, 0xbd4b46f0599fd415ULL, 0xd4e5e2cdc1d1ea96ULL, 0x6c9e18ac7007c91aULL,
+	0x850fadc09923329eULL, 0x03e2cf6bc604ddb0ULL, 0xa6539930bf6bff45ULL, 0x84db8346b786151cULL,
+	0xcfe87f7cef46ff16ULL, 0xe612641865679a63ULL, 0x81f14fae158c5f6eULL, 0x4fcb7e8f3f60c07eULL,
+	0xa26da3999aef7749ULL, 0xe3be5e330f38f09dULL, 0xcb090c8001ab551cULL, 0x5cadf5bfd3072cc5ULL,
+	0xfdcb4fa002162a63ULL, 0x73d9732fc7c8f7f6ULL, 0x9e9f11c4014dda7eULL, 0x2867e7fddcdd9afaULL,
+	0xc646d63501a1511dULL, 0xb281e1fd541501b8ULL, 0xf7d88bc24209a565ULL, 0x1f225a7ca91a4226ULL,
+	0x9ae757596946075fULL, 0x3375788de9b06958ULL, 0xc1a12d2fc3978937ULL, 0x0052d6b1641c83aeULL,
+	0xf209787bb47d6b84ULL, 0xc0678c5dbd23a49aULL, 0x9745eb4d50ce6332ULL, 0xf840b7ba963646e0ULL,
+	0xbd176620a501fbffULL, 0xb650e5a93bc3d898ULL, 0xec5d3fa8ce427affULL, 0xa3e51f138ab4cebeULL,
+	0x93ba47c980e98cdfULL, 0xc66f336c36b10137ULL, 0xb8a8d9bbe123f017ULL, 0xb80b0047445d4184ULL,
+	0xe6d3102ad96cec1dULL, 0xa60dc059157491e5ULL, 0x9043ea1ac7e41392ULL, 0x87c89837ad68db2fULL,
+	0xb454e4a179dd1877ULL, 0x29babe4598c311fbULL, 0xe16a1dc9d8545e94ULL, 0xf4296dd6fef3d67aULL,
+	0x8ce2529e2734bb1dULL, 0x1899e4a65f58660cULL, 0xb01ae745b101e9e4ULL, 0x5ec05dcff72e7f8fULL,
+	0xdc21a1171d42645dULL, 0x76707543f4fa1f73ULL, 0x899504ae72497ebaULL, 0x6a06494a791c53a8ULL,
+	0xabfa45da0edbde69ULL, 0x0487db9d17636892ULL, 0xd6f8d7509292d603ULL, 0x45a9d2845d3c42b6ULL,
+	0x865b86925b9bc5c2ULL, 0x0b8a2392ba45a9b2ULL, 0xa7f26836f282b732ULL, 0x8e6cac7768d7141eULL,
+	0xd1ef0244af2364ffULL, 0x3207d795430cd926ULL, 0x8335616aed761f1fULL, 0x7f44e6bd49e807b8ULL,
+	0xa402b9c5a8d3a6e7ULL, 0x5f16206c9c6209a6ULL, 0xcd036837130890a1ULL, 0x36dba887c37a8c0fULL,
+	0x802221226be55a64ULL, 0xc2494954da2c9789ULL, 0xa02aa96b06deb0fdULL, 0xf2db9baa10b7bd6cULL,
+	0xc83553c5c8965d3dULL, 0x6f92829494e5acc7ULL, 0xfa42a8b73abbf48cULL, 0xcb772339ba1f17f9ULL,
+	0x9c69a97284b578d7ULL, 0xff2a760414536efbULL, 0xc38413cf25e2d70dULL, 0xfef5138519684abaULL,
+	0xf46518c2ef5b8cd1ULL, 0x7eb258665fc25d69ULL, 0x98bf2f79d5993802ULL, 0xef2f773ffbd97a61ULL,
+	0xbeeefb584aff8603ULL, 0xaafb550ffacfd8faULL, 0xeeaaba2e5dbf6784ULL, 0x95ba2a53f983cf38ULL,
+	0x952ab45cfa97a0b2ULL, 0xdd945a747bf26183ULL, 0xba756174393d88dfULL, 0x94f971119aeef9e4ULL,
+	0xe912b9d1478ceb17ULL, 0x7a37cd5601aab85dULL, 0x91abb422ccb812eeULL, 0xac62e055c10ab33aULL,
+	0xb616a12b7fe617aaULL, 0x577b986b314d6009ULL, 0xe39c49765fdf9d94ULL, 0xed5a7e85fda0b80bULL,
+	0x8e41ade9fbebc27dULL, 0x14588f13be847307ULL, 0xb1d219647ae6b31cULL, 0x596eb2d8ae258fc8ULL,
+	0xde469fbd99a05fe3ULL, 0x6fca5f8ed9aef3bbULL, 0x8aec23d680043beeULL, 0x25de7bb9480d5854ULL,
+	0xada72ccc20054ae9ULL, 0xaf561aa79a10ae6aULL, 0xd910f7ff28069da4ULL, 0x1b2ba1518094da04ULL,
+	0x87aa9aff79042286ULL, 0x90fb44d2f05d0842ULL, 0xa99541bf57452b28ULL, 0x353a1607ac744a53ULL,
+	0xd3fa922f2d1675f2ULL, 0x42889b8997915ce8ULL, 0x847c9b5d7c2e09b7ULL, 0x69956135febada11ULL,
+	0xa59bc234db398c25ULL, 0x43fab9837e699095ULL, 0xcf02b2c21207ef2eULL, 0x94f967e45e03f4bbULL,
+	0x8161afb94b44f57dULL, 0x1d1be0eebac278f5ULL, 0xa1ba1ba79e1632dcULL, 0x6462d92a69731732ULL,
+	0xca28a291859bbf93ULL, 0x7d7b8f7503cfdcfeULL, 0xfcb2cb35e702af78ULL, 0x5cda735244c3d43eULL,
+	0x9defbf01b061adabULL, 0x3a0888136afa64a7ULL, 0xc56baec21c7a1916ULL, 0x088aaa1845b8fdd0ULL,
+	0xf6c69a72a3989f5bULL, 0x8aad549e57273d45ULL, 0x9a3c2087a63f6399ULL, 0x36ac54e2f678864bULL,
+	0xc0cb28a98fcf3c7fULL, 0x84576a1bb416a7ddULL, 0xf0fdf2d3f3c30b9fULL, 0x656d44a2a11c51d5ULL,
+	0x969eb7c47859e743ULL, 0x9f644ae5a4b1b325ULL, 0xbc4665b596706114ULL, 0x873d5d9f0dde1feeULL,
+	0xeb57ff22fc0c7959ULL, 0xa90cb506d155a7eaULL, 0x9316ff75dd87cbd8ULL, 0x09a7f12442d588f2ULL,
+	0xb7dcbf5354e9beceULL, 0x0c11ed6d538aeb2fULL, 0xe5d3ef282a242e81ULL, 0x8f1668c8a86da5faULL,
+	0x8fa475791a569d10ULL, 0xf96e017d694487bcULL, 0xb38d92d760ec4455ULL, 0x37c981dcc395a9acULL,
+	0xe070f78d3927556aULL, 0x85bbe253f47b1417ULL, 0x8c469ab843b89562ULL, 0x93956d7478ccec8eULL,
+	0xaf58416654a6babbULL, 0x387ac8d1970027b2ULL, 0xdb2e51bfe9d0696aULL, 0x06997b05fcc0319eULL,
+	0x88fcf317f22241e2ULL, 0x441fece3bdf81f03ULL, 0xab3c2fddeeaad25aULL, 0xd527e81cad7626c3ULL,
+	0xd60b3bd56a5586f1ULL, 0x8a71e223d8d3b074ULL, 0x85c7056562757456ULL, 0xf6872d5667844e49ULL,
+	0xa738c6bebb12d16cULL, 0xb428f8ac016561dbULL, 0xd106f86e69d785c7ULL, 0xe13336d701beba52ULL,
+	0x82a45b450226b39cULL, 0xecc0024661173473ULL, 0xa34d721642b06084ULL, 0x27f002d7f95d0190ULL,
+	0xcc20ce9bd35c78a5ULL, 0x31ec038df7b441f4ULL, 0xff290242c83396ceULL, 0x7e67047175a15271ULL,
+	0x9f79a169bd203e41ULL, 0x0f0062c6e984d386ULL, 0xc75809c42c684dd1ULL, 0x52c07b78a3e60868ULL,
+	0xf92e0c3537826145ULL, 0xa7709a56ccdf8a82ULL, 0x9bbcc7a142b17ccbULL, 0x88a66076400bb691ULL,
+	0xc2abf989935ddbfeULL, 0x6acff893d00ea435ULL, 0xf356f7ebf83552feULL, 0x0583f6b8c4124d43ULL,
+	0x98165af37b2153deULL, 0xc3727a337a8b704aULL, 0xbe1bf1b059e9a8d6ULL, 0x744f18c0592e4c5cULL,
+	0xeda2ee1c7064130cULL, 0x1162def06f79df73ULL, 0x9485d4d1c63e8be7ULL, 0x8addcb5645ac2ba8ULL,
+	0xb9a74a0637ce2ee1ULL, 0x6d953e2bd7173692ULL, 0xe8111c87c5c1ba99ULL, 0xc8fa8db6ccdd0437ULL,
+	0x910ab1d4db9914a0ULL, 0x1d9c9892400a22a2ULL, 0xb54d5e4a127f59c8ULL, 0x2503beb6d00cab4bULL,
+	0xe2a0b5dc971f303aULL, 0x2e44ae64840fd61dULL, 0x8da471a9de737e24ULL, 0x5ceaecfed289e5d2ULL,
+	0xb10d8e1456105dadULL, 0x7425a83e872c5f47ULL, 0xdd50f1996b947518ULL, 0xd12f124e28f77719ULL,
+	0x8a5296ffe33cc92fULL, 0x82bd6b70d99aaa6fULL, 0xace73cbfdc0bfb7bULL, 0x636cc64d1001550bULL,
+	0xd8210befd30efa5aULL, 0x3c47f7e05401aa4eULL, 0x8714a775e3e95c78ULL, 0x65acfaec34810a71ULL,
+	0xa8d9d1535ce3b396ULL, 0x7f1839a741a14d0dULL, 0xd31045a8341ca07cULL, 0x1ede48111209a050ULL,
+	0x83ea2b892091e44dULL, 0x934aed0aab460432ULL, 0xa4e4b66b68b65d60ULL, 0xf81da84d5617853fULL,
+	0xce1de40642e3f4b9ULL, 0x36251260ab9d668eULL, 0x80d2ae83e9ce78f3ULL, 0xc1d72b7c6b426019ULL,
+	0xa1075a24e4421730ULL, 0xb24cf65b8612f81fULL, 0xc94930ae1d529cfcULL, 0xdee033f26797b627ULL,
+	0xfb9b7cd9a4a7443cULL, 0x169840ef017da3b1ULL, 0x9d412e0806e88aa5ULL, 0x8e1f289560ee864eULL,
+	0xc491798a08a2ad4eULL, 0xf1a6f2bab92a27e2ULL, 0xf5b5d7ec8acb58a2ULL, 0xae10af696774b1dbULL,
+	0x9991a6f3d6bf1765ULL, 0xacca6da1e0a8ef29ULL, 0xbff610b0cc6edd3fULL, 0x17fd090a58d32af3ULL,
+	0xeff394dcff8a948eULL, 0xddfc4b4cef07f5b0ULL, 0x95f83d0a1fb69cd9ULL, 0x4abdaf101564f98eULL,
+	0xbb764c4ca7a4440fULL, 0x9d6d1ad41abe37f1ULL, 0xea53df5fd18d5513ULL, 0x84c86189216dc5edULL,
+	0x92746b9be2f8552cULL, 0x32fd3cf5b4e49bb4ULL, 0xb7118682dbb66a77ULL, 0x3fbc8c33221dc2a1ULL,
+	0xe4d5e82392a40515ULL, 0x0fabaf3feaa5334aULL, 0x8f05b1163ba6832dULL, 0x29cb4d87f2a7400eULL,
+	0xb2c71d5bca9023f8ULL, 0x743e20e9ef511012ULL, 0xdf78e4b2bd342cf6ULL, 0x914da9246b255416ULL,
+	0x8bab8eefb6409c1aULL, 0x1ad089b6c2f7548eULL, 0xae9672aba3d0c320ULL, 0xa184ac2473b529b1ULL,
+	0xda3c0f568cc4f3e8ULL, 0xc9e5d72d90a2741eULL, 0x8865899617fb1871ULL, 0x7e2fa67c7a658892ULL,
+	0xaa7eebfb9df9de8dULL, 0xddbb901b98feeab7ULL, 0xd51ea6fa85785631ULL, 0x552a74227f3ea565ULL,
+	0x8533285c936b35deULL, 0xd53a88958f87275fULL, 0xa67ff273b8460356ULL, 0x8a892abaf368f137ULL,
+	0xd01fef10a657842cULL, 0x2d2b7569b0432d85ULL, 0x8213f56a67f6b29bULL, 0x9c3b29620e29fc73ULL,
+	0xa298f2c501f45f42ULL, 0x8349f3ba91b47b8fULL, 0xcb3f2f7642717713ULL, 0x241c70a936219a73ULL,
+	0xfe0efb53d30dd4d7ULL, 0xed238cd383aa0110ULL, 0x9ec95d1463e8a506ULL, 0xf4363804324a40aaULL,
+	0xc67bb4597ce2ce48ULL, 0xb143c6053edcd0d5ULL, 0xf81aa16fdc1b81daULL, 0xdd94b7868e94050aULL,
+	0x9b10a4e5e9913128ULL, 0xca7cf2b4191c8326ULL, 0xc1d4ce1f63f57d72ULL, 0xfd1c2f611f63a3f0ULL,
+	0xf24a01a73cf2dccfULL, 0xbc633b39673c8cecULL, 0x976e41088617ca01ULL, 0xd5be0503e085d813ULL,
+	0xbd49d14aa79dbc82ULL, 0x4b2d8644d8a74e18ULL, 0xec9c459d51852ba2ULL, 0xddf8e7d60ed1219eULL,
+	0x93e1ab8252f33b45ULL, 0xcabb90e5c942b503ULL, 0xb8da1662e7b00a17ULL, 0x3d6a751f3b936243ULL,
+	0xe7109bfba19c0c9dULL, 0x0cc512670a783ad4ULL, 0x906a617d450187e2ULL, 0x27fb2b80668b24c5ULL,
+	0xb484f9dc9641e9daULL, 0xb1f9f660802dedf6ULL, 0xe1a63853bbd26451ULL, 0x5e7873f8a0396973ULL,
+	0x8d07e33455637eb2ULL, 0xdb0b487b6423e1e8ULL, 0xb049dc016abc5e5fULL, 0x91ce1a9a3d2cda62ULL,
+	0xdc5c5301c56b75f7ULL, 0x7641a140cc7810fbULL, 0x89b9b3e11b6329baULL, 0xa9e904c87fcb0a9dULL,
+	0xac2820d9623bf429ULL, 0x546345fa9fbdcd44ULL, 0xd732290fbacaf133ULL, 0xa97c177947ad4095ULL,
+	0x867f59a9d4bed6c0ULL, 0x49ed8eabcccc485dULL, 0xa81f301449ee8c70ULL, 0x5c68f256bfff5a74ULL,
+	0xd226fc195c6a2f8cULL, 0x73832eec6fff3111ULL, 0x83585d8fd9c25db7ULL, 0xc831fd53c5ff7eabULL,
+	0xa42e74f3d032f525ULL, 0xba3e7ca8b77f5e55ULL, 0xcd3a1230c43fb26fULL, 0x28ce1bd2e55f35ebULL,
+	0x80444b5e7aa7cf85ULL, 0x7980d163cf5b81b3ULL, 0xa0555e361951c366ULL, 0xd7e105bcc332621fULL,
+	0xc86ab5c39fa63440ULL, 0x8dd9472bf3fefaa7ULL, 0xfa856334878fc150ULL, 0xb14f98f6f0feb951ULL,
+	0x9c935e00d4b9d8d2ULL, 0x6ed1bf9a569f33d3ULL, 0xc3b8358109e84f07ULL, 0x0a862f80ec4700c8ULL,
+	0xf4a642e14c6262c8ULL, 0xcd27bb612758c0faULL, 0x98e7e9cccfbd7dbdULL, 0x8038d51cb897789cULL,
+	0xbf21e44003acdd2cULL, 0xe0470a63e6bd56c3ULL, 0xeeea5d5004981478ULL, 0x1858ccfce06cac74ULL,
+	0x95527a5202df0ccbULL, 0x0f37801e0c43ebc8ULL, 0xbaa718e68396cffdULL, 0xd30560258f54e6baULL,
+	0xe950df20247c83fdULL, 0x47c6b82ef32a2069ULL, 0x91d28b7416cdd27eULL, 0x4cdc331d57fa5441ULL,
+	0xb6472e511c81471dULL, 0xe0133fe4adf8e952ULL, 0xe3d8f9e563a198e5ULL, 0x58180fddd97723a6ULL,
+	0x8e679c2f5e44ff8fULL, 0x570f09eaa7ea7648ULL
+};
+
+// Eisel-Lemire 所需的二进制浮点格式参数
+typedef struct scan_binary_format {
+	int mantissa_bits;  // 尾数显式位数
+	int min_exponent;   // -偏移量
+	int infinite_power; // 无穷大的指数域
+	int smallest_pow10; // q 小于此值时结果一定为 0
+	int largest_pow10;  // q 大于此值时结果一定为无穷大
+	int min_round_even; // 乘积可能恰好落在两个浮点数正中间的 q 范围
+	int max_round_even;
+} scan_binary_format;
+
+static const scan_binary_format scan_binary64 = { 52, -1023, 0x7FF, -342, 308, -4, 23 };
+static const scan_binary_format scan_binary32 = { 23, -127, 0xFF, -65, 38, -17, 10 };
+
+// 64 x 64 -> 128 位乘法，返回低 64 位
+static inline uint64_t scan_mul128(uint64_t a, uint64_t b, uint64_t* hi) {
+#ifdef __SIZEOF_INT128__
+	unsigned __int128 r = (unsigned __int128)a * b;
+	*hi = (uint64_t)(r >> 64);
+	return (uint64_t)r;
+#else
+	uint64_t a_lo = (uint32_t)a, a_hi = a >> 32, b_lo = (uint32_t)b, b_hi = b >> 32;
+	uint64_t ll = a_lo * b_lo, lh = a_lo * b_hi, hl = a_hi * b_lo, hh = a_hi * b_hi;
+	uint64_t mid = (ll >> 32) + (uint32_t)lh + (uint32_t)hl;
+	*hi = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+	return (mid << 32) | (uint32_t)ll;
+#endif
+}
+
+// w * 10^q 正确舍入到格式 b，返回指数域，*mantissa 为不含隐含位的尾数
+static int scan_eisel_lemire(uint64_t w, int64_t q, const scan_binary_format* b, uint64_t* mantissa) {
+	*mantissa = 0;
+	if (w == 0 || q < b->smallest_pow10) return 0;
+	if (q > b->largest_pow10) return b->infinite_power;
+
+	int lz = __builtin_clzll(w);
+	w <<= lz;
+
+	// 先只乘高 64 位；截断误差可能影响舍入时再补上低 64 位
+	const uint64_t* pow5 = &scan_pow5_128[2 * (q - SCAN_POW5_MIN)];
+	uint64_t precision_mask = UINT64_MAX >> (b->mantissa_bits + 3);
+	uint64_t hi;
+	uint64_t lo = scan_mul128(w, pow5[0], &hi);
+	if ((hi & precision_mask) == precision_mask) {
+		uint64_t hi2;
+		scan_mul128(w, pow5[1], &hi2);
+		lo += hi2;
+		if (hi2 > lo) hi++;
+	}
+
+	int upperbit = (int)(hi >> 63);
+	int shift = upperbit + 64 - b->mantissa_bits - 3;
+	uint64_t m = hi >> shift;
+	int power2 = (int)(((152170 + 65536) * (int)q) >> 16) + 63 + upperbit - lz - b->min_exponent;
+
+	if (power2 <= 0) { // 非规格化数
+		if (-power2 + 1 >= 64) return 0;
+		m >>= -power2 + 1;
+		m += m & 1;
+		m >>= 1;
+		*mantissa = m & ~(1ULL << b->mantissa_bits);
+		return m < (1ULL << b->mantissa_bits) ? 0 : 1;
+	}
+
+	// 恰好在正中间时舍入到偶数
+	if (lo <= 1 && q >= b->min_round_even && q <= b->max_round_even && (m & 3) == 1 && (m << shift) == hi) {
+		m &= ~1ULL;
+	}
+	m += m & 1;
+	m >>= 1;
+	if (m >= (2ULL << b->mantissa_bits)) {
+		m = 1ULL << b->mantissa_bits;
+		power2++;
+	}
+	if (power2 >= b->infinite_power) return b->infinite_power;
+	*mantissa = m & ~(1ULL << b->mantissa_bits);
+	return power2;
+}
+
+// 有效数字被截断时，w 和 w + 1 的结果相同才可信；返回 0 表示需要回退
+static int scan_decimal_bits(uint64_t w, int64_t q, int truncated, const scan_binary_format* b, uint64_t* bits) {
+	uint64_t m;
+	int e = scan_eisel_lemire(w, q, b, &m);
+	if (truncated) {
+		uint64_t m2;
+		if (scan_eisel_lemire(w + 1, q, b, &m2) != e || m2 != m) return 0;
+	}
+	*bits = m | ((uint64_t)e << b->mantissa_bits);
+	return 1;
+}
+
+// 浮点数字段的词法分析结果
+enum {
+	SCAN_REAL_DEC, // 十进制
+	SCAN_REAL_HEX, // 十六进制，交给 strtod
+	SCAN_REAL_INF,
+	SCAN_REAL_NAN,
+};
+
+typedef struct scan_real {
+	int kind;          // SCAN_REAL_*
+	int neg;           // 带负号
+	int truncated;     // 有效数字超过 19 位，w 只含前 19 位
+	uint64_t w;        // 十进制有效数字
+	int64_t q;         // 十进制指数
+	const char* body;  // 符号之后的字段内容，回退时使用
+	size_t len;
+} scan_real;
+
+// 不区分大小写地比较 ASCII 字面量
+static int scan_match_nocase(const char* p, const char* end, const char* lit) {
+	for (; *lit; lit++, p++) {
+		if (p >= end || (*p | 0x20) != *lit) return 0;
+	}
+	return 1;
+}
+
+// 解析指数部分，p 指向 'e' 或 'p'；后面没有数字时不消耗任何字符
+static const char* scan_real_exponent(const char* p, const char* end, int64_t* exp) {
+	const char* s = p + 1;
+	int neg = 0;
+	if (s < end && (*s == '+' || *s == '-')) {
+		neg = *s == '-';
+		s++;
+	}
+	if (s >= end || *s < '0' || *s > '9') return p;
+	int64_t e = 0;
+	while (s < end && *s >= '0' && *s <= '9') {
+		if (e < 0x10000000) e = e * 10 + (*s - '0');
+		s++;
+	}
+	*exp = neg ? -e : e;
+	return s;
+}
+
+// 超过 19 位数字时重新扫描尾数：跳过前导零，只保留前 19 位有效数字
+static void scan_real_significant(const char* p, const char* mant_end, int64_t exp, scan_real* r) {
+	uint64_t w = 0;
+	int taken = 0, started = 0, frac = 0;
+	for (; p < mant_end; p++) {
+		if (*p == '.') {
+			frac = 1;
+			continue;
+		}
+		unsigned d = (unsigned)(*p - '0');
+		if (!started && d == 0) {
+			if (frac) exp--;
+			continue;
+		}
+		started = 1;
+		if (taken < 19) {
+			w = w * 10 + d;
+			taken++;
+			if (frac) exp--;
+		}
+		else {
+			if (d) r->truncated = 1;
+			if (!frac) exp++;
+		}
+	}
+	r->w = w;
+	r->q = exp;
+}
+
+// 浮点数词法分析，语法与 strtod 相同：十进制、0x 十六进制、inf、infinity、nan、nan(...)。
+// 字段宽度限制包括符号在内的总长度；失败时返回 0，*pp 不动
+static int scan_real_lex(const char** pp, const char* end, int width, scan_real* r) {
+	const char* p = *pp;
+	if (width > 0 && end - p > width) end = p + width;
+	r->neg = 0;
+	r->truncated = 0;
+	r->w = 0;
+	r->q = 0;
+	if (p < end && (*p == '+' || *p == '-')) {
+		r->neg = *p == '-';
+		p++;
+	}
+	r->body = p;
+
+	if (p < end && ((*p | 0x20) == 'i' || (*p | 0x20) == 'n')) {
+		if (scan_match_nocase(p, end, "inf")) {
+			r->kind = SCAN_REAL_INF;
+			p += scan_match_nocase(p, end, "infinity") ? 8 : 3;
+		}
+		else if (scan_match_nocase(p, end, "nan")) {
+			r->kind = SCAN_REAL_NAN;
+			p += 3;
+			if (p < end && *p == '(') {
+				const char* s = p + 1;
+				while (s < end && (isalnum((unsigned char)*s) || *s == '_')) s++;
+				if (s < end && *s == ')') p = s + 1;
+			}
+		}
+		else {
+			return 0;
+		}
+	}
+	else if (end - p > 2 && p[0] == '0' && (p[1] | 0x20) == 'x' &&
+		(scan_hex_value((unsigned char)p[2]) >= 0 || (p[2] == '.' && end - p > 3 && scan_hex_value((unsigned char)p[3]) >= 0))) {
+		r->kind = SCAN_REAL_HEX;
+		p += 2;
+		while (p < end && scan_hex_value((unsigned char)*p) >= 0) p++;
+		if (p < end && *p == '.') {
+			p++;
+			while (p < end && scan_hex_value((unsigned char)*p) >= 0) p++;
+		}
+		int64_t exp;
+		if (p < end && (*p | 0x20) == 'p') p = scan_real_exponent(p, end, &exp);
+	}
+	else {
+		// 整数部分和小数部分各用 SWAR 读取；总位数不超过 19 时结果就是有效数字
+		r->kind = SCAN_REAL_DEC;
+		const char* digits = p;
+		int overflow;
+		uint64_t w, frac = 0;
+		size_t nd = scan_isa.digits10(p, end, &w, &overflow);
+		size_t nfrac = 0;
+		p += nd;
+		if (p < end && *p == '.') {
+			p++;
+			nfrac = scan_isa.digits10(p, end, &frac, &overflow);
+			p += nfrac;
+			nd += nfrac;
+		}
+		if (nd == 0) return 0;
+		const char* mant_end = p;
+		int64_t exp = 0;
+		if (p < end && (*p | 0x20) == 'e') p = scan_real_exponent(p, end, &exp);
+		if (nd <= 19) {
+			r->w = w * scan_pow10[nfrac] + frac;
+			r->q = exp - (int64_t)nfrac;
+		}
+		else {
+			scan_real_significant(digits, mant_end, exp, r);
+		}
+	}
+
+	r->len = (size_t)(p - r->body);
+	*pp = p;
+	return 1;
+}
+
+// 回退路径：把字段（不含符号）复制成以 '\0' 结尾的串，在 C locale 下调用 strtof/strtod/strtold
+enum { SCAN_REAL_FLOAT, SCAN_REAL_DOUBLE, SCAN_REAL_LDOUBLE };
+
+static int scan_real_fallback(const scan_real* r, int type, void* out) {
+	char stack_buf[128];
+#ifdef _WIN32
+	// 没有可用的 strtod_l，把 '.' 换成当前 locale 的小数点
+	const char* dp = localeconv()->decimal_point;
+	size_t dp_len = strlen(dp);
+#else
+	static const locale_t c_locale = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+	size_t dp_len = 1;
+#endif
+	size_t size = r->len * dp_len + 1;
+	char* buf = size <= sizeof(stack_buf) ? stack_buf : (char*)malloc(size);
+	if (!buf) return 0;
+#ifdef _WIN32
+	char* d = buf;
+	for (size_t i = 0; i < r->len; i++) {
+		if (r->body[i] == '.') {
+			memcpy(d, dp, dp_len);
+			d += dp_len;
+		}
+		else {
+			*d++ = r->body[i];
+		}
+	}
+	*d = '\0';
+	switch (type) {
+	case SCAN_REAL_FLOAT: *(float*)out = strtof(buf, NULL); break;
+	case SCAN_REAL_DOUBLE: *(double*)out = strtod(buf, NULL); break;
+	default: *(long double*)out = strtold(buf, NULL); break;
+	}
+#else
+	memcpy(buf, r->body, r->len);
+	buf[r->len] = '\0';
+	switch (type) {
+	case SCAN_REAL_FLOAT: *(float*)out = strtof_l(buf, NULL, c_locale); break;
+	case SCAN_REAL_DOUBLE: *(double*)out = strtod_l(buf, NULL, c_locale); break;
+	default: *(long double*)out = strtold_l(buf, NULL, c_locale); break;
+	}
+#endif
+	if (buf != stack_buf) free(buf);
+	return 1;
+}
+
+// 只在中间结果不会以更高精度计算时使用 Clinger 快速路径
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+#define SCAN_CLINGER 1
+static const double scan_pow10_f64[23] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+static const float scan_pow10_f32[11] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+#endif
+
+// %f / %e / %g / %a：单精度
+static int scan_float(const char** pp, const char* end, int width, float* val) {
+	const char* start = *pp;
+	scan_real r;
+	if (!scan_real_lex(pp, end, width, &r)) return 0;
+	float v;
+	uint64_t bits;
+	if (r.kind == SCAN_REAL_DEC) {
+#ifdef SCAN_CLINGER
+		if (!r.truncated && r.q >= -10 && r.q <= 10 && r.w <= (1ULL << 24)) {
+			v = (float)r.w;
+			v = r.q < 0 ? v / scan_pow10_f32[-r.q] : v * scan_pow10_f32[r.q];
+		}
+		else
+#endif
+		if (scan_decimal_bits(r.w, r.q, r.truncated, &scan_binary32, &bits)) {
+			uint32_t b32 = (uint32_t)bits;
+			memcpy(&v, &b32, sizeof(v));
+		}
+		else if (!scan_real_fallback(&r, SCAN_REAL_FLOAT, &v)) {
+			*pp = start;
+			return 0;
+		}
+	}
+	else if (r.kind == SCAN_REAL_INF) v = INFINITY;
+	else if (r.kind == SCAN_REAL_NAN) v = NAN;
+	else if (!scan_real_fallback(&r, SCAN_REAL_FLOAT, &v)) {
+		*pp = start;
+		return 0;
+	}
+	*val = r.neg ? -v : v;
+	return 1;
+}
+
+// %lf / %le / %lg / %la：双精度
+static int scan_double(const char** pp, const char* end, int width, double* val) {
+	const char* start = *pp;
+	scan_real r;
+	if (!scan_real_lex(pp, end, width, &r)) return 0;
+	double v;
+	uint64_t bits;
+	if (r.kind == SCAN_REAL_DEC) {
+#ifdef SCAN_CLINGER
+		if (!r.truncated && r.q >= -22 && r.q <= 22 && r.w <= (1ULL << 53)) {
+			v = (double)r.w;
+			v = r.q < 0 ? v / scan_pow10_f64[-r.q] : v * scan_pow10_f64[r.q];
+		}
+		else
+#endif
+		if (scan_decimal_bits(r.w, r.q, r.truncated, &scan_binary64, &bits)) {
+			memcpy(&v, &bits, sizeof(v));
+		}
+		else if (!scan_real_fallback(&r, SCAN_REAL_DOUBLE, &v)) {
+			*pp = start;
+			return 0;
+		}
+	}
+	else if (r.kind == SCAN_REAL_INF) v = INFINITY;
+	else if (r.kind == SCAN_REAL_NAN) v = NAN;
+	else if (!scan_real_fallback(&r, SCAN_REAL_DOUBLE, &v)) {
+		*pp = start;
+		return 0;
+	}
+	*val = r.neg ? -v : v;
+	return 1;
+}
+
+// %Lf / %Le / %Lg / %La：long double 与 double 相同时直接走双精度路径；
+// 扩展精度下 w 和 10^q（q <= 27）都可精确表示时一次乘除，其余回退到 strtold
+static int scan_long_double(const char** pp, const char* end, int width, long double* val) {
+#if LDBL_MANT_DIG == 53
+	double d;
+	if (!scan_double(pp, end, width, &d)) return 0;
+	*val = d;
+	return 1;
+#else
+	static const long double pow10[28] = {
+		1e0L, 1e1L, 1e2L, 1e3L, 1e4L, 1e5L, 1e6L, 1e7L, 1e8L, 1e9L, 1e10L, 1e11L, 1e12L, 1e13L,
+		1e14L, 1e15L, 1e16L, 1e17L, 1e18L, 1e19L, 1e20L, 1e21L, 1e22L, 1e23L, 1e24L, 1e25L, 1e26L, 1e27L,
+	};
+	const char* start = *pp;
+	scan_real r;
+	if (!scan_real_lex(pp, end, width, &r)) return 0;
+	long double v;
+	if (r.kind == SCAN_REAL_DEC && r.w == 0) v = 0;
+	else if (r.kind == SCAN_REAL_DEC && LDBL_MANT_DIG >= 64 && !r.truncated && r.q >= -27 && r.q <= 27) {
+		v = (long double)r.w;
+		v = r.q < 0 ? v / pow10[-r.q] : v * pow10[r.q];
+	}
+	else if (r.kind == SCAN_REAL_INF) v = INFINITY;
+	else if (r.kind == SCAN_REAL_NAN) v = NAN;
+	else if (!scan_real_fallback(&r, SCAN_REAL_LDOUBLE, &v)) {
+		*pp = start;
+		return 0;
+	}
+	*val = r.neg ? -v : v;
+	return 1;
+#endif
+}
+
+// 指针地址，必须以 0x 开头；失败时 *pp 停在出错位置
+static int scan_pointer(const char** pp, const char* end, int width, uintptr_t* val) {
+	const char* p = *pp;
+	if (width > 0 && end - p > width) end = p + width;
+	if (p + 1 >= end || (*p != '0' && *(p + 1) != 'x')) return 0;
+	p += 2; // 跳过 "0x"
+	*pp = p;
+	int neg;
+	uint64_t mag;
+	int r = scan_magnitude(pp, end, 0, 16, &neg, &mag);
+	if (r <= 0) return r;
+	if (mag > UINTPTR_MAX) return -1;
+	*val = (uintptr_t)(neg ? 0 - mag : mag);
+	return 1;
+}
+
+// %s：读取一个以空白结束的词，GB2312 双字节字符不拆开，最多写 size - 1 个字节。
+// str 为 NULL 时只计算长度。返回写入的字节数
+static size_t scan_word(const char** pp, const char* end, int width, char* str, size_t size) {
+	const char* p = *pp;
+	size_t limit = (size_t)(end - p);
+	if (width > 0 && (size_t)width < limit) limit = (size_t)width;
+	if (size - 1 < limit) limit = size - 1;
+	// 先找到词尾，再一次性复制
+	size_t i = 0;
+	while (i < limit) {
+		i += scan_isa.span_word(p + i, limit - i);
+		if (i >= limit || scan_space_table[(unsigned char)p[i]]) break;
+		// 高位字节：成段的双字节字符整段读取，其余情况下 GB2312 首字节连同尾字节一起读取
+		size_t run = scan_isa.span_gb2312(p + i, limit - i);
+		if (run) {
+			i += run;
+			continue;
+		}
+		i += (is_gb2312_lead_byte((unsigned char)p[i]) && p + i + 1 < end && i + 1 < size - 1) ? 2 : 1;
+	}
+	if (str) {
+		memcpy(str, p, i);
+		str[i] = '\0';
+	}
+	*pp = p + i;
+	return i;
+}
+
+// %*s：跳过一个词，返回是否读到了字符
+static int scan_word_skip(const char** pp, const char* end, int width) {
+	const char* p = *pp;
+	int read = 0;
+	while (p < end) {
+		// 宽度按字节递减，减到 0 后不再限制
+		size_t n = scan_isa.span_word(p, (size_t)(end - p));
+		if (width) width = (size_t)width > n ? width - (int)n : 0;
+		if (n) read = 1;
+		p += n;
+		if (p >= end || scan_space_table[(unsigned char)*p]) break;
+		if (width == 0 && (n = scan_isa.span_gb2312(p, (size_t)(end - p))) > 0) {
+			p += n;
+			read = 1;
+			continue;
+		}
+		if (is_gb2312_lead_byte((unsigned char)*p) && p + 1 < end) {
+			p += 2;
+			if (width) width -= 2;
+		}
+		else {
+			p++;
+			if (width) width--;
+		}
+		read = 1;
+		if (width < 0) break;
+	}
+	*pp = p;
+	return read;
+}
+
+// %[...]：读取属于字符集的字符，GB2312 首字节匹配时连同尾字节一起读取。
+// str 为 NULL 时只计算长度。返回写入的字节数
+static size_t scan_set(const char** pp, const char* end, int width, const scan_charset* cs, char* str, size_t size) {
+	const char* p = *pp;
+	size_t i = 0;
+	size_t limit = size - 1;
+	if (width && (size_t)width < limit) limit = (size_t)width;
+	while (p < end && i < limit) {
+		// 整块跳过匹配的 ASCII 字节
+		size_t avail = (size_t)(end - p);
+		size_t n = scan_isa.span_set(p, avail < limit - i ? avail : limit - i, cs);
+		p += n;
+		i += n;
+		if (p >= end || i >= limit) break;
+		if (!scan_charset_has(cs->match, (unsigned char)*p)) break;
+		avail = (size_t)(end - p);
+		if (cs->gb_lead && (n = scan_isa.span_gb2312(p, avail < limit - i ? avail : limit - i)) > 0) {
+			p += n;
+			i += n;
+			continue;
+		}
+		n = (is_gb2312_lead_byte((unsigned char)*p) && p + 1 < end && i + 1 < size - 1) ? 2 : 1;
+		p += n;
+		i += n;
+	}
+	if (str) {
+		memcpy(str, *pp, i);
+		str[i] = '\0';
+	}
+	*pp = p;
+	return i;
+}
+
+// %*[...]：跳过属于字符集的字符，返回是否读到了字符
+static int scan_set_skip(const char** pp, const char* end, int width, const scan_charset* cs) {
+	const char* p = *pp;
+	int read = 0;
+	while (p < end && width >= 0) {
+		size_t n = scan_isa.span_set(p, (size_t)(end - p), cs);
+		if (n) {
+			// 宽度减到 0 后不再限制，与逐字节递减一致
+			p += n;
+			width = (size_t)width > n ? width - (int)n : 0;
+			read = 1;
+			if (p >= end) break;
+		}
+		if (!scan_charset_has(cs->match, (unsigned char)*p)) break;
+		if (width == 0 && cs->gb_lead && (n = scan_isa.span_gb2312(p, (size_t)(end - p))) > 0) {
+			p += n;
+			read = 1;
+			continue;
+		}
+		if (is_gb2312_lead_byte((unsigned char)*p) && p + 1 < end) {
+			p += 2;
+			if (width) width -= 2;
+		}
+		else {
+			p++;
+			if (width) width--;
+		}
+		read = 1;
+	}
+	*pp = p;
+	return read;
+}
+
+// %[...] 没有匹配任何字符时，跳过空白及其后列在方括号中的字符
+static void scan_set_recover(const char** pp, const char* end, const scan_charset* cs) {
+	const char* p = skip_whitespace(*pp, end);
+	while (p < end && !scan_space_table[(unsigned char)*p] && scan_charset_has(cs->raw, (unsigned char)*p)) {
+		p++;
+	}
+	*pp = skip_whitespace(p, end);
+}
+
+// %c：读取一个字符，GB2312 双字节字符写入两个字节；ch 为 NULL 时只跳过。调用方保证 *pp < end
+static void scan_char(const char** pp, const char* end, char* ch) {
+	const char* p = *pp;
+	size_t n = (is_gb2312_lead_byte((unsigned char)*p) && p + 1 < end) ? 2 : 1;
+	if (ch) memcpy(ch, p, n);
+	*pp = p + n;
+}
+
+// ================= 分配字符串 %ms =================
+// %ms 和 %m[...] 按读到的长度分配结果（含 '\0'），参数为 char**，不需要缓冲区大小，也不会截断。
+// 默认用 malloc 分配，由调用者 free（同 POSIX）。本线程用 my_scanf_use_arena 指定了区域后改为在区域中顺序切分：
+// 每次分配只移动一个指针，结果不逐个释放，my_scanf_arena_reset 一次回收全部，适合按批处理的记录。
+
+// 区域用完后追加的块，重置后保留下来复用
+typedef struct scan_arena_block {
+	struct scan_arena_block* next;
+	size_t cap; // 块头之后的可用字节数
+} scan_arena_block;
+
+struct my_scanf_arena {
+	char* cur;                 // 下一个可用字节
+	char* lim;                 // 当前块结尾
+	char* base;                // 第一块：调用者提供的缓冲区，或创建时分配的
+	size_t size;
+	int own;                   // base 由区域分配，释放时一并释放
+	scan_arena_block* blocks;  // 追加的块
+	scan_arena_block* block;   // 当前块，NULL 表示第一块
+	size_t grow;               // 下一次追加的块大小
+	size_t used;               // 上次重置以来分配出的字节数
+};
+
+#define SCAN_ARENA_MIN_BLOCK (64 * 1024)
+#define SCAN_ARENA_MAX_BLOCK (64 * 1024 * 1024)
+
+static thread_local my_scanf_arena* g_scan_arena;
+
+// 创建区域：buf 为调用者提供的初始缓冲区（区域不释放它），为 NULL 时分配 size 字节。
+// 初始缓冲区用完后自动追加 malloc 的块。失败返回 NULL
+my_scanf_arena* my_scanf_arena_create(void* buf, size_t size) {
+	my_scanf_arena* a = (my_scanf_arena*)calloc(1, sizeof(my_scanf_arena));
+	if (!a) return NULL;
+	if (!buf && size) {
+		buf = malloc(size);
+		if (!buf) {
+			free(a);
+			return NULL;
+		}
+		a->own = 1;
+	}
+	a->base = (char*)buf;
+	a->size = buf ? size : 0;
+	a->grow = a->size < SCAN_ARENA_MIN_BLOCK ? SCAN_ARENA_MIN_BLOCK : a->size;
+	a->cur = a->base;
+	a->lim = a->base + a->size;
+	return a;
+}
+
+// 回收区域中的全部分配，O(1)；之前得到的字符串全部失效。追加的块保留下来供之后使用
+void my_scanf_arena_reset(my_scanf_arena* a) {
+	if (!a) return;
+	a->cur = a->base;
+	a->lim = a->base + a->size;
+	a->block = NULL;
+	a->used = 0;
+}
+
+void my_scanf_arena_free(my_scanf_arena* a) {
+	if (!a) return;
+	if (g_scan_arena == a) g_scan_arena = NULL;
+	for (scan_arena_block* b = a->blocks; b;) {
+		scan_arena_block* next = b->next;
+		free(b);
+		b = next;
+	}
+	if (a->own) free(a->base);
+	free(a);
+}
+
+// 上次重置以来分配出的字节数
+size_t my_scanf_arena_used(const my_scanf_arena* a) {
+	return a ? a->used : 0;
+}
+
+// 指定本线程 %ms 和 %m[...] 使用的区域，NULL 表示恢复 malloc；返回之前的设置。
+// 区域不加锁，同一时刻只能由一个线程使用
+my_scanf_arena* my_scanf_use_arena(my_scanf_arena* a) {
+	my_scanf_arena* prev = g_scan_arena;
+	g_scan_arena = a;
+	return prev;
+}
+
+// 当前块放不下时换到下一个放得下的块，没有时追加新块
+static SCAN_COLD char* scan_arena_grow(my_scanf_arena* a, size_t n) {
+	scan_arena_block* b = a->block ? a->block->next : a->blocks;
+	while (b && b->cap < n) b = b->next;
+	if (!b) {
+		size_t cap = a->grow < n ? n : a->grow;
+		if (cap > SIZE_MAX - sizeof(scan_arena_block)) return NULL;
+		b = (scan_arena_block*)malloc(sizeof(scan_arena_block) + cap);
+		if (!b) return NULL;
+		b->cap = cap;
+		// 新块接在当前块之后，后面已有的块仍可在本轮使用
+		scan_arena_block** link = a->block ? &a->block->next : &a->blocks;
+		b->next = *link;
+		*link = b;
+		if (a->grow < SCAN_ARENA_MAX_BLOCK) a->grow *= 2;
+	}
+	a->block = b;
+	a->cur = (char*)(b + 1) + n;
+	a->lim = (char*)(b + 1) + b->cap;
+	a->used += n;
+	return (char*)(b + 1);
+}
+
+static inline char* scan_arena_alloc(my_scanf_arena* a, size_t n) {
+	if ((size_t)(a->lim - a->cur) < n) return scan_arena_grow(a, n);
+	char* q = a->cur;
+	a->cur += n;
+	a->used += n;
+	return q;
+}
+
+// 复制 [s, s + n) 为新的字符串，从本线程的区域或 malloc 分配；失败返回 NULL
+static char* scan_alloc_str(const char* s, size_t n) {
+	my_scanf_arena* a = g_scan_arena;
+	char* q = a ? scan_arena_alloc(a, n + 1) : (char*)malloc(n + 1);
+	if (q) {
+		memcpy(q, s, n);
+		q[n] = '\0';
+	}
+	return q;
+}
+
+// ================= 字符串驻留 %K =================
+// %K 和 %K[...] 按 %s / %[...] 的规则读取，把读到的字符串驻留到 my_scanf_set_intern 设置的表中，输出 uint32_t 编号。
+// 相同的字符串总是得到相同的编号，编号从 0 起连续分配；my_scanf_intern_str 由编号取得表中唯一的一份副本。
+// 表为开放寻址（线性探测），查找不加锁；只有第一次出现的字符串在锁内插入，重复多的数据几乎都走无锁路径。
+// 扩容时旧的槽数组不释放（总和不超过当前数组），正在查找旧数组的线程不受影响；条目和编号索引一经写入不再移动。
+
+#define SCAN_INTERN_SEG0 256 // 编号索引第 0 段的大小，之后每段加倍
+#define SCAN_INTERN_SEGS 25  // 覆盖全部 32 位编号
+
+typedef struct scan_intern_entry {
+	uint64_t hash;
+	uint32_t id;
+	uint32_t len; // 之后是 len 个字节和 '\0'
+} scan_intern_entry;
+
+typedef struct scan_intern_slots {
+	size_t mask;
+	std::atomic<scan_intern_entry*>* slot;
+	struct scan_intern_slots* prev; // 扩容前的数组，随表释放
+} scan_intern_slots;
+
+struct my_scanf_intern {
+	std::atomic<scan_intern_slots*> slots;
+	std::atomic<uint32_t> count;
+	std::atomic<scan_intern_entry**> segs[SCAN_INTERN_SEGS]; // 编号 -> 条目
+	std::mutex lock;                                         // 只保护插入和扩容
+	my_scanf_arena* strs;                                    // 条目存储
+};
+
+static std::atomic<my_scanf_intern*> g_scan_intern(nullptr);
+
+static scan_intern_slots* scan_intern_slots_alloc(size_t cap) {
+	scan_intern_slots* s = (scan_intern_slots*)malloc(sizeof(scan_intern_slots));
+	if (!s) return NULL;
+	s->slot = new (std::nothrow) std::atomic<scan_intern_entry*>[cap]();
+	if (!s->slot) {
+		free(s);
+		return NULL;
+	}
+	s->mask = cap - 1;
+	s->prev = NULL;
+	return s;
+}
+
+// 创建驻留表，expected 为预计的不同字符串个数（可为 0）。失败返回 NULL
+my_scanf_intern* my_scanf_intern_create(size_t expected) {
+	size_t cap = 64;
+	while (cap / 2 < expected && cap < ((size_t)1 << 30)) cap <<= 1;
+	my_scanf_intern* t = new (std::nothrow) my_scanf_intern();
+	if (!t) return NULL;
+	scan_intern_slots* s = scan_intern_slots_alloc(cap);
+	t->strs = my_scanf_arena_create(NULL, 0);
+	if (!s || !t->strs) {
+		if (s) delete[] s->slot;
+		free(s);
+		my_scanf_arena_free(t->strs);
+		delete t;
+		return NULL;
+	}
+	t->slots.store(s, std::memory_order_relaxed);
+	t->count.store(0, std::memory_order_relaxed);
+	for (int k = 0; k < SCAN_INTERN_SEGS; k++) t->segs[k].store(NULL, std::memory_order_relaxed);
+	return t;
+}
+
+// 释放驻留表，之前取得的字符串全部失效。调用时不能有线程在使用它
+void my_scanf_intern_free(my_scanf_intern* t) {
+	if (!t) return;
+	my_scanf_intern* cur = t;
+	g_scan_intern.compare_exchange_strong(cur, nullptr);
+	for (scan_intern_slots* s = t->slots.load(std::memory_order_relaxed); s;) {
+		scan_intern_slots* prev = s->prev;
+		delete[] s->slot;
+		free(s);
+		s = prev;
+	}
+	for (int k = 0; k < SCAN_INTERN_SEGS; k++) free(t->segs[k].load(std::memory_order_relaxed));
+	my_scanf_arena_free(t->strs);
+	delete t;
+}
+
+// 设置 %K 使用的驻留表（所有线程共用），NULL 表示不设置；返回之前的设置。应在开始解析之前设置
+my_scanf_intern* my_scanf_set_intern(my_scanf_intern* t) {
+	return g_scan_intern.exchange(t, std::memory_order_acq_rel);
+}
+
+// 已驻留的字符串个数，即下一个编号
+uint32_t my_scanf_intern_count(const my_scanf_intern* t) {
+	return t ? t->count.load(std::memory_order_acquire) : 0;
+}
+
+// 编号 id 的字符串（'\0' 结尾），len 不为 NULL 时写入长度；编号不存在时返回 NULL。
+// 结果在表释放之前一直有效，可在线程间共享
+const char* my_scanf_intern_str(const my_scanf_intern* t, uint32_t id, size_t* len) {
+	if (!t || id >= t->count.load(std::memory_order_acquire)) return NULL;
+	size_t x = id / SCAN_INTERN_SEG0 + 1;
+	int k = 0;
+	while (x >>= 1) k++;
+	const scan_intern_entry* e = t->segs[k].load(std::memory_order_acquire)[id - SCAN_INTERN_SEG0 * (((size_t)1 << k) - 1)];
+	if (len) *len = e->len;
+	return (const char*)(e + 1);
+}
+
+static inline uint64_t scan_intern_hash(const char* s, size_t n) {
+	uint64_t h = 0x9E3779B97F4A7C15ULL ^ n;
+	uint64_t w;
+	for (; n >= 8; s += 8, n -= 8) {
+		memcpy(&w, s, 8);
+		h = (h ^ w) * 0xFF51AFD7ED558CCDULL;
+		h ^= h >> 29;
+	}
+	w = 0;
+	memcpy(&w, s, n);
+	h = (h ^ w) * 0xC4CEB9FE1A85EC53ULL;
+	h ^= h >> 32;
+	h *= 0xFF51AFD7ED558CCDULL;
+	return h ^ (h >> 33);
+}
+
+static inline scan_intern_entry* scan_intern_find(const scan_intern_slots* s, uint64_t h, const char* str, size_t n) {
+	for (size_t i = (size_t)h & s->mask;; i = (i + 1) & s->mask) {
+		scan_intern_entry* e = s->slot[i].load(std::memory_order_acquire);
+		if (!e) return NULL;
+		if (e->hash == h && e->len == n && memcmp(e + 1, str, n) == 0) return e;
+	}
+}
+
+static void scan_intern_place(scan_intern_slots* s, scan_intern_entry* e) {
+	size_t i = (size_t)e->hash & s->mask;
+	while (s->slot[i].load(std::memory_order_relaxed)) i = (i + 1) & s->mask;
+	s->slot[i].store(e, std::memory_order_release);
+}
+
+// 第一次出现的字符串：在锁内再查一次，仍没有时分配编号和条目，必要时扩容
+static SCAN_COLD int scan_intern_insert(my_scanf_intern* t, uint64_t h, const char* str, size_t n, uint32_t* id) {
+	std::lock_guard<std::mutex> guard(t->lock);
+	scan_intern_slots* s = t->slots.load(std::memory_order_relaxed);
+	scan_intern_entry* e = scan_intern_find(s, h, str, n);
+	if (e) {
+		*id = e->id;
+		return 1;
+	}
+	uint32_t next = t->count.load(std::memory_order_relaxed);
+	if (next == UINT32_MAX || n >= UINT32_MAX) return 0;
+
+	// 装载率保持在 1/2 以下
+	if ((size_t)next + 1 > (s->mask + 1) / 2) {
+		scan_intern_slots* bigger = scan_intern_slots_alloc((s->mask + 1) * 2);
+		if (!bigger) return 0;
+		for (size_t i = 0; i <= s->mask; i++) {
+			scan_intern_entry* old = s->slot[i].load(std::memory_order_relaxed);
+			if (old) scan_intern_place(bigger, old);
+		}
+		bigger->prev = s;
+		t->slots.store(bigger, std::memory_order_release);
+		s = bigger;
+	}
+
+	size_t x = next / SCAN_INTERN_SEG0 + 1;
+	int k = 0;
+	while (x >>= 1) k++;
+	scan_intern_entry** seg = t->segs[k].load(std::memory_order_relaxed);
+	if (!seg) {
+		seg = (scan_intern_entry**)malloc(((size_t)SCAN_INTERN_SEG0 << k) * sizeof(scan_intern_entry*));
+		if (!seg) return 0;
+		t->segs[k].store(seg, std::memory_order_release);
+	}
+
+	// 条目按 8 字节对齐切分，区域的各块起点都由 malloc 分配
+	size_t size = (sizeof(scan_intern_entry) + n + 1 + 7) & ~(size_t)7;
+	e = (scan_intern_entry*)scan_arena_alloc(t->strs, size);
+	if (!e) return 0;
+	e->hash = h;
+	e->id = next;
+	e->len = (uint32_t)n;
+	memcpy(e + 1, str, n);
+	((char*)(e + 1))[n] = '\0';
+	seg[next - SCAN_INTERN_SEG0 * (((size_t)1 << k) - 1)] = e;
+	t->count.store(next + 1, std::memory_order_release);
+	scan_intern_place(s, e);
+	*id = next;
+	return 1;
+}
+
+// 驻留 [str, str + n)，成功返回 1 并写入编号，内存不足返回 0
+static inline int scan_intern(my_scanf_intern* t, const char* str, size_t n, uint32_t* id) {
+	uint64_t h = scan_intern_hash(str, n);
+	scan_intern_entry* e = scan_intern_find(t->slots.load(std::memory_order_acquire), h, str, n);
+	if (e) {
+		*id = e->id;
+		return 1;
+	}
+	return scan_intern_insert(t, h, str, n, id);
+}
+
+// 在解析之外驻留一个字符串（例如预先登记已知的取值），成功返回 0 并写入编号，失败返回 -1
+int my_scanf_intern_add(my_scanf_intern* t, const char* str, size_t len, uint32_t* id) {
+	if (!t || (!str && len) || !id) return -1;
+	return scan_intern(t, str ? str : "", len, id) ? 0 : -1;
+}
+
+// ================= 预编译格式 =================
+// my_scanf_compile 把格式串一次性解析成指令序列，宽度、长度修饰符和 %[...] 字符集
+// 都在编译时确定；之后每次解析只执行指令，不再重复扫描格式串。
+
+// 指令类型
+enum {
+	SCAN_OP_LITERAL, // 普通字符，逐字节匹配
+	SCAN_OP_SPACE,   // 格式中的空白，跳过输入中的任意空白
+	SCAN_OP_CONV,    // 格式说明符
+	SCAN_OP_BAD,     // 非法或不完整的说明符，执行到此处报错
+};
+
+// 单条指令
+typedef struct scan_op {
+	unsigned char kind;     // SCAN_OP_*
+	char conv;              // 说明符字符（'d'、's'、'[' 等），或要匹配的普通字符
+	unsigned char suppress; // %* 跳过赋值
+	unsigned char len_mod;  // SCAN_LEN_*
+	unsigned char prec_arg; // 精度为 .*，执行时从参数中读取
+	unsigned char span;     // %V / %V[...]：输出指向输入的片段，不复制
+	unsigned char alloc;    // %ms / %m[...]：按长度分配结果，输出 char*
+	unsigned char intern;   // %K / %K[...]：驻留到 my_scanf_set_intern 设置的表，输出 uint32_t 编号
+	short set;              // 扫描集下标
+	int width;              // 字段宽度，0 表示不限
+	int fmt_off;            // 出错时报告的格式串位置
+	int spec;               // 说明符序号（第几个 %），普通字符和空白为其后第一个说明符的序号
+} scan_op;
+
+// %V / %V[...] 的输出：指向输入中的一段，不以 '\0' 结尾，有效期与输入相同
+typedef struct my_scanf_span {
+	const char* ptr;
+	size_t len;
+} my_scanf_span;
+
+// 编译后的格式，一次分配，创建后只读，可在多个线程间共享
+struct my_scanf_format {
+	const char* format;               // 格式串副本，用于错误报告
+	int nops;                         // 指令数
+	const scan_op* ops;               // 指令序列
+	const scan_charset* sets;         // %[...] 字符集
+};
+
+// 解析 %[...] 的字符集，f 指向 '[' 之后，列出的字符记入 raw 位图（可为 NULL）；
+// 返回指向 ']' 的指针，未闭合时指向 '\0'
+static SCAN_CONSTEXPR14 const char* parse_scanset(const char* f, int* invert, uint8_t* raw) {
+	*invert = 0;
+	if (*f == '^') {
+		*invert = 1;
+		f++;
+	}
+	int first = 1;
+	while (*f && (*f != ']' || first)) {
+		first = 0;
+		if (*f == '-' && *(f + 1) != ']' && *(f + 1)) {
+			char start = *(f - 1);
+			char end = *(f + 1);
+			for (int c = start; c <= end; c++) {
+				if (raw) raw[(unsigned char)c >> 3] |= (uint8_t)(1 << ((unsigned char)c & 7));
+			}
+			f += 2;
+		}
+		else {
+			if (raw) raw[(unsigned char)*f >> 3] |= (uint8_t)(1 << ((unsigned char)*f & 7));
+			f++;
+		}
+	}
+	return f;
+}
+
+// 编译一遍格式串；ops 为 NULL 时只统计指令数和扫描集数。可在编译期执行，供 scan<> 使用
+static SCAN_CONSTEXPR14 int scan_compile_pass(const char* format, scan_op* ops, scan_charset* sets, int* nsets) {
+	int n = 0;
+	int ns = 0;
+	int nspec = 0;
+	const char* f = format;
+
+	while (*f) {
+		scan_op op = {};
+		op.spec = nspec;
+
+		if (*f != '%') {
+			op.fmt_off = (int)(f - format);
+			if (scan_is_space(*f)) {
+				// 连续空白与单个空白效果相同，合并为一条指令
+				op.kind = SCAN_OP_SPACE;
+				while (scan_is_space(*f)) f++;
+			}
+			else {
+				op.kind = SCAN_OP_LITERAL;
+				op.conv = *f++;
+			}
+			if (ops) ops[n] = op;
+			n++;
+			continue;
+		}
+		f++; // 跳过 %
+		nspec++;
+
+		// 检查 * 标志（跳过赋值）
+		if (*f == '*') {
+			op.suppress = 1;
+			f++;
+		}
+
+		// 解析字段宽度
+		op.width = parse_number(&f);
+
+		// 解析精度（暂未使用，.* 仍需在执行时消耗一个 int 参数）
+		if (*f == '.') {
+			f++;
+			if (*f == '*') {
+				op.prec_arg = 1;
+				f++;
+			}
+			else {
+				parse_number(&f);
+			}
+		}
+
+		// %ms / %m[...]
+		if (*f == 'm') {
+			op.alloc = 1;
+			f++;
+		}
+
+		// 检查长度修饰符
+		if (*f == 'h') {
+			op.len_mod = SCAN_LEN_H;
+			if (*++f == 'h') {
+				op.len_mod = SCAN_LEN_HH;
+				f++;
+			}
+		}
+		else if (*f == 'l') {
+			op.len_mod = SCAN_LEN_L;
+			if (*++f == 'l') {
+				op.len_mod = SCAN_LEN_LL;
+				f++;
+			}
+		}
+		else if (*f == 'L') {
+			op.len_mod = SCAN_LEN_LD;
+			f++;
+		}
+		else if (*f == 'z') {
+			op.len_mod = SCAN_LEN_Z;
+			f++;
+		}
+		else if (*f == 'I' && *(f + 1) == '6' && *(f + 2) == '4') {
+			op.len_mod = SCAN_LEN_I64;
+			f += 3;
+		}
+
+		op.fmt_off = (int)(f - format);
+		op.kind = SCAN_OP_CONV;
+		char c = *f;
+		// %V 按 %s 规则、%V[...] 按 %[...] 规则读取，但只输出片段
+		if (c == 'V') {
+			op.span = 1;
+			if (*(f + 1) == '[') c = *++f;
+			else c = 's';
+		}
+		// %K / %K[...] 同样按 %s / %[...] 规则读取，输出驻留编号
+		else if (c == 'K') {
+			op.intern = 1;
+			if (*(f + 1) == '[') c = *++f;
+			else c = 's';
+		}
+		op.conv = c;
+		// 与 glibc 一致：%Ld 等同 %lld，%llf 等同 %Lf
+		if (scan_is_float_conv(c)) {
+			if (op.len_mod == SCAN_LEN_LL) op.len_mod = SCAN_LEN_LD;
+		}
+		else if (op.len_mod == SCAN_LEN_LD) {
+			op.len_mod = SCAN_LEN_LL;
+		}
+		switch (c) {
+		case 'd': case 'i': case 'u': case 'x': case 'X': case 'p':
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		case 's': case 'c': case 'n': case '%':
+			f++;
+			break;
+		case '[': {
+			int invert = 0;
+			op.set = (short)ns;
+			f = parse_scanset(f + 1, &invert, sets ? sets[ns].raw : NULL);
+			if (sets) scan_charset_build(&sets[ns], invert);
+			ns++;
+			if (*f != ']') {
+				// 字符集未闭合，与逐次解析时一样返回 0
+				op.kind = SCAN_OP_BAD;
+				op.fmt_off = (int)(f - format);
+				break;
+			}
+			f++; // 跳过 ]
+			break;
+		}
+		default:
+			op.kind = SCAN_OP_BAD;
+			break;
+		}
+		// m 只能用于 %s 和 %[...]
+		if (op.alloc && ((c != 's' && c != '[') || op.span || op.intern)) op.kind = SCAN_OP_BAD;
+		if (ops) ops[n] = op;
+		n++;
+		if (op.kind == SCAN_OP_BAD) break; // 之后的格式不可达
+	}
+
+	*nsets = ns;
+	return n;
+}
+
+// 编译格式串，失败返回 NULL；结果用 my_scanf_free 释放
+const my_scanf_format* my_scanf_compile(const char* format) {
+	if (!format) return NULL;
+
+	int nsets;
+	int nops = scan_compile_pass(format, NULL, NULL, &nsets);
+	size_t fmt_len = strlen(format) + 1;
+	size_t size = sizeof(my_scanf_format) + nops * sizeof(scan_op) + nsets * sizeof(scan_charset) + fmt_len;
+	char* mem = (char*)calloc(1, size);
+	if (!mem) return NULL;
+
+	my_scanf_format* fmt = (my_scanf_format*)mem;
+	scan_op* ops = (scan_op*)(mem + sizeof(my_scanf_format));
+	scan_charset* sets = (scan_charset*)(ops + nops);
+	char* copy = (char*)(sets + nsets);
+	memcpy(copy, format, fmt_len);
+
+	scan_compile_pass(copy, ops, sets, &nsets);
+	fmt->format = copy;
+	fmt->nops = nops;
+	fmt->ops = ops;
+	fmt->sets = sets;
+	return fmt;
+}
+
+void my_scanf_free(const my_scanf_format* fmt) {
+	free((void*)fmt);
+}
+
+// 输出参数的来源：可变参数，或按赋值转换的顺序给出的输出地址（并行扫描、批量解析等内部使用）。
+// 地址形式下第 i 个输出写入 ptrs[i] + row * strides[i]（strides 可为 NULL），
+// base 不为 NULL 时改为 base + offs[i]（结构体字段）；%s 和 %[...] 的缓冲区大小取 sizes[i]，
+// spans 为真时 %s 和 %[...] 按 %V 输出片段
+typedef struct scan_args {
+	va_list* ap;
+	void* const* ptrs;
+	const size_t* strides;
+	char* base;
+	const size_t* offs;
+	const size_t* sizes;
+	size_t row;
+	size_t n_base; // %n 的结果加上此值（流模式下为之前已读取的字节数）
+	int i;
+	int spans;
+	int more; // end 之后还有输入（流模式下的单个转换），停在 end 处不算输入用完
+} scan_args;
+
+static inline void* scan_arg_next(scan_args* a) {
+	char* q = a->base ? a->base + a->offs[a->i] : (char*)a->ptrs[a->i];
+	if (a->strides) q += a->row * a->strides[a->i];
+	a->i++;
+	return q;
+}
+
+#define SCAN_OUT(a, T) ((a)->ap ? va_arg(*(a)->ap, T*) : (T*)scan_arg_next(a))
+#define SCAN_SIZE(a) ((a)->ap ? va_arg(*(a)->ap, size_t) : (a)->sizes ? (a)->sizes[(a)->i - 1] : SIZE_MAX)
+
+// 按长度修饰符写入无符号整数参数
+static void scan_store_uint(scan_args* args, int len_mod, uint64_t val) {
+	switch (len_mod) {
+	case SCAN_LEN_HH: *SCAN_OUT(args, unsigned char) = (unsigned char)val; break;
+	case SCAN_LEN_H: *SCAN_OUT(args, unsigned short) = (unsigned short)val; break;
+	case SCAN_LEN_L: *SCAN_OUT(args, unsigned long) = (unsigned long)val; break;
+	case SCAN_LEN_LL: *SCAN_OUT(args, unsigned long long) = val; break;
+	case SCAN_LEN_I64: *SCAN_OUT(args, uint64_t) = val; break;
+	case SCAN_LEN_Z: *SCAN_OUT(args, size_t) = (size_t)val; break;
+	default: *SCAN_OUT(args, unsigned int) = (unsigned int)val; break;
+	}
+}
+
+// %ms / %m[...] 复制到新分配的字符串，%K / %K[...] 驻留后输出编号。返回 MY_SCANF_ERR_*
+static int scan_own_str(const scan_op* op, void* out, const char* s, size_t n) {
+	if (op->intern) {
+		my_scanf_intern* t = g_scan_intern.load(std::memory_order_acquire);
+		if (!t) return MY_SCANF_ERR_FORMAT; // 没有设置驻留表
+		return scan_intern(t, s, n, (uint32_t*)out) ? MY_SCANF_ERR_NONE : MY_SCANF_ERR_NOMEM;
+	}
+	char* str = scan_alloc_str(s, n);
+	if (!str) return MY_SCANF_ERR_NOMEM;
+	*(char**)out = str;
+	return MY_SCANF_ERR_NONE;
+}
+
+// 没有读到字符且已到输入结尾时，原因记为输入用完
+#define SCAN_FAIL(code) scan_error(p >= end && !args->more && ((code) == MY_SCANF_ERR_MATCH || (code) == MY_SCANF_ERR_LITERAL) \
+	? MY_SCANF_ERR_INPUT : (code), op->spec, format, f, input, end, p, args->n_base)
+
+// 执行编译后的格式；safe 为真时 %s 和 %[...] 需要额外的缓冲区大小参数。出错时记入 g_scan_error
+static int scan_exec_ap(const char* input, const char* end, const my_scanf_format* fmt, scan_args* args, int safe) {
+	int count = 0;         // 成功解析的参数计数
+	const char* p = input; // 输入字符串指针
+	const char* format = fmt->format;
+	bool hasStar = false;
+	g_scan_error.code = MY_SCANF_ERR_NONE;
+
+	for (int k = 0; k < fmt->nops; k++) {
+		const scan_op* op = &fmt->ops[k];
+		const char* f = format + op->fmt_off;
+
+		// 输入用完后停止；空白和 %n 不消耗输入，仍然执行，便于在末尾用 %n 取得记录长度
+		if (!hasStar && p >= end && op->kind != SCAN_OP_SPACE && !(op->kind == SCAN_OP_CONV && op->conv == 'n')) {
+			SCAN_FAIL(MY_SCANF_ERR_INPUT);
+			break;
+		}
+
+		if (op->kind == SCAN_OP_SPACE) {
+			p = skip_whitespace(p, end);
+			continue;
+		}
+		if (op->kind == SCAN_OP_LITERAL) {
+			if (p >= end || *p != op->conv) {
+				SCAN_FAIL(MY_SCANF_ERR_LITERAL);
+				return count;
+			}
+			p++;
+			continue;
+		}
+
+		int suppress = op->suppress;
+		if (suppress) hasStar = true;
+		if (op->prec_arg && args->ap) (void)va_arg(*args->ap, int);
+		if (op->kind == SCAN_OP_BAD) {
+			SCAN_FAIL(MY_SCANF_ERR_FORMAT);
+			return op->conv == '[' ? 0 : count;
+		}
+
+		switch (op->conv) {
+		case 'd': case 'i': { // 有符号十进制整数
+			p = skip_whitespace(p, end);
+			int64_t val;
+			int r = scan_int(&p, end, op->width, op->len_mod, &val);
+			if (r <= 0) {
+				SCAN_FAIL(r < 0 ? MY_SCANF_ERR_RANGE : MY_SCANF_ERR_MATCH);
+				return count;
+			}
+			if (!suppress) {
+				switch (op->len_mod) {
+				case SCAN_LEN_HH: *SCAN_OUT(args, signed char) = (signed char)val; break;
+				case SCAN_LEN_H: *SCAN_OUT(args, short) = (short)val; break;
+				case SCAN_LEN_LL: *SCAN_OUT(args, long long) = val; break;
+				case SCAN_LEN_I64: *SCAN_OUT(args, int64_t) = val; break;
+				case SCAN_LEN_L: *SCAN_OUT(args, long) = (long)val; break;
+				case SCAN_LEN_Z: *SCAN_OUT(args, ptrdiff_t) = (ptrdiff_t)val; break;
+				default: *SCAN_OUT(args, int) = (int)val; break;
+				}
+				count++;
+			}
+			break;
+		}
+		case 'u': { // 无符号十进制整数
+			p = skip_whitespace(p, end);
+			uint64_t val;
+			int r = scan_uint(&p, end, op->width, 10, op->len_mod, &val);
+			if (r <= 0) {
+				SCAN_FAIL(r < 0 ? MY_SCANF_ERR_RANGE : MY_SCANF_ERR_MATCH);
+				return count;
+			}
+			if (!suppress) {
+				scan_store_uint(args, op->len_mod, val);
+				count++;
+			}
+			break;
+		}
+		case 'x': case 'X': { // 十六进制整数
+			p = skip_whitespace(p, end);
+			uint64_t val;
+			int r = scan_uint(&p, end, op->width, 16, op->len_mod, &val);
+			if (r <= 0) {
+				SCAN_FAIL(r < 0 ? MY_SCANF_ERR_RANGE : MY_SCANF_ERR_MATCH);
+				return count;
+			}
+			if (!suppress) {
+				scan_store_uint(args, op->len_mod, val);
+				count++;
+			}
+			break;
+		}
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A': { // 浮点数
+			p = skip_whitespace(p, end);
+			int ok;
+			if (op->len_mod == SCAN_LEN_LD) {
+				long double val;
+				ok = scan_long_double(&p, end, op->width, &val);
+				if (ok && !suppress) *SCAN_OUT(args, long double) = val;
+			}
+			else if (op->len_mod == SCAN_LEN_L) {
+				double val;
+				ok = scan_double(&p, end, op->width, &val);
+				if (ok && !suppress) *SCAN_OUT(args, double) = val;
+			}
+			else {
+				float val;
+				ok = scan_float(&p, end, op->width, &val);
+				if (ok && !suppress) *SCAN_OUT(args, float) = val;
+			}
+			if (!ok) {
+				SCAN_FAIL(MY_SCANF_ERR_MATCH);
+				return count;
+			}
+			if (!suppress) count++;
+			break;
+		}
+		case 'p': { // 指针地址（十六进制）
+			p = skip_whitespace(p, end);
+			uintptr_t val;
+			int r = scan_pointer(&p, end, op->width, &val);
+			if (r <= 0) {
+				SCAN_FAIL(r < 0 ? MY_SCANF_ERR_RANGE : MY_SCANF_ERR_MATCH);
+				return count;
+			}
+			if (!suppress) {
+				*SCAN_OUT(args, void*) = (void*)val;
+				count++;
+			}
+			break;
+		}
+		case 's': { // 字符串（支持 GB2312）
+			p = skip_whitespace(p, end);
+			if (p >= end && !suppress) {
+				SCAN_FAIL(MY_SCANF_ERR_MATCH);
+				return count;
+			}
+			if (!suppress && (op->alloc || op->intern)) {
+				void* out = SCAN_OUT(args, void);
+				const char* start = p;
+				size_t n = scan_word(&p, end, op->width, NULL, SIZE_MAX);
+				if (n == 0) {
+					SCAN_FAIL(MY_SCANF_ERR_MATCH);
+					return count;
+				}
+				int err = scan_own_str(op, out, start, n);
+				if (err) {
+					p = start;
+					SCAN_FAIL(err);
+					return count;
+				}
+				count++;
+			}
+			else if (!suppress && (op->span || args->spans)) {
+				my_scanf_span* out = SCAN_OUT(args, my_scanf_span);
+				const char* start = p;
+				size_t n = scan_word(&p, end, op->width, NULL, SIZE_MAX);
+				if (n == 0) {
+					SCAN_FAIL(MY_SCANF_ERR_MATCH);
+					return count;
+				}
+				out->ptr = start;
+				out->len = n;
+				count++;
+			}
+			else if (!suppress) {
+				char* str = SCAN_OUT(args, char);
+				size_t size = safe ? SCAN_SIZE(args) : SIZE_MAX;
+				if (scan_word(&p, end, op->width, str, size) == 0) {
+					SCAN_FAIL(MY_SCANF_ERR_MATCH);
+					return count;
+				}
+				count++;
+			}
+			else if (!scan_word_skip(&p, end, op->width) && p < end) {
+				SCAN_FAIL(MY_SCANF_ERR_MATCH);
+				return count;
+			}
+			break;
+		}
+		case '[': { // 扫描集（支持 %[...] 和 %[^...]）
+			const scan_charset* cs = &fmt->sets[op->set];
+			if (!suppress) {
+				size_t n;
+				if (op->alloc || op->intern) {
+					void* out = SCAN_OUT(args, void);
+					const char* start = p;
+					n = scan_set(&p, end, op->width, cs, NULL, SIZE_MAX);
+					int err = n > 0 ? scan_own_str(op, out, start, n) : MY_SCANF_ERR_NONE;
+					if (err) {
+						p = start;
+						SCAN_FAIL(err);
+						return count;
+					}
+				}
+				else if (op->span || args->spans) {
+					my_scanf_span* out = SCAN_OUT(args, my_scanf_span);
+					out->ptr = p;
+					out->len = n = scan_set(&p, end, op->width, cs, NULL, SIZE_MAX);
+				}
+				else {
+					char* str = SCAN_OUT(args, char);
+					size_t size = safe ? SCAN_SIZE(args) : SIZE_MAX;
+					n = scan_set(&p, end, op->width, cs, str, size);
+				}
+				if (n > 0) {
+					count++;
+				}
+				else {
+					scan_set_recover(&p, end, cs);
+				}
+			}
+			else if (!scan_set_skip(&p, end, op->width, cs)) {
+				scan_set_recover(&p, end, cs);
+			}
+			break;
+		}
+		case 'c': { // 单个字符（支持 GB2312）
+			if (p >= end) {
+				if (!suppress) {
+					SCAN_FAIL(MY_SCANF_ERR_MATCH);
+					return count;
+				}
+				break;
+			}
+			scan_char(&p, end, suppress ? NULL : SCAN_OUT(args, char));
+			if (!suppress) count++;
+			break;
+		}
+		case 'n': { // 记录已读取的字符数，超过 2GB 的输入用 %zn
+			if (!suppress) {
+				size_t off = (size_t)(p - input) + args->n_base;
+				switch (op->len_mod) {
+				case SCAN_LEN_HH: *SCAN_OUT(args, signed char) = (signed char)off; break;
+				case SCAN_LEN_H: *SCAN_OUT(args, short) = (short)off; break;
+				case SCAN_LEN_L: *SCAN_OUT(args, long) = (long)off; break;
+				case SCAN_LEN_LL: *SCAN_OUT(args, long long) = (long long)off; break;
+				case SCAN_LEN_I64: *SCAN_OUT(args, int64_t) = (int64_t)off; break;
+				case SCAN_LEN_Z: *SCAN_OUT(args, size_t) = off; break;
+				default: *SCAN_OUT(args, int) = (int)off; break;
+				}
+			}
+			break;
+		}
+		case '%': {
+			if (p >= end || *p != '%') {
+				SCAN_FAIL(MY_SCANF_ERR_LITERAL);
+				return count;
+			}
+			p++;
+			break;
+		}
+		}
+	}
+
+	return count;
+}
+
+#undef SCAN_FAIL
+
+static int scan_exec(const char* input, const char* end, const my_scanf_format* fmt, va_list args, int safe) {
+	va_list ap;
+	va_copy(ap, args);
+	scan_args a = {};
+	a.ap = &ap;
+	int count = scan_exec_ap(input, end, fmt, &a, safe);
+	va_end(ap);
+	return count;
+}
+
+// 计入返回值的赋值转换个数（不含 %n），即一行全部解析成功时的返回值
+static int scan_full_count(const my_scanf_format* fmt) {
+	int n = 0;
+	for (int k = 0; k < fmt->nops; k++) {
+		const scan_op* op = &fmt->ops[k];
+		if (op->kind == SCAN_OP_CONV && !op->suppress && op->conv != '%' && op->conv != 'n') n++;
+	}
+	return n;
+}
+
+// 地址形式输出时每个赋值转换的大小和对齐（按转换顺序），返回输出个数；sizes、aligns 可为 NULL。
+// %s 和 %[...] 按片段计（scan_args.spans），%ms 和 %m[...] 为 char*，%K 和 %K[...] 为 uint32_t，%c 为 char[2]
+static int scan_field_layout(const my_scanf_format* fmt, size_t* sizes, size_t* aligns) {
+	int n = 0;
+	for (int k = 0; k < fmt->nops; k++) {
+		const scan_op* op = &fmt->ops[k];
+		if (op->kind != SCAN_OP_CONV || op->suppress || op->conv == '%') continue;
+		size_t size, align;
+		switch (op->conv) {
+		case 's': case '[':
+			if (op->alloc) {
+				size = align = sizeof(char*);
+				break;
+			}
+			if (op->intern) {
+				size = align = sizeof(uint32_t);
+				break;
+			}
+			size = sizeof(my_scanf_span);
+			align = alignof(my_scanf_span);
+			break;
+		case 'c':
+			size = 2;
+			align = 1;
+			break;
+		case 'p':
+			size = align = sizeof(void*);
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			if (op->len_mod == SCAN_LEN_LD) {
+				size = sizeof(long double);
+				align = alignof(long double);
+			}
+			else {
+				size = align = op->len_mod == SCAN_LEN_L ? sizeof(double) : sizeof(float);
+			}
+			break;
+		default: // 整数和 %n
+			switch (op->len_mod) {
+			case SCAN_LEN_HH: size = 1; break;
+			case SCAN_LEN_H: size = sizeof(short); break;
+			case SCAN_LEN_L: size = sizeof(long); break;
+			case SCAN_LEN_LL: case SCAN_LEN_I64: size = sizeof(long long); break;
+			case SCAN_LEN_Z: size = sizeof(size_t); break;
+			default: size = sizeof(int); break;
+			}
+			align = size;
+			break;
+		}
+		if (sizes) sizes[n] = size;
+		if (aligns) aligns[n] = align;
+		n++;
+	}
+	return n;
+}
+
+// 使用预编译格式的 my_vsscanf，无需 sizeof(str)
+int my_vsscanf_compiled(const char* input, const my_scanf_format* fmt, va_list args) {
+	if (!input || !fmt) return -1;
+	return scan_exec(input, input + strlen(input), fmt, args, 0);
+}
+int my_sscanf_compiled(const char* input, const my_scanf_format* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	int count = my_vsscanf_compiled(input, fmt, args);
+	va_end(args);
+	return count;
+}
+
+// 使用预编译格式的 my_vsscanf_s，%s 和 %[...] 必须提供 sizeof(str)
+int my_vsscanf_s_compiled(const char* input, const my_scanf_format* fmt, va_list args) {
+	if (!input || !fmt) return -1;
+	return scan_exec(input, input + strlen(input), fmt, args, 1);
+}
+int my_sscanf_s_compiled(const char* input, const my_scanf_format* fmt, ...) {
+	va_list args;
+	va_start(args, fmt);
+	int count = my_vsscanf_s_compiled(input, fmt, args);
+	va_end(args);
+	return count;
+}
+
+// ================= 格式缓存 =================
+// my_vsscanf / my_vsscanf_s 按“格式串指针 + 内容哈希”缓存编译结果。
+// 查找不加锁：读者只在自己的纪元槽中登记当前纪元。插入与淘汰由一把锁串行化，
+// 被换下的条目先挂到回收链表，等所有读者都离开了淘汰时的纪元后再释放。
+
+#define SCAN_CACHE_SETS 64 // 组数
+#define SCAN_CACHE_WAYS 4  // 每组路数，缓存最多 SETS * WAYS 个格式
+
+typedef struct scan_cache_entry {
+	const char* key;                 // 格式串指针
+	uint64_t hash;                   // 格式串内容哈希
+	size_t len;                      // 格式串长度
+	const my_scanf_format* fmt;      // 编译结果
+	std::atomic<unsigned char> used; // 最近是否命中，CLOCK 淘汰用
+	uint64_t retired;                // 被淘汰时的纪元
+	struct scan_cache_entry* next;   // 回收链表
+} scan_cache_entry;
+
+// 每个线程一个读者槽，线程退出后槽位留给其他线程复用
+typedef struct scan_reader {
+	std::atomic<uint64_t> epoch; // 正在读时为进入时的纪元，否则为 0
+	std::atomic<bool> in_use;
+	int depth;                   // 嵌套层数（诊断回调中再次解析），只由所属线程访问
+	struct scan_reader* next;
+} scan_reader;
+
+static std::atomic<scan_cache_entry*> g_scan_cache[SCAN_CACHE_SETS][SCAN_CACHE_WAYS];
+static std::atomic<uint64_t> g_scan_epoch(1);
+static std::atomic<scan_reader*> g_scan_readers(nullptr);
+static std::mutex g_scan_cache_lock;              // 只保护写入方
+static scan_cache_entry* g_scan_retired = NULL;   // 待回收条目
+static unsigned g_scan_clock[SCAN_CACHE_SETS];    // 每组的 CLOCK 指针
+
+static scan_reader* scan_reader_acquire() {
+	for (scan_reader* r = g_scan_readers.load(std::memory_order_acquire); r; r = r->next) {
+		bool expected = false;
+		if (!r->in_use.load(std::memory_order_relaxed) &&
+			r->in_use.compare_exchange_strong(expected, true)) {
+			return r;
+		}
+	}
+	scan_reader* r = new scan_reader;
+	r->epoch.store(0, std::memory_order_relaxed);
+	r->depth = 0;
+	r->in_use.store(true, std::memory_order_relaxed);
+	r->next = g_scan_readers.load(std::memory_order_relaxed);
+	while (!g_scan_readers.compare_exchange_weak(r->next, r, std::memory_order_release)) {
+	}
+	return r;
+}
+
+struct scan_reader_handle {
+	scan_reader* r;
+	scan_reader_handle() : r(scan_reader_acquire()) {}
+	~scan_reader_handle() { r->in_use.store(false, std::memory_order_release); }
+};
+static thread_local scan_reader_handle t_scan_reader;
+
+// 进入读临界区：登记纪元后，本线程看到的条目在退出前不会被释放。
+// 可以嵌套（诊断回调中再次调用 my_sscanf），只有最外层登记和清除纪元
+static scan_reader* scan_epoch_enter() {
+	scan_reader* r = t_scan_reader.r;
+	if (r->depth++ == 0) {
+		r->epoch.store(g_scan_epoch.load(std::memory_order_relaxed), std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+	}
+	return r;
+}
+
+static void scan_epoch_exit(scan_reader* r) {
+	if (--r->depth == 0) r->epoch.store(0, std::memory_order_release);
+}
+
+// 释放所有读者都已不可能持有的条目，调用方持有 g_scan_cache_lock
+static void scan_cache_reclaim() {
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	uint64_t oldest = UINT64_MAX;
+	for (scan_reader* r = g_scan_readers.load(std::memory_order_acquire); r; r = r->next) {
+		uint64_t e = r->epoch.load(std::memory_order_acquire);
+		if (e && e < oldest) oldest = e;
+	}
+	scan_cache_entry** link = &g_scan_retired;
+	while (*link) {
+		scan_cache_entry* e = *link;
+		if (e->retired < oldest) {
+			*link = e->next;
+			my_scanf_free(e->fmt);
+			delete e;
+		}
+		else {
+			link = &e->next;
+		}
+	}
+}
+
+// FNV-1a 哈希，同时求出格式串长度
+static uint64_t scan_format_hash(const char* format, size_t* len) {
+	uint64_t h = 14695981039346656037ULL;
+	const char* f = format;
+	while (*f) {
+		h = (h ^ (unsigned char)*f++) * 1099511628211ULL;
+	}
+	*len = (size_t)(f - format);
+	return h;
+}
+
+static int scan_cache_match(const scan_cache_entry* e, const char* format, uint64_t hash, size_t len) {
+	return e && e->key == format && e->hash == hash && e->len == len &&
+		memcmp(e->fmt->format, format, len) == 0;
+}
+
+// 查找或编译格式；必须在 scan_epoch_enter / scan_epoch_exit 之间调用
+static const my_scanf_format* scan_cache_get(const char* format) {
+	size_t len;
+	uint64_t hash = scan_format_hash(format, &len);
+	uintptr_t key = (uintptr_t)format;
+	unsigned set = (unsigned)((hash ^ (key >> 4) ^ (key >> 12)) % SCAN_CACHE_SETS);
+	std::atomic<scan_cache_entry*>* ways = g_scan_cache[set];
+
+	for (int w = 0; w < SCAN_CACHE_WAYS; w++) {
+		scan_cache_entry* e = ways[w].load(std::memory_order_acquire);
+		if (scan_cache_match(e, format, hash, len)) {
+			if (!e->used.load(std::memory_order_relaxed)) {
+				e->used.store(1, std::memory_order_relaxed);
+			}
+			return e->fmt;
+		}
+	}
+
+	// 未命中：在锁外编译，再插入
+	const my_scanf_format* fmt = my_scanf_compile(format);
+	if (!fmt) return NULL;
+	scan_cache_entry* ne = new scan_cache_entry;
+	ne->key = format;
+	ne->hash = hash;
+	ne->len = len;
+	ne->fmt = fmt;
+	ne->used.store(1, std::memory_order_relaxed);
+	ne->retired = 0;
+	ne->next = NULL;
+
+	std::lock_guard<std::mutex> guard(g_scan_cache_lock);
+	int victim = -1;
+	for (int w = 0; w < SCAN_CACHE_WAYS; w++) {
+		scan_cache_entry* e = ways[w].load(std::memory_order_relaxed);
+		if (scan_cache_match(e, format, hash, len)) {
+			// 其他线程已经插入了同一格式
+			my_scanf_free(fmt);
+			delete ne;
+			return e->fmt;
+		}
+		if (!e && victim < 0) victim = w;
+	}
+	if (victim < 0) {
+		// CLOCK：跳过最近命中过的条目并清除其标记
+		for (;;) {
+			unsigned w = g_scan_clock[set]++ % SCAN_CACHE_WAYS;
+			scan_cache_entry* e = ways[w].load(std::memory_order_relaxed);
+			if (!e->used.load(std::memory_order_relaxed)) {
+				victim = (int)w;
+				break;
+			}
+			e->used.store(0, std::memory_order_relaxed);
+		}
+	}
+	scan_cache_entry* old = ways[victim].exchange(ne, std::memory_order_seq_cst);
+	if (old) {
+		old->retired = g_scan_epoch.fetch_add(1, std::memory_order_seq_cst);
+		old->next = g_scan_retired;
+		g_scan_retired = old;
+	}
+	if (g_scan_retired) scan_cache_reclaim();
+	return fmt;
+}
+
+static int scan_cached(const char* input, const char* end, const char* format, va_list args, int safe) {
+	if (!input || !format) return -1;
+	scan_reader* r = scan_epoch_enter();
+	const my_scanf_format* fmt = scan_cache_get(format);
+	int count = fmt ? scan_exec(input, end, fmt, args, safe) : -1;
+	scan_epoch_exit(r);
+	return count;
+}
+
+// 支持 GB2312 和扩展格式的 my_sscanf 函数，无需 sizeof(str)
+int my_vsscanf(const char* input, const char* format, va_list args) {
+	return scan_cached(input, input ? input + strlen(input) : NULL, format, args, 0);
+}
+int my_sscanf(const char* input, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf(input, format, args);
+	va_end(args);
+	return count;
+}
+
+// 支持 GB2312 和扩展格式的 my_sscanf_s 函数，%s 和 %[...] 必须提供 sizeof(str)
+int my_vsscanf_s(const char* input, const char* format, va_list args) {
+	return scan_cached(input, input ? input + strlen(input) : NULL, format, args, 1);
+}
+int my_sscanf_s(const char* input, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf_s(input, format, args);
+	va_end(args);
+	return count;
+}
+
+// 按长度解析 input 的前 len 个字节，不要求以 '\0' 结尾，也不会读取 len 之外的字节，
+// 可直接解析大缓冲区、网络缓冲区或 mmap 中的一段记录
+int my_vsscanf_n(const char* input, size_t len, const char* format, va_list args) {
+	if (!input && len == 0) input = "";
+	return scan_cached(input, input ? input + len : NULL, format, args, 0);
+}
+int my_sscanf_n(const char* input, size_t len, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf_n(input, len, format, args);
+	va_end(args);
+	return count;
+}
+
+int my_vsscanf_s_n(const char* input, size_t len, const char* format, va_list args) {
+	if (!input && len == 0) input = "";
+	return scan_cached(input, input ? input + len : NULL, format, args, 1);
+}
+int my_sscanf_s_n(const char* input, size_t len, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf_s_n(input, len, format, args);
+	va_end(args);
+	return count;
+}
+
+#if __cplusplus >= 201703L
+// std::string_view 版本，同 my_sscanf_n / my_sscanf_s_n
+int my_sscanf(std::string_view input, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf_n(input.data(), input.size(), format, args);
+	va_end(args);
+	return count;
+}
+int my_sscanf_s(std::string_view input, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf_s_n(input.data(), input.size(), format, args);
+	va_end(args);
+	return count;
+}
+#endif
+
+
+// ================= 行读取 =================
+// my_fscanf / my_fscanf_s 每次从 FILE 读取完整的一行（长度不限），不会多读，
+// 因此可以和 fgets、fseek 等交替使用。行缓冲区每个线程一份，随最长的行增长。
+
+typedef struct scan_line_buf {
+	char* data;
+	size_t cap;
+	~scan_line_buf() { free(data); }
+} scan_line_buf;
+
+static thread_local scan_line_buf g_scan_line;
+
+// 读取一行，去掉末尾的 "\n" 或 "\r\n"；成功返回 1，文件结束或出错返回 0
+static int scan_read_line(FILE* fp, const char** line, size_t* len) {
+	scan_line_buf* lb = &g_scan_line;
+	size_t n = 0;
+#ifndef _WIN32
+	ssize_t r = getline(&lb->data, &lb->cap, fp);
+	if (r <= 0) return 0;
+	n = (size_t)r;
+#else
+	for (;;) {
+		if (lb->cap - n < 2) {
+			size_t cap = lb->cap ? lb->cap * 2 : 1024;
+			char* data = (char*)realloc(lb->data, cap);
+			if (!data) return 0;
+			lb->data = data;
+			lb->cap = cap;
+		}
+		if (!fgets(lb->data + n, (int)(lb->cap - n > INT_MAX ? INT_MAX : lb->cap - n), fp)) break;
+		n += strlen(lb->data + n);
+		if (lb->data[n - 1] == '\n') break;
+	}
+	if (n == 0) return 0;
+#endif
+	if (n > 0 && lb->data[n - 1] == '\n') n--;
+	if (n > 0 && lb->data[n - 1] == '\r') n--;
+	*line = lb->data;
+	*len = n;
+	return 1;
+}
+
+// 从文件中解析当前一行的 my_fscanf，无需 sizeof(str)
+int my_fscanf(const FILE* fp, const char* format, ...) {
+	// 文件指针必须有效
+	if (!fp) return -1;
+
+	const char* line;
+	size_t len;
+	if (!scan_read_line((FILE*)fp, &line, &len)) return 0; // 读取失败或到达文件末尾
+
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf_n(line, len, format, args);
+	va_end(args);
+	return count;
+}
+
+// 从文件中解析当前一行的 my_fscanf_s，%s 和 %[...] 必须提供 sizeof(str)
+int my_fscanf_s(const FILE* fp, const char* format, ...) {
+	if (!fp) return -1;
+
+	const char* line;
+	size_t len;
+	if (!scan_read_line((FILE*)fp, &line, &len)) return 0;
+
+	va_list args;
+	va_start(args, format);
+	int count = my_vsscanf_s_n(line, len, format, args);
+	va_end(args);
+	return count;
+}
+
+// 记录读取器：自带大块缓冲区，整块 fread 后用 scan_isa.find_byte 查找分隔符，
+// 记录直接以缓冲区中的片段交给解析器，没有逐行复制和 strlen。
+// 缓冲区会预读，读取器打开后不要再直接读取同一个 FILE。
+typedef struct scan_readahead scan_readahead;
+
+struct my_scanf_reader {
+	FILE* fp;
+	char* buf;
+	size_t cap;
+	size_t pos;     // 未读数据起点
+	size_t lim;     // 未读数据终点
+	size_t scanned; // [pos, pos + scanned) 已确认没有分隔符，补充数据后不再重复查找
+	char sep;       // 记录分隔符，默认 '\n'
+	char eof;
+	char err;
+	char own_fp;    // 关闭时一并关闭 fp
+	scan_readahead* ra; // 后台预读模式，见 my_scanf_reader_open_readahead
+	unsigned long long bytes;
+	unsigned long long blocks;
+	double parse_stall; // 同步模式下等待 fread 的时间
+};
+
+static int scan_readahead_next(my_scanf_reader* r, const char** rec, size_t* len);
+static void scan_readahead_close(scan_readahead* ra);
+
+#define SCAN_READER_DEFAULT_SIZE (256 * 1024)
+
+// 打开读取器，bufsize 为 0 时使用 256KB；记录长度超过缓冲区时自动扩大
+my_scanf_reader* my_scanf_reader_open(FILE* fp, size_t bufsize) {
+	if (!fp) return NULL;
+	if (bufsize == 0) bufsize = SCAN_READER_DEFAULT_SIZE;
+	my_scanf_reader* r = (my_scanf_reader*)calloc(1, sizeof(my_scanf_reader));
+	if (!r) return NULL;
+	r->buf = (char*)malloc(bufsize);
+	if (!r->buf) {
+		free(r);
+		return NULL;
+	}
+	r->fp = fp;
+	r->cap = bufsize;
+	r->sep = '\n';
+	return r;
+}
+
+// 关闭读取器，不关闭 FILE
+void my_scanf_reader_close(my_scanf_reader* r) {
+	if (!r) return;
+	if (r->ra) scan_readahead_close(r->ra);
+	if (r->own_fp) fclose(r->fp);
+	free(r->buf);
+	free(r);
+}
+
+// 设置记录分隔符；分隔符为 '\n' 时记录末尾的 '\r' 一并去掉
+void my_scanf_reader_set_separator(my_scanf_reader* r, char sep) {
+	if (!r) return;
+	r->sep = sep;
+	r->scanned = 0;
+}
+
+// 补充数据：未读部分移到缓冲区开头，满了则扩大一倍。返回 0 表示没有读到新数据
+static int scan_reader_fill(my_scanf_reader* r) {
+	if (r->eof || r->err) return 0;
+	if (r->pos > 0) {
+		memmove(r->buf, r->buf + r->pos, r->lim - r->pos);
+		r->lim -= r->pos;
+		r->pos = 0;
+	}
+	if (r->lim == r->cap) {
+		char* buf = (char*)realloc(r->buf, r->cap * 2);
+		if (!buf) {
+			r->err = 1;
+			return 0;
+		}
+		r->buf = buf;
+		r->cap *= 2;
+	}
+	auto t0 = std::chrono::steady_clock::now();
+	size_t n = fread(r->buf + r->lim, 1, r->cap - r->lim, r->fp);
+	r->parse_stall += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	r->bytes += n;
+	r->blocks++;
+	if (n == 0) {
+		if (ferror(r->fp)) r->err = 1;
+		else r->eof = 1;
+		return 0;
+	}
+	r->lim += n;
+	return 1;
+}
+
+// 取下一条记录（不含分隔符），片段在下一次调用前有效。
+// 返回 1 表示成功，0 表示没有更多记录，-1 表示读取出错
+int my_scanf_reader_next(my_scanf_reader* r, const char** rec, size_t* len) {
+	if (!r || !rec || !len) return -1;
+	if (r->ra) {
+		int ret = scan_readahead_next(r, rec, len);
+		if (ret <= 0) return ret;
+	}
+	else for (;;) {
+		size_t avail = r->lim - r->pos;
+		size_t i = r->scanned + scan_isa.find_byte(r->buf + r->pos + r->scanned, avail - r->scanned, r->sep);
+		if (i < avail) {
+			*rec = r->buf + r->pos;
+			*len = i;
+			r->pos += i + 1;
+			r->scanned = 0;
+			break;
+		}
+		r->scanned = avail;
+		if (!scan_reader_fill(r)) {
+			if (r->err) return -1;
+			if (avail == 0) return 0;
+			// 最后一条记录没有分隔符
+			*rec = r->buf + r->pos;
+			*len = avail;
+			r->pos = r->lim;
+			r->scanned = 0;
+			break;
+		}
+	}
+	if (r->sep == '\n' && *len > 0 && (*rec)[*len - 1] == '\r') (*len)--;
+	return 1;
+}
+
+// ---- 后台预读 ----
+// 专门的 I/O 线程用 pread 按块读取文件，填入 depth 个块组成的环形队列；解析线程直接在块中查找分隔符，
+// 完整的记录原地返回，跨块的记录拼接到 carry 中。块用完后归还给 I/O 线程，读取与解析同时进行。
+// 队列深度为 2 时即双缓冲：I/O 线程填充一块，解析线程处理另一块。
+
+#define SCAN_READAHEAD_BLOCK (1024 * 1024)
+
+struct scan_readahead {
+	int fd;
+	size_t block;
+	size_t depth;
+	char** bufs;
+	size_t* lens;
+	size_t head; // I/O 线程已填充的块数
+	size_t tail; // 解析线程已归还的块数；块 tail % depth 为当前块
+	bool done;   // 读到文件末尾或出错
+	bool err;
+	bool stop;
+	std::mutex mu;
+	std::condition_variable filled;
+	std::condition_variable freed;
+	std::thread io;
+	// 解析线程
+	bool holding; // 正在处理块 tail % depth
+	size_t pos;
+	char* carry;
+	size_t carry_len;
+	size_t carry_cap;
+	bool carry_out; // 上次返回的记录在 carry 中，下次调用时清空
+	// 统计
+	unsigned long long bytes;
+	unsigned long long blocks;
+	double io_stall;
+	double parse_stall;
+};
+
+static void scan_readahead_io(scan_readahead* ra) {
+#ifndef _WIN32
+	unsigned long long off = 0;
+	for (;;) {
+		std::unique_lock<std::mutex> lock(ra->mu);
+		if (ra->head - ra->tail == ra->depth && !ra->stop) {
+			auto t0 = std::chrono::steady_clock::now();
+			ra->freed.wait(lock, [&] { return ra->head - ra->tail < ra->depth || ra->stop; });
+			ra->io_stall += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		}
+		if (ra->stop) return;
+		size_t slot = ra->head % ra->depth;
+		lock.unlock();
+
+		// 读满一块再交出，短读时继续读
+		size_t n = 0;
+		bool err = false;
+		while (n < ra->block) {
+			ssize_t got = pread(ra->fd, ra->bufs[slot] + n, ra->block - n, (off_t)(off + n));
+			if (got < 0 && errno == EINTR) continue;
+			if (got < 0) err = true;
+			if (got <= 0) break;
+			n += (size_t)got;
+		}
+		off += n;
+
+		lock.lock();
+		if (n > 0) {
+			ra->lens[slot] = n;
+			ra->head++;
+			ra->bytes += n;
+			ra->blocks++;
+		}
+		if (n < ra->block) {
+			ra->done = true;
+			ra->err = err;
+		}
+		ra->filled.notify_one();
+		if (ra->done) return;
+	}
+#else
+	(void)ra;
+#endif
+}
+
+static int scan_carry_append(scan_readahead* ra, const char* p, size_t n) {
+	if (ra->carry_cap - ra->carry_len < n) {
+		size_t cap = ra->carry_cap ? ra->carry_cap : 4096;
+		while (cap - ra->carry_len < n) cap *= 2;
+		char* carry = (char*)realloc(ra->carry, cap);
+		if (!carry) return 0;
+		ra->carry = carry;
+		ra->carry_cap = cap;
+	}
+	memcpy(ra->carry + ra->carry_len, p, n);
+	ra->carry_len += n;
+	return 1;
+}
+
+static int scan_readahead_next(my_scanf_reader* r, const char** rec, size_t* len) {
+	scan_readahead* ra = r->ra;
+	if (ra->carry_out) {
+		ra->carry_len = 0;
+		ra->carry_out = false;
+	}
+	for (;;) {
+		if (ra->holding) {
+			size_t slot = ra->tail % ra->depth;
+			const char* p = ra->bufs[slot] + ra->pos;
+			size_t avail = ra->lens[slot] - ra->pos;
+			size_t i = scan_isa.find_byte(p, avail, r->sep);
+			if (i < avail) {
+				ra->pos += i + 1;
+				if (ra->carry_len == 0) {
+					*rec = p;
+					*len = i;
+					return 1;
+				}
+				if (!scan_carry_append(ra, p, i)) return -1;
+				*rec = ra->carry;
+				*len = ra->carry_len;
+				ra->carry_out = true;
+				return 1;
+			}
+			// 块内剩下的是下一条记录的开头，拼接后归还本块
+			if (!scan_carry_append(ra, p, avail)) return -1;
+			std::lock_guard<std::mutex> lock(ra->mu);
+			ra->holding = false;
+			ra->tail++;
+			ra->freed.notify_one();
+		}
+
+		std::unique_lock<std::mutex> lock(ra->mu);
+		if (ra->head == ra->tail && !ra->done) {
+			auto t0 = std::chrono::steady_clock::now();
+			ra->filled.wait(lock, [&] { return ra->head != ra->tail || ra->done; });
+			ra->parse_stall += std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		}
+		if (ra->head == ra->tail) {
+			// 没有更多数据
+			if (ra->err) return -1;
+			if (ra->carry_len == 0) return 0;
+			*rec = ra->carry;
+			*len = ra->carry_len;
+			ra->carry_out = true;
+			return 1;
+		}
+		ra->holding = true;
+		ra->pos = 0;
+	}
+}
+
+static void scan_readahead_close(scan_readahead* ra) {
+	{
+		std::lock_guard<std::mutex> lock(ra->mu);
+		ra->stop = true;
+		ra->freed.notify_one();
+	}
+	if (ra->io.joinable()) ra->io.join();
+#ifndef _WIN32
+	if (ra->fd >= 0) close(ra->fd);
+#endif
+	for (size_t i = 0; i < ra->depth; i++) free(ra->bufs ? ra->bufs[i] : NULL);
+	free(ra->bufs);
+	free(ra->lens);
+	free(ra->carry);
+	delete ra;
+}
+
+// 打开文件并启动后台预读：block_size 为每次 pread 的块大小（0 表示 1MB），depth 为队列中的块数（至少 2）。
+// 不支持 pread 的平台上退化为普通的读取器
+my_scanf_reader* my_scanf_reader_open_readahead(const char* path, size_t block_size, int depth) {
+	if (!path) return NULL;
+	if (block_size == 0) block_size = SCAN_READAHEAD_BLOCK;
+	if (depth < 2) depth = 2;
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) return NULL;
+#ifdef POSIX_FADV_SEQUENTIAL
+	posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+	my_scanf_reader* r = (my_scanf_reader*)calloc(1, sizeof(my_scanf_reader));
+	scan_readahead* ra = new (std::nothrow) scan_readahead();
+	if (!r || !ra) {
+		close(fd);
+		free(r);
+		delete ra;
+		return NULL;
+	}
+	ra->fd = fd;
+	ra->block = block_size;
+	ra->depth = (size_t)depth;
+	ra->bufs = (char**)calloc(ra->depth, sizeof(char*));
+	ra->lens = (size_t*)calloc(ra->depth, sizeof(size_t));
+	bool ok = ra->bufs && ra->lens;
+	for (size_t i = 0; ok && i < ra->depth; i++) {
+		ra->bufs[i] = (char*)malloc(block_size);
+		ok = ra->bufs[i] != NULL;
+	}
+	if (ok) {
+		try {
+			ra->io = std::thread(scan_readahead_io, ra);
+		}
+		catch (...) {
+			ok = false;
+		}
+	}
+	if (!ok) {
+		scan_readahead_close(ra);
+		free(r);
+		return NULL;
+	}
+	r->ra = ra;
+	r->sep = '\n';
+	return r;
+#else
+	FILE* fp = fopen(path, "rb");
+	if (!fp) return NULL;
+	my_scanf_reader* r = my_scanf_reader_open(fp, block_size);
+	if (!r) {
+		fclose(fp);
+		return NULL;
+	}
+	r->own_fp = 1;
+	return r;
+#endif
+}
+
+// 读取器的统计
+typedef struct my_scanf_reader_stats {
+	unsigned long long bytes;  // 已读取的字节数
+	unsigned long long blocks; // 读取次数（块数）
+	double io_stall;           // I/O 线程等待空闲块的时间（秒），仅预读模式
+	double parse_stall;        // 解析线程等待数据的时间（秒）
+} my_scanf_reader_stats;
+
+int my_scanf_reader_get_stats(my_scanf_reader* r, my_scanf_reader_stats* st) {
+	if (!r || !st) return -1;
+	if (r->ra) {
+		std::lock_guard<std::mutex> lock(r->ra->mu);
+		st->bytes = r->ra->bytes;
+		st->blocks = r->ra->blocks;
+		st->io_stall = r->ra->io_stall;
+		st->parse_stall = r->ra->parse_stall;
+	}
+	else {
+		st->bytes = r->bytes;
+		st->blocks = r->blocks;
+		st->io_stall = 0;
+		st->parse_stall = r->parse_stall;
+	}
+	return 0;
+}
+
+// 从读取器取下一条记录并解析，返回成功赋值的项数；与 fscanf 一样，没有更多记录或读取出错时返回 EOF，
+// 空记录返回 0，不会与文件结束混淆
+int my_vrscanf(my_scanf_reader* r, const char* format, va_list args) {
+	const char* rec;
+	size_t len;
+	int ret = my_scanf_reader_next(r, &rec, &len);
+	if (ret <= 0) return EOF;
+	return my_vsscanf_n(rec, len, format, args);
+}
+int my_rscanf(my_scanf_reader* r, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vrscanf(r, format, args);
+	va_end(args);
+	return count;
+}
+
+int my_vrscanf_s(my_scanf_reader* r, const char* format, va_list args) {
+	const char* rec;
+	size_t len;
+	int ret = my_scanf_reader_next(r, &rec, &len);
+	if (ret <= 0) return EOF;
+	return my_vsscanf_s_n(rec, len, format, args);
+}
+int my_rscanf_s(my_scanf_reader* r, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vrscanf_s(r, format, args);
+	va_end(args);
+	return count;
+}
+
+
+// ================= 流模式 my_fscanf =================
+// my_fscanf_stream 与 libc fscanf 一样只读取格式匹配到的字符，同一行剩下的内容留给后续的读取。
+// 每个转换按说明符的字符规则用 getc_unlocked 逐字节收集到线程内的缓冲区（getc_unlocked 直接读取 FILE 的缓冲区），
+// 多读的一个字节用 ungetc 退回，然后交给与 my_sscanf 相同的执行器转换并写入参数。每次调用只锁一次 FILE。
+// 与 fscanf 一样，只保证退回一个字节：例如 %f 遇到 "1e+x" 时 "1e+" 已被读走。
+// %V 需要稳定的输入缓冲区，流模式下不支持。
+
+#ifdef _WIN32
+#define scan_lockfile _lock_file
+#define scan_unlockfile _unlock_file
+#define scan_getc _getc_nolock
+#define scan_ungetc _ungetc_nolock
+#else
+#define scan_lockfile flockfile
+#define scan_unlockfile funlockfile
+#define scan_getc getc_unlocked
+#define scan_ungetc ungetc
+#endif
+
+typedef struct scan_stream_in {
+	FILE* fp;
+	size_t consumed;   // 本次调用已读取的字节数（%n）
+	scan_line_buf* tb; // 当前转换收集到的字符，即本线程的 g_scan_token
+	size_t n;
+	int oom;
+} scan_stream_in;
+
+static thread_local scan_line_buf g_scan_token;
+
+static inline int scan_sgetc(scan_stream_in* in) {
+	int c = scan_getc(in->fp);
+	if (c != EOF) in->consumed++;
+	return c;
+}
+
+static inline void scan_sungetc(scan_stream_in* in, int c) {
+	if (c == EOF) return;
+	scan_ungetc(c, in->fp);
+	in->consumed--;
+}
+
+static inline void scan_tok_push(scan_stream_in* in, int c) {
+	scan_line_buf* tb = in->tb;
+	if (in->n + 1 >= tb->cap) {
+		size_t cap = tb->cap ? tb->cap * 2 : 256;
+		char* data = (char*)realloc(tb->data, cap);
+		if (!data) {
+			in->oom = 1;
+			return;
+		}
+		tb->data = data;
+		tb->cap = cap;
+	}
+	tb->data[in->n++] = (char)c;
+}
+
+// 跳过空白，返回下一个字节（已退回）
+static int scan_stream_space(scan_stream_in* in) {
+	int c;
+	while ((c = scan_sgetc(in)) != EOF && scan_space_table[c]) {}
+	scan_sungetc(in, c);
+	return c;
+}
+
+// 整数和 %p：可选符号，十六进制时可带 "0x" 前缀
+static void scan_stream_int(scan_stream_in* in, size_t lim, int hex) {
+	int c = scan_sgetc(in);
+	if ((c == '+' || c == '-') && in->n < lim) {
+		scan_tok_push(in, c);
+		c = scan_sgetc(in);
+	}
+	if (hex && c == '0' && in->n < lim) {
+		scan_tok_push(in, c);
+		c = scan_sgetc(in);
+		if ((c == 'x' || c == 'X') && in->n < lim) {
+			scan_tok_push(in, c);
+			c = scan_sgetc(in);
+		}
+	}
+	while (c != EOF && in->n < lim && (hex ? isxdigit(c) : (c >= '0' && c <= '9'))) {
+		scan_tok_push(in, c);
+		c = scan_sgetc(in);
+	}
+	scan_sungetc(in, c);
+}
+
+// 浮点数：十进制、十六进制、inf/infinity、nan/nan(...)
+static void scan_stream_real(scan_stream_in* in, size_t lim) {
+	int c = scan_sgetc(in);
+	if ((c == '+' || c == '-') && in->n < lim) {
+		scan_tok_push(in, c);
+		c = scan_sgetc(in);
+	}
+	if (c == 'i' || c == 'I' || c == 'n' || c == 'N') {
+		const char* word = (c | 0x20) == 'i' ? "infinity" : "nan";
+		size_t k = 0;
+		while (c != EOF && in->n < lim && word[k] && (c | 0x20) == word[k]) {
+			scan_tok_push(in, c);
+			k++;
+			c = scan_sgetc(in);
+		}
+		if (word[0] == 'n' && !word[k] && c == '(') {
+			do {
+				scan_tok_push(in, c);
+				c = scan_sgetc(in);
+			} while (c != EOF && in->n < lim && (isalnum(c) || c == '_'));
+			if (c == ')' && in->n < lim) {
+				scan_tok_push(in, c);
+				c = scan_sgetc(in);
+			}
+		}
+		scan_sungetc(in, c);
+		return;
+	}
+	int hex = 0;
+	int digits = 0;
+	if (c == '0' && in->n < lim) {
+		scan_tok_push(in, c);
+		digits = 1;
+		c = scan_sgetc(in);
+		if ((c == 'x' || c == 'X') && in->n < lim) {
+			scan_tok_push(in, c);
+			hex = 1;
+			digits = 0;
+			c = scan_sgetc(in);
+		}
+	}
+	while (c != EOF && in->n < lim && (hex ? isxdigit(c) : (c >= '0' && c <= '9'))) {
+		scan_tok_push(in, c);
+		digits = 1;
+		c = scan_sgetc(in);
+	}
+	if (c == '.' && in->n < lim) {
+		scan_tok_push(in, c);
+		c = scan_sgetc(in);
+		while (c != EOF && in->n < lim && (hex ? isxdigit(c) : (c >= '0' && c <= '9'))) {
+			scan_tok_push(in, c);
+			digits = 1;
+			c = scan_sgetc(in);
+		}
+	}
+	if (digits && in->n < lim && (hex ? (c == 'p' || c == 'P') : (c == 'e' || c == 'E'))) {
+		scan_tok_push(in, c);
+		c = scan_sgetc(in);
+		if ((c == '+' || c == '-') && in->n < lim) {
+			scan_tok_push(in, c);
+			c = scan_sgetc(in);
+		}
+		while (c != EOF && in->n < lim && c >= '0' && c <= '9') {
+			scan_tok_push(in, c);
+			c = scan_sgetc(in);
+		}
+	}
+	scan_sungetc(in, c);
+}
+
+// %s 和 %[...]：规则同 scan_word / scan_set，GB2312 首字节连同下一个字节一起读取。
+// cs 为 NULL 时读到空白为止；size 为目标缓冲区大小
+static void scan_stream_chars(scan_stream_in* in, size_t lim, size_t size, const scan_charset* cs) {
+	if (size - 1 < lim) lim = size - 1;
+	while (in->n < lim) {
+		int c = scan_sgetc(in);
+		if (c == EOF) break;
+		if (cs ? !scan_charset_has(cs->match, (unsigned char)c) : scan_space_table[c]) {
+			scan_sungetc(in, c);
+			break;
+		}
+		scan_tok_push(in, c);
+		if (is_gb2312_lead_byte((unsigned char)c) && in->n < size - 1) {
+			c = scan_sgetc(in);
+			if (c == EOF) break;
+			scan_tok_push(in, c);
+		}
+	}
+}
+
+// 执行单条转换指令：收集字符后交给执行器。成功返回 1，匹配失败返回 0，还没读到字符就遇到文件结束返回 EOF
+static int scan_stream_conv(scan_stream_in* in, const my_scanf_format* fmt, const scan_op* op, va_list* ap, int safe, int* count) {
+	size_t lim = op->width > 0 ? (size_t)op->width : SIZE_MAX;
+	in->n = 0;
+	int c = 0;
+	if (op->conv != 'c' && op->conv != '[' && op->conv != 'n' && op->conv != '%') c = scan_stream_space(in);
+	else if (op->conv != 'n') {
+		c = scan_sgetc(in);
+		scan_sungetc(in, c);
+	}
+	if (c == EOF) return EOF;
+
+	switch (op->conv) {
+	case 'd': case 'i': case 'u':
+		scan_stream_int(in, lim, 0);
+		break;
+	case 'x': case 'X': case 'p':
+		scan_stream_int(in, lim, 1);
+		break;
+	case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+		scan_stream_real(in, lim);
+		break;
+	case 's': case '[': {
+		size_t size = SIZE_MAX;
+		if (safe && !op->suppress && !op->alloc && !op->intern) {
+			// 预先取出缓冲区大小，收集时就不会超出
+			va_list peek;
+			va_copy(peek, *ap);
+			if (op->prec_arg) (void)va_arg(peek, int);
+			(void)va_arg(peek, char*);
+			size = va_arg(peek, size_t);
+			va_end(peek);
+			if (size == 0) size = 1;
+		}
+		scan_stream_chars(in, lim, size, op->conv == '[' ? &fmt->sets[op->set] : NULL);
+		if (in->n == 0) {
+			if (op->prec_arg) (void)va_arg(*ap, int);
+			if (!op->suppress) {
+				(void)va_arg(*ap, char*);
+				if (safe && !op->alloc && !op->intern) (void)va_arg(*ap, size_t);
+			}
+			return 0;
+		}
+		break;
+	}
+	case 'c':
+		c = scan_sgetc(in);
+		scan_tok_push(in, c);
+		if (is_gb2312_lead_byte((unsigned char)c) && (c = scan_sgetc(in)) != EOF) scan_tok_push(in, c);
+		break;
+	case '%':
+		c = scan_sgetc(in);
+		if (c != '%') {
+			scan_sungetc(in, c);
+			return 0;
+		}
+		return 1;
+	}
+	if (in->oom) return 0;
+	// 除 %n 外都至少要读到一个字符，失败由调用者记录
+	if (in->n == 0 && op->conv != 'n') return 0;
+
+	// 只含这一条指令的格式，在收集到的字符上执行
+	my_scanf_format one = *fmt;
+	one.nops = 1;
+	one.ops = op;
+	const char* tok = in->tb->data ? in->tb->data : "";
+	scan_args a = {};
+	a.ap = ap;
+	a.n_base = in->consumed - in->n;
+	a.more = 1;
+	if (!op->suppress) {
+		int r = scan_exec_ap(tok, tok + in->n, &one, &a, safe);
+		*count += r;
+		return r > 0 || op->conv == 'n';
+	}
+	// %*：不写参数，按普通转换执行到临时变量以判断是否成功
+	if (op->prec_arg) (void)va_arg(*ap, int);
+	scan_op tmp = *op;
+	tmp.suppress = 0;
+	tmp.prec_arg = 0;
+	tmp.alloc = 0;
+	tmp.intern = 0;
+	one.ops = &tmp;
+	union {
+		long double ld;
+		my_scanf_span sp;
+		void* ptr;
+		long long ll;
+		char c[2];
+	} dummy;
+	void* ptrs[1] = { &dummy };
+	a = {};
+	a.ptrs = ptrs;
+	a.spans = 1;
+	a.n_base = in->consumed - in->n;
+	a.more = 1;
+	return scan_exec_ap(tok, tok + in->n, &one, &a, 0);
+}
+
+static int scan_stream_exec(FILE* fp, const my_scanf_format* fmt, va_list args, int safe) {
+	va_list ap;
+	va_copy(ap, args);
+	scan_stream_in in = {};
+	in.fp = fp;
+	in.tb = &g_scan_token;
+	int count = 0;
+	int eof = 0;
+	int code = MY_SCANF_ERR_NONE;
+	const scan_op* op = NULL;
+	g_scan_error.code = MY_SCANF_ERR_NONE;
+
+	scan_lockfile(fp);
+	for (int k = 0; k < fmt->nops; k++) {
+		op = &fmt->ops[k];
+		if (op->kind == SCAN_OP_SPACE) {
+			scan_stream_space(&in);
+			continue;
+		}
+		if (op->kind == SCAN_OP_LITERAL) {
+			int c = scan_sgetc(&in);
+			if (c != (unsigned char)op->conv) {
+				scan_sungetc(&in, c);
+				eof = c == EOF;
+				code = MY_SCANF_ERR_LITERAL;
+				break;
+			}
+			continue;
+		}
+		// %V 输出指向输入的片段，流中读出的字符没有可以指向的缓冲区，按格式错误处理
+		if (op->kind == SCAN_OP_BAD || op->span) {
+			code = MY_SCANF_ERR_FORMAT;
+			break;
+		}
+		int r = scan_stream_conv(&in, fmt, op, &ap, safe, &count);
+		if (r <= 0) {
+			eof = r == EOF;
+			code = MY_SCANF_ERR_MATCH;
+			break;
+		}
+	}
+	scan_unlockfile(fp);
+	va_end(ap);
+	// 在收集到的字符上失败时执行器已记录了位置，其余情况在当前读取位置记录
+	if (code != MY_SCANF_ERR_NONE && g_scan_error.code == MY_SCANF_ERR_NONE) {
+		scan_error(eof ? MY_SCANF_ERR_INPUT : code, op->spec, fmt->format, fmt->format + op->fmt_off, "", "", "", in.consumed);
+	}
+	// 与 glibc 一致：还没有赋值就遇到文件结束时返回 EOF
+	return eof && count == 0 ? EOF : count;
+}
+
+static int scan_stream_cached(FILE* fp, const char* format, va_list args, int safe) {
+	if (!fp || !format) return -1;
+	scan_reader* r = scan_epoch_enter();
+	const my_scanf_format* fmt = scan_cache_get(format);
+	int count = fmt ? scan_stream_exec(fp, fmt, args, safe) : -1;
+	scan_epoch_exit(r);
+	return count;
+}
+
+// 流模式的 my_fscanf：只读取格式匹配到的字符，返回值同 fscanf（第一个转换之前遇到文件结束返回 EOF）
+int my_vfscanf_stream(FILE* fp, const char* format, va_list args) {
+	return scan_stream_cached(fp, format, args, 0);
+}
+int my_fscanf_stream(FILE* fp, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vfscanf_stream(fp, format, args);
+	va_end(args);
+	return count;
+}
+
+// 流模式的 my_fscanf_s，%s 和 %[...] 必须提供 sizeof(str)
+int my_vfscanf_stream_s(FILE* fp, const char* format, va_list args) {
+	return scan_stream_cached(fp, format, args, 1);
+}
+int my_fscanf_stream_s(FILE* fp, const char* format, ...) {
+	va_list args;
+	va_start(args, format);
+	int count = my_vfscanf_stream_s(fp, format, args);
+	va_end(args);
+	return count;
+}
+
+
+// ================= 映射文件扫描 =================
+// 普通文件整体 mmap（MADV_SEQUENTIAL），在映射中原地切分行并解析，每行解析后调用一次回调；
+// 管道、字符设备等无法映射的输入改用记录读取器。格式只编译一次。
+// 输出参数在所有行之间共用，回调从中读取本行的结果；%V 片段指向映射，只在回调内有效。
+
+// 返回非 0 时停止扫描
+typedef int (*my_scan_line_fn)(void* ctx, int count, const char* line, size_t len);
+
+static long long scan_file_reader(FILE* fp, const my_scanf_format* fmt, my_scan_line_fn callback, void* ctx, va_list args, int safe) {
+	my_scanf_reader* r = my_scanf_reader_open(fp, 0);
+	if (!r) return -1;
+	long long lines = 0;
+	const char* rec;
+	size_t len;
+	int ret;
+	while ((ret = my_scanf_reader_next(r, &rec, &len)) > 0) {
+		lines++;
+		if (callback(ctx, scan_exec(rec, rec + len, fmt, args, safe), rec, len)) break;
+	}
+	my_scanf_reader_close(r);
+	return ret < 0 ? -1 : lines;
+}
+
+#ifndef _WIN32
+// 映射成功返回处理的行数；无法映射返回 -2，由调用者改用读取器
+static long long scan_file_map(int fd, const my_scanf_format* fmt, my_scan_line_fn callback, void* ctx, va_list args, int safe) {
+	struct stat st;
+	if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) return -2;
+	if (st.st_size == 0) return 0;
+	if ((unsigned long long)st.st_size > SIZE_MAX) return -2;
+	size_t size = (size_t)st.st_size;
+	void* map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) return -2;
+#ifdef MADV_SEQUENTIAL
+	madvise(map, size, MADV_SEQUENTIAL);
+#endif
+
+	const char* p = (const char*)map;
+	const char* end = p + size;
+	long long lines = 0;
+	while (p < end) {
+		size_t n = scan_isa.find_byte(p, (size_t)(end - p), '\n');
+		const char* next = p + n + (p + n < end);
+		if (n > 0 && p[n - 1] == '\r') n--;
+		lines++;
+		if (callback(ctx, scan_exec(p, p + n, fmt, args, safe), p, n)) break;
+		p = next;
+	}
+	munmap(map, size);
+	return lines;
+}
+#endif
+
+// 返回处理的行数，打开或读取失败返回 -1
+static long long scan_file(const char* path, const char* format, my_scan_line_fn callback, void* ctx, va_list args, int safe) {
+	if (!path || !format || !callback) return -1;
+	const my_scanf_format* fmt = my_scanf_compile(format);
+	if (!fmt) return -1;
+	long long lines = -1;
+#ifndef _WIN32
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		lines = scan_file_map(fd, fmt, callback, ctx, args, safe);
+		if (lines == -2) {
+			FILE* fp = fdopen(fd, "rb");
+			if (fp) {
+				lines = scan_file_reader(fp, fmt, callback, ctx, args, safe);
+				fclose(fp);
+				fd = -1;
+			}
+			else {
+				lines = -1;
+			}
+		}
+		if (fd >= 0) close(fd);
+	}
+#else
+	FILE* fp = fopen(path, "rb");
+	if (fp) {
+		lines = scan_file_reader(fp, fmt, callback, ctx, args, safe);
+		fclose(fp);
+	}
+#endif
+	my_scanf_free(fmt);
+	return lines;
+}
+
+// 逐行解析文件 path，每行解析后调用 callback(ctx, 本行成功赋值的项数, 行, 行长度)
+long long my_scan_file_mmap(const char* path, const char* format, my_scan_line_fn callback, void* ctx, ...) {
+	va_list args;
+	va_start(args, ctx);
+	long long lines = scan_file(path, format, callback, ctx, args, 0);
+	va_end(args);
+	return lines;
+}
+
+// 同 my_scan_file_mmap，%s 和 %[...] 必须提供 sizeof(str)
+long long my_scan_file_mmap_s(const char* path, const char* format, my_scan_line_fn callback, void* ctx, ...) {
+	va_list args;
+	va_start(args, ctx);
+	long long lines = scan_file(path, format, callback, ctx, args, 1);
+	va_end(args);
+	return lines;
+}
+
+
+// ================= 并行扫描 =================
+// my_scan_file_parallel 把映射的文件在换行处切成段，由固定数量的线程解析。
+// 无序模式默认用工作窃取调度：每个线程从自己的一段开始，不断把剩余部分对半拆分，后一半放进自己的
+// Chase-Lev 双端队列；空闲线程从其他线程的队列顶部窃取最大的一段。记录长短悬殊（例如 40 字节的心跳行
+// 和 8KB 的堆栈行混在一起）时，各线程仍几乎同时结束。有序模式按固定大小的块依次领取。
+// 格式只编译一次，各线程共用只读的编译结果；每个线程开始时按字段布局准备好自己的输出区，
+// 之后逐行解析既不分配内存也不经过可变参数。
+// 回调收到本行各字段的地址 fields[i]，类型与 my_sscanf 的参数相同（%d 为 int，%lf 为 double 等），
+// %s 和 %[...] 与 %V 一样输出 my_scanf_span，%c 为 char[2]。
+
+// 返回非 0 时停止扫描；worker 为调用回调的线程编号
+typedef int (*my_scan_fields_fn)(void* ctx, int worker, int count, void* const* fields, const char* line, size_t len);
+
+// 单个线程的统计
+typedef struct my_scan_thread_stats {
+	unsigned long long lines;  // 解析的行数
+	unsigned long long bytes;  // 解析的字节数
+	unsigned long long chunks; // 领取的块数
+	double seconds;            // 线程运行时间
+	double mb_per_sec;         // bytes / seconds，单位 MB/s
+	unsigned long long steals; // 从其他线程窃取的段数
+} my_scan_thread_stats;
+
+// 任务划分方式
+enum {
+	MY_SCAN_SCHED_AUTO,    // 无序模式用 MY_SCAN_SCHED_STEAL，有序模式用 MY_SCAN_SCHED_CHUNKED
+	MY_SCAN_SCHED_STEAL,   // 工作窃取，chunk_size 为不再拆分的最小段（默认 256KB）；有序模式下同 CHUNKED
+	MY_SCAN_SCHED_CHUNKED, // 切成 chunk_size 的块（默认 4MB），各线程依次领取
+	MY_SCAN_SCHED_STATIC,  // 平均切成 threads 段，每个线程一段
+};
+
+typedef struct my_scan_parallel_opts {
+	int threads;                 // 线程数，0 表示 CPU 核数
+	int ordered;                 // 非 0：回调按输入顺序逐行调用，不会并发；0：各线程并发回调，吞吐最高
+	size_t chunk_size;           // 每块字节数，0 表示默认值，见 MY_SCAN_SCHED_*
+	my_scan_thread_stats* stats; // 可选，写入前 nstats 个线程的统计
+	int nstats;
+	int schedule;                // MY_SCAN_SCHED_*
+} my_scan_parallel_opts;
+
+#define SCAN_CHUNK_DEFAULT_SIZE (4 * 1024 * 1024)
+#define SCAN_STEAL_GRAIN (256 * 1024)
+#define SCAN_DEQUE_CAP 64
+
+// 有序模式下每行解析结果的头部，字段区紧随其后
+typedef struct scan_row_head {
+	const char* line;
+	size_t len;
+	int count;
+} scan_row_head;
+
+// 有序模式下一块的解析结果，等待按顺序回调
+typedef struct scan_chunk_rows {
+	char* data;
+	size_t nrows;
+	size_t cap;  // 可容纳的行数
+	int done;    // 已解析完，等待回调
+} scan_chunk_rows;
+
+// Chase-Lev 工作窃取双端队列，元素是待解析的段 [begin, end)。
+// 所有者在底部放入和取出，其他线程从顶部窃取。每次放入的段不超过上一段的一半，容量固定即可
+typedef struct scan_deque {
+	std::atomic<long long> top;
+	char pad[64 - sizeof(std::atomic<long long>)];
+	std::atomic<long long> bottom;
+	std::atomic<size_t> begin[SCAN_DEQUE_CAP];
+	std::atomic<size_t> end[SCAN_DEQUE_CAP];
+} scan_deque;
+
+// 所有者放入一段，队列已满返回 0
+static int scan_deque_push(scan_deque* q, size_t begin, size_t end) {
+	long long b = q->bottom.load(std::memory_order_relaxed);
+	long long t = q->top.load(std::memory_order_acquire);
+	if (b - t >= SCAN_DEQUE_CAP) return 0;
+	q->begin[b % SCAN_DEQUE_CAP].store(begin, std::memory_order_relaxed);
+	q->end[b % SCAN_DEQUE_CAP].store(end, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+	q->bottom.store(b + 1, std::memory_order_relaxed);
+	return 1;
+}
+
+// 所有者取出最近放入的一段
+static int scan_deque_take(scan_deque* q, size_t* begin, size_t* end) {
+	long long b = q->bottom.load(std::memory_order_relaxed) - 1;
+	q->bottom.store(b, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long t = q->top.load(std::memory_order_relaxed);
+	if (t > b) {
+		q->bottom.store(b + 1, std::memory_order_relaxed);
+		return 0;
+	}
+	*begin = q->begin[b % SCAN_DEQUE_CAP].load(std::memory_order_relaxed);
+	*end = q->end[b % SCAN_DEQUE_CAP].load(std::memory_order_relaxed);
+	if (t == b) {
+		// 最后一个元素，与窃取者竞争
+		bool won = q->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+		q->bottom.store(b + 1, std::memory_order_relaxed);
+		return won;
+	}
+	return 1;
+}
+
+// 其他线程窃取最早放入（最大）的一段；队列为空或竞争失败返回 0
+static int scan_deque_steal(scan_deque* q, size_t* begin, size_t* end) {
+	long long t = q->top.load(std::memory_order_acquire);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	long long b = q->bottom.load(std::memory_order_acquire);
+	if (t >= b) return 0;
+	*begin = q->begin[t % SCAN_DEQUE_CAP].load(std::memory_order_relaxed);
+	*end = q->end[t % SCAN_DEQUE_CAP].load(std::memory_order_relaxed);
+	return q->top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+}
+
+typedef struct scan_par {
+	const char* base;
+	size_t size;
+	size_t chunk;
+	size_t nchunks;
+	const my_scanf_format* fmt;
+	int nfields;
+	const size_t* field_off; // 字段在行内的偏移（有序模式含行头）
+	size_t row_size;
+	my_scan_fields_fn callback;
+	void* ctx;
+	int ordered;
+	std::atomic<size_t> next;     // 下一个待领取的块
+	std::atomic<bool> stop;
+	std::atomic<long long> lines; // 已回调的行数
+	// 有序模式：块 k 解析到 slots[k % window]，由当前的回调线程按块号依次回调
+	std::mutex mu;
+	std::condition_variable cv;
+	size_t emit;                  // 下一个待回调的块
+	int emitting;
+	size_t window;
+	scan_chunk_rows* slots;
+	// 工作窃取
+	int threads;
+	size_t grain;                 // 不再拆分的最小段
+	scan_deque* deques;           // 每个线程一个
+	std::atomic<size_t> remaining; // 还没有解析完的字节数
+} scan_par;
+
+// pos 之后、lim 之前的第一个行首（pos - 1 处是换行时就是 pos），没有时返回 lim
+static size_t scan_line_start(const scan_par* sp, size_t pos, size_t lim) {
+	if (pos == 0) return 0;
+	if (pos >= lim) return lim;
+	size_t n = lim - pos + 1;
+	size_t i = scan_isa.find_byte(sp->base + pos - 1, n, '\n');
+	return i == n ? lim : pos + i;
+}
+
+// 块 k 从 k * chunk 之后的第一个行首开始，相邻两块用同一规则，边界一致
+static size_t scan_chunk_start(const scan_par* sp, size_t k) {
+	if (k * sp->chunk >= sp->size) return sp->size;
+	return scan_line_start(sp, k * sp->chunk, sp->size);
+}
+
+// 无序模式：逐行解析 [p, end) 并回调，回调要求停止（包括其他线程的回调）时返回 false。
+// 每行都检查 stop，一个回调返回非 0 后，其他线程最多再各回调一行
+static bool scan_par_lines(scan_par* sp, int worker, const char* p, const char* end, void** ptrs, my_scan_thread_stats* st) {
+	while (p < end) {
+		if (sp->stop.load(std::memory_order_relaxed)) return false;
+		size_t n = scan_isa.find_byte(p, (size_t)(end - p), '\n');
+		const char* next = p + n + (p + n < end);
+		if (n > 0 && p[n - 1] == '\r') n--;
+		st->lines++;
+		scan_args a = {};
+		a.ptrs = ptrs;
+		a.spans = 1;
+		int count = scan_exec_ap(p, p + n, sp->fmt, &a, 0);
+		sp->lines++;
+		if (sp->callback(sp->ctx, worker, count, ptrs, p, n)) {
+			sp->stop = true;
+			return false;
+		}
+		p = next;
+	}
+	return true;
+}
+
+// 回调一块已解析的行（有序模式）
+static void scan_par_emit(scan_par* sp, const scan_chunk_rows* rows, int worker, void** fields) {
+	for (size_t r = 0; r < rows->nrows; r++) {
+		char* row = rows->data + r * sp->row_size;
+		const scan_row_head* h = (const scan_row_head*)row;
+		for (int i = 0; i < sp->nfields; i++) fields[i] = row + sp->field_off[i];
+		sp->lines++;
+		if (sp->callback(sp->ctx, worker, h->count, fields, h->line, h->len)) {
+			sp->stop = true;
+			return;
+		}
+	}
+}
+
+static void scan_par_worker(scan_par* sp, int worker, my_scan_thread_stats* st) {
+	auto t0 = std::chrono::steady_clock::now();
+	void** ptrs = (void**)malloc((sp->nfields + 1) * sizeof(void*));
+	void** fields = (void**)malloc((sp->nfields + 1) * sizeof(void*));
+	char* row = sp->ordered ? NULL : (char*)malloc(sp->row_size);
+	if (!ptrs || !fields || (!sp->ordered && !row)) {
+		std::lock_guard<std::mutex> lock(sp->mu);
+		sp->stop = true;
+		sp->cv.notify_all();
+	}
+	else if (row) {
+		for (int i = 0; i < sp->nfields; i++) ptrs[i] = row + sp->field_off[i];
+	}
+
+	while (!sp->stop) {
+		size_t k = sp->next++;
+		if (k >= sp->nchunks) break;
+		scan_chunk_rows* rows = NULL;
+		if (sp->ordered) {
+			// 最多领先 window 块，已解析未回调的数据量有上限
+			std::unique_lock<std::mutex> lock(sp->mu);
+			sp->cv.wait(lock, [&] { return k < sp->emit + sp->window || sp->stop; });
+			if (sp->stop) break;
+			rows = &sp->slots[k % sp->window];
+			rows->nrows = 0;
+		}
+
+		const char* p = sp->base + scan_chunk_start(sp, k);
+		const char* end = sp->base + scan_chunk_start(sp, k + 1);
+		st->chunks++;
+		st->bytes += (unsigned long long)(end - p);
+		if (!rows) {
+			if (!scan_par_lines(sp, worker, p, end, ptrs, st)) break;
+			continue;
+		}
+		// 已经停止时不再解析没有线程会回调的行
+		while (p < end && !sp->stop.load(std::memory_order_relaxed)) {
+			size_t n = scan_isa.find_byte(p, (size_t)(end - p), '\n');
+			const char* next = p + n + (p + n < end);
+			if (n > 0 && p[n - 1] == '\r') n--;
+			st->lines++;
+
+			scan_args a = {};
+			a.ptrs = ptrs;
+			a.spans = 1;
+			if (rows->nrows == rows->cap) {
+				size_t cap = rows->cap ? rows->cap * 2 : 1024;
+				char* data = (char*)realloc(rows->data, cap * sp->row_size);
+				if (!data) {
+					sp->stop = true;
+					break;
+				}
+				rows->data = data;
+				rows->cap = cap;
+			}
+			char* r = rows->data + rows->nrows * sp->row_size;
+			for (int i = 0; i < sp->nfields; i++) ptrs[i] = r + sp->field_off[i];
+			scan_row_head* h = (scan_row_head*)r;
+			h->line = p;
+			h->len = n;
+			h->count = scan_exec_ap(p, p + n, sp->fmt, &a, 0);
+			rows->nrows++;
+			p = next;
+		}
+
+		std::unique_lock<std::mutex> lock(sp->mu);
+		rows->done = 1;
+		if (sp->emitting) continue;
+		// 当前没有线程在回调：由本线程把已就绪的块按顺序回调完
+		sp->emitting = 1;
+		while (!sp->stop && sp->slots[sp->emit % sp->window].done) {
+			scan_chunk_rows* ready = &sp->slots[sp->emit % sp->window];
+			lock.unlock();
+			scan_par_emit(sp, ready, worker, fields);
+			lock.lock();
+			ready->done = 0;
+			sp->emit++;
+			sp->cv.notify_all();
+		}
+		sp->emitting = 0;
+		if (sp->stop) sp->cv.notify_all();
+	}
+
+	free(row);
+	free(fields);
+	free(ptrs);
+	st->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	st->mb_per_sec = st->seconds > 0 ? st->bytes / st->seconds / 1e6 : 0;
+}
+
+// 工作窃取（无序模式）：先领取一个初始段（共 threads 段），每次把剩余部分在行首处对半拆分，后一半放入
+// 自己的队列，直到不大于 grain 才解析；自己的队列空了就从其他线程窃取，所有字节解析完后退出。
+// 初始段按领取的方式分配，个别线程没能创建时，它的一段由其他线程领取
+static void scan_par_steal_worker(scan_par* sp, int worker, my_scan_thread_stats* st) {
+	auto t0 = std::chrono::steady_clock::now();
+	void** ptrs = (void**)malloc((sp->nfields + 1) * sizeof(void*));
+	char* row = (char*)malloc(sp->row_size);
+	if (!ptrs || !row) sp->stop = true;
+	else {
+		for (int i = 0; i < sp->nfields; i++) ptrs[i] = row + sp->field_off[i];
+	}
+
+	scan_deque* dq = &sp->deques[worker];
+	size_t b = 0;
+	size_t e = 0;
+	unsigned seed = (unsigned)worker * 2654435761u + 1;
+	int idle = 0;
+	while (!sp->stop) {
+		bool have = scan_deque_take(dq, &b, &e);
+		if (!have) {
+			size_t k = sp->next++;
+			if (k < sp->nchunks) {
+				b = scan_chunk_start(sp, k);
+				e = scan_chunk_start(sp, k + 1);
+				if (b == e) continue;
+				have = true;
+			}
+		}
+		if (!have) {
+			// 从随机的线程开始依次尝试窃取
+			seed = seed * 1103515245u + 12345u;
+			int first = (int)((seed >> 16) % (unsigned)sp->threads);
+			for (int i = 0; i < sp->threads && !have; i++) {
+				int victim = (first + i) % sp->threads;
+				if (victim != worker) have = scan_deque_steal(&sp->deques[victim], &b, &e);
+			}
+			if (have) st->steals++;
+			else if (sp->remaining.load(std::memory_order_acquire) == 0) break;
+			else {
+				// 其他线程正在解析最后几段，稍后再试
+				if (++idle < 64) std::this_thread::yield();
+				else std::this_thread::sleep_for(std::chrono::microseconds(50));
+				continue;
+			}
+		}
+		idle = 0;
+		while (e - b > sp->grain) {
+			size_t mid = scan_line_start(sp, b + (e - b) / 2, e);
+			if (mid >= e || !scan_deque_push(dq, mid, e)) break;
+			e = mid;
+		}
+		st->chunks++;
+		st->bytes += e - b;
+		scan_par_lines(sp, worker, sp->base + b, sp->base + e, ptrs, st);
+		sp->remaining.fetch_sub(e - b, std::memory_order_release);
+	}
+
+	free(row);
+	free(ptrs);
+	st->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	st->mb_per_sec = st->seconds > 0 ? st->bytes / st->seconds / 1e6 : 0;
+}
+
+// 无法映射的输入：单线程读取，回调方式相同
+static long long scan_par_stream(FILE* fp, scan_par* sp, my_scan_thread_stats* st) {
+	auto t0 = std::chrono::steady_clock::now();
+	my_scanf_reader* r = my_scanf_reader_open(fp, 0);
+	void** ptrs = (void**)malloc((sp->nfields + 1) * sizeof(void*));
+	char* row = (char*)malloc(sp->row_size);
+	long long lines = -1;
+	if (r && ptrs && row) {
+		for (int i = 0; i < sp->nfields; i++) ptrs[i] = row + sp->field_off[i];
+		const char* rec;
+		size_t len;
+		int ret;
+		lines = 0;
+		while ((ret = my_scanf_reader_next(r, &rec, &len)) > 0) {
+			scan_args a = {};
+			a.ptrs = ptrs;
+			a.spans = 1;
+			int count = scan_exec_ap(rec, rec + len, sp->fmt, &a, 0);
+			lines++;
+			st->lines++;
+			st->bytes += len + 1;
+			if (sp->callback(sp->ctx, 0, count, ptrs, rec, len)) break;
+		}
+		if (ret < 0) lines = -1;
+	}
+	free(row);
+	free(ptrs);
+	my_scanf_reader_close(r);
+	st->seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+	st->mb_per_sec = st->seconds > 0 ? st->bytes / st->seconds / 1e6 : 0;
+	return lines;
+}
+
+// 在线程池上解析映射的文件，返回回调的行数
+static long long scan_par_run(scan_par* sp, int threads, int schedule, my_scan_thread_stats* stats) {
+	if (schedule == MY_SCAN_SCHED_STEAL) {
+		// 每个线程至少分到一个最小段
+		size_t most = (sp->size + sp->grain - 1) / sp->grain;
+		if ((size_t)threads > most) threads = (int)most;
+		sp->chunk = (sp->size + threads - 1) / threads;
+		sp->nchunks = (size_t)threads;
+		sp->threads = threads;
+		sp->remaining = sp->size;
+		sp->deques = new (std::nothrow) scan_deque[threads]();
+		if (!sp->deques) return -1;
+	}
+	else {
+		if (schedule == MY_SCAN_SCHED_STATIC) sp->chunk = (sp->size + threads - 1) / threads;
+		sp->nchunks = (sp->size + sp->chunk - 1) / sp->chunk;
+		if (threads > (long long)sp->nchunks) threads = (int)sp->nchunks;
+	}
+	if (sp->ordered) {
+		sp->window = (size_t)threads * 2;
+		sp->slots = (scan_chunk_rows*)calloc(sp->window, sizeof(scan_chunk_rows));
+		if (!sp->slots) return -1;
+	}
+
+	// 调用线程作为 0 号线程参与解析
+	void (*run)(scan_par*, int, my_scan_thread_stats*) = sp->deques ? scan_par_steal_worker : scan_par_worker;
+	std::vector<std::thread> pool;
+	for (int w = 1; w < threads; w++) {
+		try {
+			pool.emplace_back(run, sp, w, &stats[w]);
+		}
+		catch (...) {
+			break; // 创建线程失败时用已有的线程继续
+		}
+	}
+	run(sp, 0, &stats[0]);
+	for (std::thread& t : pool) t.join();
+	delete[] sp->deques;
+
+	if (sp->slots) {
+		for (size_t i = 0; i < sp->window; i++) free(sp->slots[i].data);
+		free(sp->slots);
+	}
+	return sp->lines;
+}
+
+// 并行逐行解析文件 path，返回回调的行数，打开或读取失败返回 -1。opts 可为 NULL（全部取默认值）
+long long my_scan_file_parallel(const char* path, const char* format, my_scan_fields_fn callback, void* ctx, const my_scan_parallel_opts* opts) {
+	if (!path || !format || !callback) return -1;
+	my_scan_parallel_opts o = {};
+	if (opts) o = *opts;
+	int threads = o.threads > 0 ? o.threads : (int)std::thread::hardware_concurrency();
+	if (threads < 1) threads = 1;
+	int schedule = o.schedule;
+	if (schedule == MY_SCAN_SCHED_AUTO || (schedule == MY_SCAN_SCHED_STEAL && o.ordered)) {
+		schedule = o.ordered ? MY_SCAN_SCHED_CHUNKED : MY_SCAN_SCHED_STEAL;
+	}
+
+	const my_scanf_format* fmt = my_scanf_compile(format);
+	if (!fmt) return -1;
+
+	// 行内布局：有序模式先放行头，各字段按自身对齐，行大小对齐到 16 字节
+	int nfields = scan_field_layout(fmt, NULL, NULL);
+	size_t* sizes = (size_t*)malloc((nfields + 1) * sizeof(size_t));
+	size_t* aligns = (size_t*)malloc((nfields + 1) * sizeof(size_t));
+	size_t* offs = (size_t*)malloc((nfields + 1) * sizeof(size_t));
+	my_scan_thread_stats* stats = (my_scan_thread_stats*)calloc(threads, sizeof(my_scan_thread_stats));
+	long long lines = -1;
+	if (!sizes || !aligns || !offs || !stats) goto done;
+	{
+		scan_field_layout(fmt, sizes, aligns);
+		size_t off = o.ordered ? sizeof(scan_row_head) : 0;
+		for (int i = 0; i < nfields; i++) {
+			off = (off + aligns[i] - 1) & ~(aligns[i] - 1);
+			offs[i] = off;
+			off += sizes[i];
+		}
+
+		scan_par sp;
+		sp.base = NULL;
+		sp.size = 0;
+		sp.chunk = o.chunk_size ? o.chunk_size : SCAN_CHUNK_DEFAULT_SIZE;
+		sp.grain = o.chunk_size ? o.chunk_size : SCAN_STEAL_GRAIN;
+		sp.nchunks = 0;
+		sp.fmt = fmt;
+		sp.nfields = nfields;
+		sp.field_off = offs;
+		sp.row_size = (off + 15) & ~(size_t)15;
+		if (sp.row_size == 0) sp.row_size = 16;
+		sp.callback = callback;
+		sp.ctx = ctx;
+		sp.ordered = o.ordered;
+		sp.next = 0;
+		sp.stop = false;
+		sp.lines = 0;
+		sp.emit = 0;
+		sp.emitting = 0;
+		sp.window = 0;
+		sp.slots = NULL;
+		sp.threads = threads;
+		sp.deques = NULL;
+
+#ifndef _WIN32
+		int fd = open(path, O_RDONLY);
+		if (fd < 0) goto done;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && (unsigned long long)st.st_size <= SIZE_MAX) {
+			if (st.st_size == 0) {
+				lines = 0;
+				close(fd);
+				goto done;
+			}
+			void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (map != MAP_FAILED) {
+				close(fd);
+#ifdef MADV_SEQUENTIAL
+				madvise(map, (size_t)st.st_size, MADV_SEQUENTIAL);
+#endif
+				sp.base = (const char*)map;
+				sp.size = (size_t)st.st_size;
+				lines = scan_par_run(&sp, threads, schedule, stats);
+				munmap(map, sp.size);
+				goto done;
+			}
+		}
+		FILE* fp = fdopen(fd, "rb");
+		if (!fp) {
+			close(fd);
+			goto done;
+		}
+#else
+		FILE* fp = fopen(path, "rb");
+		if (!fp) goto done;
+#endif
+		lines = scan_par_stream(fp, &sp, stats);
+		fclose(fp);
+	}
+
+done:
+	if (stats && o.stats) {
+		for (int i = 0; i < o.nstats; i++) {
+			if (i < threads) o.stats[i] = stats[i];
+			else memset(&o.stats[i], 0, sizeof(my_scan_thread_stats));
+		}
+	}
+	free(stats);
+	free(offs);
+	free(aligns);
+	free(sizes);
+	my_scanf_free(fmt);
+	return lines;
+}
+
+
+// ================= 列式批量解析 =================
+// my_scan_batch 用同一个预编译格式解析 n 行，第 i 个赋值字段直接写入第 i 列的第 r 个元素，
+// 没有逐行的 va_list 和逐字段的参数指针。列的元素类型与 my_sscanf 的参数类型相同，
+// %s 和 %[...] 为 my_scanf_span（指向输入行），%c 为 char[2]；my_scanf_fields 给出各列元素大小。
+
+// 返回格式中赋值字段（列）的个数，sizes 不为 NULL 时写入每列的元素大小
+int my_scanf_fields(const my_scanf_format* fmt, size_t* sizes) {
+	if (!fmt) return -1;
+	return scan_field_layout(fmt, sizes, NULL);
+}
+
+#define SCAN_COLUMN_ALIGN 64
+
+// 按格式分配 n 行的列，每列起点按缓存行（64 字节）对齐；返回列指针数组，整块用 my_scan_columns_free 释放
+void** my_scan_columns_alloc(const my_scanf_format* fmt, size_t n) {
+	if (!fmt) return NULL;
+	int ncols = scan_field_layout(fmt, NULL, NULL);
+	size_t* sizes = (size_t*)malloc((ncols + 1) * sizeof(size_t));
+	if (!sizes) return NULL;
+	scan_field_layout(fmt, sizes, NULL);
+	// 指针数组在块首，之后是各列
+	size_t total = (ncols + 1) * sizeof(void*) + SCAN_COLUMN_ALIGN;
+	for (int i = 0; i < ncols; i++) {
+		if (n > (SIZE_MAX - total) / sizes[i] - SCAN_COLUMN_ALIGN) {
+			free(sizes);
+			return NULL;
+		}
+		total += (sizes[i] * n + SCAN_COLUMN_ALIGN - 1) & ~(size_t)(SCAN_COLUMN_ALIGN - 1);
+	}
+	void** cols = (void**)malloc(total);
+	if (cols) {
+		uintptr_t q = (uintptr_t)(cols + ncols + 1);
+		q = (q + SCAN_COLUMN_ALIGN - 1) & ~(uintptr_t)(SCAN_COLUMN_ALIGN - 1);
+		for (int i = 0; i < ncols; i++) {
+			cols[i] = (void*)q;
+			q += (sizes[i] * n + SCAN_COLUMN_ALIGN - 1) & ~(size_t)(SCAN_COLUMN_ALIGN - 1);
+		}
+		cols[ncols] = NULL;
+	}
+	free(sizes);
+	return cols;
+}
+
+void my_scan_columns_free(void** cols) {
+	free(cols);
+}
+
+// 解析 lines[0..n-1]（长度为 lens[r]，lens 为 NULL 时按 '\0' 结尾），结果写入 columns。
+// valid 为 (n + 63) / 64 个字的位图，第 r 行所有字段都赋值时置位（%n 不计）；counts[r] 为第 r 行赋值的字段数；两者都可为 NULL。
+// 未赋值的字段保持原值。返回所有字段都赋值的行数，参数无效时返回 -1
+long long my_scan_batch(const my_scanf_format* fmt, const char* const* lines, const size_t* lens, size_t n,
+	void* const* columns, uint64_t* valid, int* counts) {
+	if (!fmt || (n && (!lines || !columns))) return -1;
+	int ncols = scan_field_layout(fmt, NULL, NULL);
+	size_t* strides = (size_t*)malloc((ncols + 1) * sizeof(size_t));
+	if (!strides) return -1;
+	scan_field_layout(fmt, strides, NULL);
+	if (valid) memset(valid, 0, (n + 63) / 64 * sizeof(uint64_t));
+
+	int nfull = scan_full_count(fmt);
+	long long full = 0;
+	for (size_t r = 0; r < n; r++) {
+#ifdef __GNUC__
+		if (r + 1 < n) __builtin_prefetch(lines[r + 1]);
+#endif
+		const char* line = lines[r] ? lines[r] : "";
+		size_t len = lens ? lens[r] : strlen(line);
+		scan_args a = {};
+		a.ptrs = columns;
+		a.strides = strides;
+		a.row = r;
+		a.spans = 1;
+		int count = scan_exec_ap(line, line + len, fmt, &a, 0);
+		if (counts) counts[r] = count;
+		if (count == nfull) {
+			if (valid) valid[r / 64] |= 1ULL << (r % 64);
+			full++;
+		}
+	}
+	free(strides);
+	return full;
+}
+
+
+// ================= 结构体扫描 =================
+// 模式（schema）把格式串与结构体布局绑定：每个赋值字段对应一个 {offsetof, 类型, 大小} 描述，
+// 解析时直接写入结构体成员，不经过可变参数。整数和浮点数的长度修饰符由成员大小决定，
+// %s 和 %[...] 的缓冲区大小取成员大小，不再需要额外的 sizeof 参数。
+
+// 成员类型
+enum {
+	MY_SCAN_INT,   // 整数（有符号或无符号），大小为 1、2、4 或 8 字节；用于 %d %i %u %x %n，以及 %K（4 字节）
+	MY_SCAN_FLOAT, // float、double 或 long double；用于 %f %e %g %a
+	MY_SCAN_PTR,   // void* 或 char*；用于 %p，以及 %ms %m[...]
+	MY_SCAN_STR,   // char 数组，大小即缓冲区大小；用于 %s %[...]，以及 %c（至少 2 字节）
+	MY_SCAN_SPAN,  // my_scanf_span；用于 %s %[...] %V
+};
+
+typedef struct my_scan_field {
+	size_t offset; // offsetof(结构体, 成员)
+	int type;      // MY_SCAN_*
+	size_t size;   // sizeof(成员)
+} my_scan_field;
+
+// 描述结构体 S 的成员 m
+#define MY_SCAN_FIELD(S, m, type) { offsetof(S, m), (type), sizeof(((S*)0)->m) }
+
+struct my_scan_schema {
+	const my_scanf_format* fmt; // 按成员改写过长度修饰符的编译结果
+	int nfields;
+	int nfull;                  // 全部解析成功时的返回值（不含 %n）
+	size_t* offs;
+	size_t* sizes;
+};
+
+// 按成员大小选择整数的长度修饰符，不支持的大小返回 -1
+static int scan_int_len(size_t size) {
+	if (size == 1) return SCAN_LEN_HH;
+	if (size == sizeof(short)) return SCAN_LEN_H;
+	if (size == sizeof(int)) return SCAN_LEN_NONE;
+	if (size == sizeof(long long)) return SCAN_LEN_LL;
+	return -1;
+}
+
+// 按成员大小选择浮点数的长度修饰符
+static int scan_float_len(size_t size) {
+	if (size == sizeof(float)) return SCAN_LEN_NONE;
+	if (size == sizeof(double)) return SCAN_LEN_L;
+	if (size == sizeof(long double)) return SCAN_LEN_LD;
+	return -1;
+}
+
+// 由格式串和成员描述创建模式；字段个数或类型与格式不符时返回 NULL
+const my_scan_schema* my_scan_schema_create(const char* format, const my_scan_field* fields, int nfields) {
+	if (!format || nfields < 0 || (nfields && !fields)) return NULL;
+	const my_scanf_format* fmt = my_scanf_compile(format);
+	if (!fmt) return NULL;
+	if (scan_field_layout(fmt, NULL, NULL) != nfields) {
+		my_scanf_free(fmt);
+		return NULL;
+	}
+
+	// 编译结果是本模式独占的副本，可以按成员改写
+	scan_op* ops = (scan_op*)fmt->ops;
+	int i = 0;
+	for (int k = 0; k < fmt->nops; k++) {
+		scan_op* op = &ops[k];
+		if (op->kind != SCAN_OP_CONV || op->suppress || op->conv == '%') continue;
+		const my_scan_field* fd = &fields[i++];
+		int len = -1;
+		switch (op->conv) {
+		case 'd': case 'i': case 'u': case 'x': case 'X': case 'n':
+			if (fd->type == MY_SCAN_INT) len = scan_int_len(fd->size);
+			break;
+		case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+			if (fd->type == MY_SCAN_FLOAT) len = scan_float_len(fd->size);
+			break;
+		case 'p':
+			if (fd->type == MY_SCAN_PTR && fd->size == sizeof(void*)) len = SCAN_LEN_NONE;
+			break;
+		case 's': case '[':
+			if (op->alloc) {
+				if (fd->type == MY_SCAN_PTR && fd->size == sizeof(char*)) len = SCAN_LEN_NONE;
+			}
+			else if (op->intern) {
+				if (fd->type == MY_SCAN_INT && fd->size == sizeof(uint32_t)) len = SCAN_LEN_NONE;
+			}
+			else if (fd->type == MY_SCAN_SPAN && fd->size == sizeof(my_scanf_span)) {
+				op->span = 1;
+				len = SCAN_LEN_NONE;
+			}
+			else if (fd->type == MY_SCAN_STR && fd->size > 0 && !op->span) {
+				len = SCAN_LEN_NONE;
+			}
+			break;
+		case 'c':
+			if (fd->type == MY_SCAN_STR && fd->size >= 2) len = SCAN_LEN_NONE;
+			break;
+		}
+		if (len < 0) {
+			my_scanf_free(fmt);
+			return NULL;
+		}
+		op->len_mod = (unsigned char)len;
+	}
+
+	my_scan_schema* schema = (my_scan_schema*)malloc(sizeof(my_scan_schema) + 2 * (nfields + 1) * sizeof(size_t));
+	if (!schema) {
+		my_scanf_free(fmt);
+		return NULL;
+	}
+	schema->fmt = fmt;
+	schema->nfields = nfields;
+	schema->nfull = scan_full_count(fmt);
+	schema->offs = (size_t*)(schema + 1);
+	schema->sizes = schema->offs + nfields + 1;
+	for (i = 0; i < nfields; i++) {
+		schema->offs[i] = fields[i].offset;
+		schema->sizes[i] = fields[i].size;
+	}
+	return schema;
+}
+
+void my_scan_schema_free(const my_scan_schema* schema) {
+	if (!schema) return;
+	my_scanf_free(schema->fmt);
+	free((void*)schema);
+}
+
+static int scan_into(void* obj, const my_scan_schema* schema, const char* input, const char* end) {
+	scan_args a = {};
+	a.base = (char*)obj;
+	a.offs = schema->offs;
+	a.sizes = schema->sizes;
+	return scan_exec_ap(input, end, schema->fmt, &a, 1);
+}
+
+// 解析 input，结果写入 obj 指向的结构体，返回值同 my_sscanf_s
+int my_scan_into(void* obj, const my_scan_schema* schema, const char* input) {
+	if (!obj || !schema || !input) return -1;
+	return scan_into(obj, schema, input, input + strlen(input));
+}
+
+// 同 my_scan_into，只解析 input 的前 len 个字节
+int my_scan_into_n(void* obj, const my_scan_schema* schema, const char* input, size_t len) {
+	if (!input && len == 0) input = "";
+	if (!obj || !schema || !input) return -1;
+	return scan_into(obj, schema, input, input + len);
+}
+
+// 逐行解析 lines[0..n-1]（'\0' 结尾），第 r 行写入 (char*)array + r * stride。
+// 返回所有字段都赋值的行数，参数无效时返回 -1
+long long my_scan_into_array(void* array, size_t stride, size_t n, const my_scan_schema* schema, const char* const* lines) {
+	if (!schema || (n && (!array || !lines))) return -1;
+	long long full = 0;
+	for (size_t r = 0; r < n; r++) {
+#ifdef __GNUC__
+		if (r + 1 < n) __builtin_prefetch(lines[r + 1]);
+#endif
+		const char* line = lines[r] ? lines[r] : "";
+		if (scan_into((char*)array + r * stride, schema, line, line + strlen(line)) == schema->nfull) full++;
+	}
+	return full;
+}
+
+
+// ================= 流式解析 =================
+// 管道和套接字的每次读取可能在任意位置切断记录。my_scan_stream 按片段接收输入：
+// 片段中完整的记录直接原地解析，不复制；末尾不完整的记录（可能断在字段中间、数字中间或 GB2312 双字节之间）
+// 暂存起来，下一个片段到达后补齐再解析。暂存的只有这一条未完成的记录，不会缓存整个流。
+// 解析状态在记录之间恢复，回调方式与 my_scan_file_parallel 相同（worker 总是 0）。
+
+struct my_scan_stream {
+	const my_scanf_format* fmt;
+	my_scan_fields_fn callback;
+	void* ctx;
+	int nfields;
+	size_t* offs;   // 字段在 row 中的偏移
+	void** fields;  // 各字段地址，指向 row
+	char* row;      // 字段区
+	char* pending;  // 未完成的记录
+	size_t len;
+	size_t cap;
+	long long records;
+	char sep;
+	char stopped;
+};
+
+// 创建流式解析器，format 只编译一次
+my_scan_stream* my_scan_stream_open(const char* format, my_scan_fields_fn callback, void* ctx) {
+	if (!format || !callback) return NULL;
+	const my_scanf_format* fmt = my_scanf_compile(format);
+	if (!fmt) return NULL;
+	int n = scan_field_layout(fmt, NULL, NULL);
+	my_scan_stream* s = (my_scan_stream*)calloc(1, sizeof(my_scan_stream));
+	size_t* sizes = (size_t*)malloc((n + 1) * sizeof(size_t));
+	size_t* aligns = (size_t*)malloc((n + 1) * sizeof(size_t));
+	if (s) {
+		s->offs = (size_t*)malloc((n + 1) * sizeof(size_t));
+		s->fields = (void**)malloc((n + 1) * sizeof(void*));
+	}
+	if (!s || !sizes || !aligns || !s->offs || !s->fields) {
+		if (s) {
+			free(s->fields);
+			free(s->offs);
+		}
+		free(aligns);
+		free(sizes);
+		free(s);
+		my_scanf_free(fmt);
+		return NULL;
+	}
+	scan_field_layout(fmt, sizes, aligns);
+	size_t off = 0;
+	for (int i = 0; i < n; i++) {
+		off = (off + aligns[i] - 1) & ~(aligns[i] - 1);
+		s->offs[i] = off;
+		off += sizes[i];
+	}
+	free(aligns);
+	free(sizes);
+	s->row = (char*)malloc(off ? off : 1);
+	if (!s->row) {
+		free(s->fields);
+		free(s->offs);
+		free(s);
+		my_scanf_free(fmt);
+		return NULL;
+	}
+	for (int i = 0; i < n; i++) s->fields[i] = s->row + s->offs[i];
+	s->fmt = fmt;
+	s->callback = callback;
+	s->ctx = ctx;
+	s->nfields = n;
+	s->sep = '\n';
+	return s;
+}
+
+void my_scan_stream_close(my_scan_stream* s) {
+	if (!s) return;
+	free(s->pending);
+	free(s->row);
+	free(s->fields);
+	free(s->offs);
+	my_scanf_free(s->fmt);
+	free(s);
+}
+
+// 设置记录分隔符；分隔符为 '\n' 时记录末尾的 '\r' 一并去掉
+void my_scan_stream_set_separator(my_scan_stream* s, char sep) {
+	if (s) s->sep = sep;
+}
+
+// 当前暂存的未完成记录的字节数
+size_t my_scan_stream_pending(const my_scan_stream* s) {
+	return s ? s->len : 0;
+}
+
+// 解析一条完整的记录并回调
+static void scan_stream_record(my_scan_stream* s, const char* rec, size_t len) {
+	if (s->sep == '\n' && len > 0 && rec[len - 1] == '\r') len--;
+	scan_args a = {};
+	a.ptrs = s->fields;
+	a.spans = 1;
+	int count = scan_exec_ap(rec, rec + len, s->fmt, &a, 0);
+	s->records++;
+	if (s->callback(s->ctx, 0, count, s->fields, rec, len)) s->stopped = 1;
+}
+
+static int scan_stream_append(my_scan_stream* s, const char* data, size_t n) {
+	if (s->cap - s->len < n) {
+		size_t cap = s->cap ? s->cap : 256;
+		while (cap - s->len < n) cap *= 2;
+		char* pending = (char*)realloc(s->pending, cap);
+		if (!pending) return 0;
+		s->pending = pending;
+		s->cap = cap;
+	}
+	memcpy(s->pending + s->len, data, n);
+	s->len += n;
+	return 1;
+}
+
+// 送入一个片段，返回本次完成的记录数；回调要求停止后或内存不足时返回 -1
+long long my_scan_stream_feed(my_scan_stream* s, const void* data, size_t len) {
+	if (!s || (!data && len)) return -1;
+	if (s->stopped) return -1;
+	const char* p = (const char*)data;
+	const char* end = p + len;
+	long long before = s->records;
+
+	// 先补齐上一个片段留下的记录
+	if (s->len > 0) {
+		size_t i = scan_isa.find_byte(p, len, s->sep);
+		if (!scan_stream_append(s, p, i)) return -1;
+		if (i == len) return 0;
+		scan_stream_record(s, s->pending, s->len);
+		s->len = 0;
+		p += i + 1;
+	}
+	// 片段内完整的记录原地解析
+	while (p < end && !s->stopped) {
+		size_t i = scan_isa.find_byte(p, (size_t)(end - p), s->sep);
+		if (p + i == end) {
+			if (!scan_stream_append(s, p, i)) return -1;
+			break;
+		}
+		scan_stream_record(s, p, i);
+		p += i + 1;
+	}
+	return s->records - before;
+}
+
+// 输入结束：最后一条没有分隔符的记录也解析，返回完成的记录数（0 或 1）
+long long my_scan_stream_finish(my_scan_stream* s) {
+	if (!s || s->stopped) return -1;
+	if (s->len == 0) return 0;
+	scan_stream_record(s, s->pending, s->len);
+	s->len = 0;
+	return 1;
+}
+
+
+// ================= 流水线 =================
+// my_scan_pipeline 把实时的记录流（管道、套接字、日志文件）交给三级流水线处理：
+// 读取线程按分隔符把输入切成批，按批号轮流交给 N 个解析线程；解析线程逐条解析后交给回调线程（调用者），
+// 回调线程再按批号轮流从各解析线程取回结果，因此回调顺序与输入顺序一致，无需重排。
+// 各级之间都是单生产者单消费者的无锁环形队列，每批一次原子操作。批的总数固定，
+// 回调线程用完的批经空闲队列还给读取线程；所有批都在途时读取线程停止读取，背压一直传到输入端。
+
+#define SCAN_PIPE_BATCH_SIZE (64 * 1024)
+#define SCAN_PIPE_SPIN 256
+
+// 流水线统计
+typedef struct my_scan_pipeline_stats {
+	unsigned long long records;       // 回调的记录数
+	unsigned long long bytes;         // 读取的字节数
+	unsigned long long batches;       // 批数
+	unsigned long long reader_stalls; // 读取线程等待空闲批的次数（背压）
+	unsigned long long parse_stalls;  // 解析线程等待输入的次数（各线程合计）
+	unsigned long long sink_stalls;   // 回调线程等待解析结果的次数
+	double parse_queue_avg;           // 交给解析线程时其队列中的平均批数
+	double sink_queue_avg;            // 交给回调线程时其队列中的平均批数
+	size_t parse_queue_max;
+	size_t sink_queue_max;
+} my_scan_pipeline_stats;
+
+typedef struct my_scan_pipeline_opts {
+	int workers;       // 解析线程数，0 表示 CPU 核数
+	int batches;       // 在途批数上限，0 表示 workers * 4；内存约为 batches * batch_size
+	size_t batch_size; // 每批的字节数，0 表示 64KB；记录比批长时该批按需扩大
+	char separator;    // 记录分隔符，0 表示 '\n'
+	my_scan_pipeline_stats* stats; // 可选
+} my_scan_pipeline_opts;
+
+// 一批记录及其解析结果
+typedef struct scan_batch {
+	char* data;   // 记录，以分隔符隔开
+	size_t len;
+	size_t cap;
+	char* rows;   // 解析结果，每行 scan_row_head 加字段区
+	size_t nrows;
+	size_t rows_cap;
+} scan_batch;
+
+// 单生产者单消费者环形队列，容量不小于在途批数，生产者不会等待；
+// 消费者在队列空时先自旋，再登记后在条件变量上等待
+typedef struct scan_spsc {
+	std::atomic<size_t> head; // 消费者已取出的个数
+	char pad0[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> tail; // 生产者已放入的个数
+	char pad1[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<int> sleeping;
+	size_t mask;
+	scan_batch** slots;
+	std::mutex mu;
+	std::condition_variable cv;
+	// 统计：生产者写 depth_*，消费者写 stalls
+	unsigned long long pushes;
+	unsigned long long depth_sum;
+	size_t depth_max;
+	unsigned long long stalls;
+} scan_spsc;
+
+static void scan_spsc_push(scan_spsc* q, scan_batch* b) {
+	size_t t = q->tail.load(std::memory_order_relaxed);
+	size_t depth = t - q->head.load(std::memory_order_relaxed);
+	q->pushes++;
+	q->depth_sum += depth;
+	if (depth > q->depth_max) q->depth_max = depth;
+	q->slots[t & q->mask] = b;
+	q->tail.store(t + 1, std::memory_order_release);
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	if (q->sleeping.load(std::memory_order_relaxed)) {
+		std::lock_guard<std::mutex> lock(q->mu);
+		q->cv.notify_one();
+	}
+}
+
+static scan_batch* scan_spsc_pop(scan_spsc* q) {
+	size_t h = q->head.load(std::memory_order_relaxed);
+	for (int i = 0; q->tail.load(std::memory_order_acquire) == h; i++) {
+		if (i < SCAN_PIPE_SPIN) {
+#ifdef SCAN_X86
+			_mm_pause();
+#endif
+			continue;
+		}
+		q->stalls++;
+		std::unique_lock<std::mutex> lock(q->mu);
+		q->sleeping.store(1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		while (q->tail.load(std::memory_order_acquire) == h) q->cv.wait(lock);
+		q->sleeping.store(0, std::memory_order_relaxed);
+		break;
+	}
+	scan_batch* b = q->slots[h & q->mask];
+	q->head.store(h + 1, std::memory_order_release);
+	return b;
+}
+
+typedef struct scan_pipe {
+	int fd;
+	const my_scanf_format* fmt;
+	int nfields;
+	const size_t* field_off; // 字段在行内的偏移（含行头）
+	size_t row_size;
+	int workers;
+	size_t nbatches;
+	size_t batch_size;
+	char sep;
+	scan_spsc free_q;  // 回调线程 -> 读取线程
+	scan_spsc* in_q;   // 读取线程 -> 解析线程 i
+	scan_spsc* out_q;  // 解析线程 i -> 回调线程
+	std::atomic<bool> stop;
+	std::atomic<bool> err;
+	unsigned long long bytes;   // 读取线程写
+	unsigned long long batches;
+} scan_pipe;
+
+// 读取最多 n 字节；可中断的输入上每 100ms 检查一次是否停止。返回读到的字节数，0 为输入结束，-1 为出错或已停止
+static long long scan_pipe_read(scan_pipe* pp, char* buf, size_t n) {
+	for (;;) {
+		if (pp->stop.load(std::memory_order_relaxed)) return -1;
+#ifndef _WIN32
+		struct pollfd pfd = { pp->fd, POLLIN, 0 };
+		int ready = poll(&pfd, 1, 100);
+		if (ready == 0 || (ready < 0 && errno == EINTR)) continue;
+		ssize_t got = read(pp->fd, buf, n);
+		if (got < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
+#else
+		int got = _read(pp->fd, buf, n > INT_MAX ? INT_MAX : (unsigned)n);
+#endif
+		if (got < 0) pp->err = true;
+		return got < 0 ? -1 : (long long)got;
+	}
+}
+
+// 确保批的缓冲区还能放下 n 字节
+static int scan_batch_reserve(scan_batch* b, size_t n) {
+	if (b->cap - b->len >= n) return 1;
+	size_t cap = b->cap;
+	while (cap - b->len < n) cap *= 2;
+	char* data = (char*)realloc(b->data, cap);
+	if (!data) return 0;
+	b->data = data;
+	b->cap = cap;
+	return 1;
+}
+
+// 读取线程：每批装入整数条记录，末尾不完整的记录移到下一批。
+// 每次读取后只要有完整的记录就交出：输入来得快时一次读满一批，来得慢时读到多少交多少，兼顾吞吐和延迟
+static void scan_pipe_reader(scan_pipe* pp) {
+	size_t seq = 0;
+	scan_batch* b = NULL;
+	char* carry = NULL;
+	size_t carry_len = 0;
+	size_t carry_cap = 0;
+	for (;;) {
+		if (!b) {
+			b = scan_spsc_pop(&pp->free_q);
+			b->len = 0;
+			if (carry_len > 0) {
+				if (!scan_batch_reserve(b, carry_len)) {
+					pp->err = true;
+					break;
+				}
+				memcpy(b->data, carry, carry_len);
+				b->len = carry_len;
+				carry_len = 0;
+			}
+		}
+		// 一条记录比批长时扩大本批
+		if (b->len == b->cap && !scan_batch_reserve(b, b->cap)) {
+			pp->err = true;
+			break;
+		}
+		size_t want = b->cap - b->len;
+		long long got = scan_pipe_read(pp, b->data + b->len, want);
+		if (got < 0) break;
+		pp->bytes += (unsigned long long)got;
+		b->len += (size_t)got;
+		if (got == 0) {
+			// 输入结束，最后一条记录可以没有分隔符
+			if (b->len > 0) {
+				pp->batches++;
+				scan_spsc_push(&pp->in_q[seq++ % pp->workers], b);
+				b = NULL;
+			}
+			break;
+		}
+		// 从末尾找最后一个分隔符，之后的字节留给下一批；还没有完整的记录时继续读
+		size_t last = b->len;
+		while (last > 0 && b->data[last - 1] != pp->sep) last--;
+		if (last == 0) continue;
+		size_t rest = b->len - last;
+		if (rest > 0) {
+			if (carry_cap < rest) {
+				char* c = (char*)realloc(carry, rest);
+				if (!c) {
+					pp->err = true;
+					break;
+				}
+				carry = c;
+				carry_cap = rest;
+			}
+			memcpy(carry, b->data + last, rest);
+			carry_len = rest;
+			b->len = last;
+		}
+		pp->batches++;
+		scan_spsc_push(&pp->in_q[seq++ % pp->workers], b);
+		b = NULL;
+	}
+	free(carry);
+	// 每个解析线程收到一个 NULL 后退出；回调线程按批号轮到 NULL 时结束
+	for (int w = 0; w < pp->workers; w++) scan_spsc_push(&pp->in_q[seq++ % pp->workers], NULL);
+}
+
+static void scan_pipe_worker(scan_pipe* pp, int worker) {
+	scan_spsc* in = &pp->in_q[worker];
+	scan_spsc* out = &pp->out_q[worker];
+	void** ptrs = (void**)malloc((pp->nfields + 1) * sizeof(void*));
+	if (!ptrs) {
+		pp->err = true;
+		pp->stop = true;
+	}
+	for (;;) {
+		scan_batch* b = scan_spsc_pop(in);
+		if (b && ptrs && !pp->stop.load(std::memory_order_relaxed)) {
+			b->nrows = 0;
+			const char* p = b->data;
+			const char* end = p + b->len;
+			while (p < end) {
+				size_t n = scan_isa.find_byte(p, (size_t)(end - p), pp->sep);
+				const char* next = p + n + (p + n < end);
+				if (n > 0 && p[n - 1] == '\r') n--;
+				if (b->nrows == b->rows_cap) {
+					size_t cap = b->rows_cap ? b->rows_cap * 2 : 1024;
+					char* rows = (char*)realloc(b->rows, cap * pp->row_size);
+					if (!rows) {
+						pp->err = true;
+						pp->stop = true;
+						break;
+					}
+					b->rows = rows;
+					b->rows_cap = cap;
+				}
+				char* r = b->rows + b->nrows * pp->row_size;
+				for (int i = 0; i < pp->nfields; i++) ptrs[i] = r + pp->field_off[i];
+				scan_row_head* h = (scan_row_head*)r;
+				h->line = p;
+				h->len = n;
+				scan_args a = {};
+				a.ptrs = ptrs;
+				a.spans = 1;
+				h->count = scan_exec_ap(p, p + n, pp->fmt, &a, 0);
+				b->nrows++;
+				p = next;
+			}
+		}
+		else if (b) {
+			b->nrows = 0;
+		}
+		scan_spsc_push(out, b);
+		if (!b) break;
+	}
+	free(ptrs);
+}
+
+static int scan_spsc_init(scan_spsc* q, size_t n) {
+	size_t cap = 1;
+	while (cap < n) cap *= 2;
+	q->slots = (scan_batch**)calloc(cap, sizeof(scan_batch*));
+	q->mask = cap - 1;
+	return q->slots != NULL;
+}
+
+// 在 fd 上运行流水线直到输入结束或回调返回非 0，返回回调的记录数，读取出错或内存不足返回 -1。
+// 回调都在调用线程中按输入顺序调用（worker 总是 0），字段和 line 在回调返回前有效。
+// 回调要求停止后，管道和套接字上最多 100ms 内结束；opts 可为 NULL（全部取默认值）
+long long my_scan_pipeline(int fd, const char* format, my_scan_fields_fn callback, void* ctx, const my_scan_pipeline_opts* opts) {
+	if (fd < 0 || !format || !callback) return -1;
+	my_scan_pipeline_opts o = {};
+	if (opts) o = *opts;
+	int workers = o.workers > 0 ? o.workers : (int)std::thread::hardware_concurrency();
+	if (workers < 1) workers = 1;
+	size_t nbatches = o.batches > 0 ? (size_t)o.batches : (size_t)workers * 4;
+
+	const my_scanf_format* fmt = my_scanf_compile(format);
+	if (!fmt) return -1;
+
+	// 行内布局同 my_scan_file_parallel 的有序模式：行头之后各字段按自身对齐，行大小对齐到 16 字节
+	int nfields = scan_field_layout(fmt, NULL, NULL);
+	size_t* sizes = (size_t*)malloc((nfields + 1) * sizeof(size_t));
+	size_t* aligns = (size_t*)malloc((nfields + 1) * sizeof(size_t));
+	size_t* offs = (size_t*)malloc((nfields + 1) * sizeof(size_t));
+	void** fields = (void**)malloc((nfields + 1) * sizeof(void*));
+	scan_pipe* pp = new (std::nothrow) scan_pipe();
+	scan_batch* pool = (scan_batch*)calloc(nbatches, sizeof(scan_batch));
+	std::vector<std::thread> threads;
+	long long records = -1;
+	bool ok = sizes && aligns && offs && fields && pp && pool;
+	if (ok) {
+		scan_field_layout(fmt, sizes, aligns);
+		size_t off = sizeof(scan_row_head);
+		for (int i = 0; i < nfields; i++) {
+			off = (off + aligns[i] - 1) & ~(aligns[i] - 1);
+			offs[i] = off;
+			off += sizes[i];
+		}
+		pp->fd = fd;
+		pp->fmt = fmt;
+		pp->nfields = nfields;
+		pp->field_off = offs;
+		pp->row_size = (off + 15) & ~(size_t)15;
+		pp->workers = workers;
+		pp->nbatches = nbatches;
+		pp->batch_size = o.batch_size ? o.batch_size : SCAN_PIPE_BATCH_SIZE;
+		pp->sep = o.separator ? o.separator : '\n';
+		pp->in_q = new (std::nothrow) scan_spsc[workers]();
+		pp->out_q = new (std::nothrow) scan_spsc[workers]();
+		ok = pp->in_q && pp->out_q && scan_spsc_init(&pp->free_q, nbatches);
+		// 每个队列最多容纳全部的批和一个结束标记
+		for (int w = 0; ok && w < workers; w++) {
+			ok = scan_spsc_init(&pp->in_q[w], nbatches + 1) && scan_spsc_init(&pp->out_q[w], nbatches + 1);
+		}
+		for (size_t i = 0; ok && i < nbatches; i++) {
+			pool[i].data = (char*)malloc(pp->batch_size);
+			pool[i].cap = pp->batch_size;
+			ok = pool[i].data != NULL;
+			if (ok) scan_spsc_push(&pp->free_q, &pool[i]);
+		}
+	}
+	if (ok) {
+		try {
+			for (int w = 0; w < workers; w++) threads.emplace_back(scan_pipe_worker, pp, w);
+			threads.emplace_back(scan_pipe_reader, pp);
+		}
+		catch (...) {
+			ok = false;
+		}
+		if (!ok) {
+			// 已启动的解析线程各需一个结束标记
+			for (size_t w = 0; w < threads.size(); w++) scan_spsc_push(&pp->in_q[w], NULL);
+		}
+	}
+	if (ok) {
+		// 回调线程：按批号轮流从各解析线程取结果
+		records = 0;
+		for (size_t seq = 0;; seq++) {
+			scan_batch* b = scan_spsc_pop(&pp->out_q[seq % workers]);
+			if (!b) break;
+			for (size_t r = 0; r < b->nrows && !pp->stop.load(std::memory_order_relaxed); r++) {
+				char* row = b->rows + r * pp->row_size;
+				const scan_row_head* h = (const scan_row_head*)row;
+				for (int i = 0; i < nfields; i++) fields[i] = row + offs[i];
+				records++;
+				if (callback(ctx, 0, h->count, fields, h->line, h->len)) pp->stop = true;
+			}
+			scan_spsc_push(&pp->free_q, b);
+		}
+	}
+	for (std::thread& t : threads) t.join();
+	if (pp && pp->err) records = -1;
+
+	if (pp && o.stats) {
+		my_scan_pipeline_stats* st = o.stats;
+		memset(st, 0, sizeof(*st));
+		st->records = records > 0 ? (unsigned long long)records : 0;
+		st->bytes = pp->bytes;
+		st->batches = pp->batches;
+		st->reader_stalls = pp->free_q.stalls;
+		unsigned long long in_pushes = 0, in_sum = 0, out_pushes = 0, out_sum = 0;
+		for (int w = 0; w < workers && pp->in_q && pp->out_q; w++) {
+			st->parse_stalls += pp->in_q[w].stalls;
+			st->sink_stalls += pp->out_q[w].stalls;
+			in_pushes += pp->in_q[w].pushes;
+			in_sum += pp->in_q[w].depth_sum;
+			out_pushes += pp->out_q[w].pushes;
+			out_sum += pp->out_q[w].depth_sum;
+			if (pp->in_q[w].depth_max > st->parse_queue_max) st->parse_queue_max = pp->in_q[w].depth_max;
+			if (pp->out_q[w].depth_max > st->sink_queue_max) st->sink_queue_max = pp->out_q[w].depth_max;
+		}
+		st->parse_queue_avg = in_pushes ? (double)in_sum / in_pushes : 0;
+		st->sink_queue_avg = out_pushes ? (double)out_sum / out_pushes : 0;
+	}
+
+	if (pp) {
+		for (int w = 0; w < workers; w++) {
+			if (pp->in_q) free(pp->in_q[w].slots);
+			if (pp->out_q) free(pp->out_q[w].slots);
+		}
+		delete[] pp->in_q;
+		delete[] pp->out_q;
+		free(pp->free_q.slots);
+	}
+	for (size_t i = 0; pool && i < nbatches; i++) {
+		free(pool[i].data);
+		free(pool[i].rows);
+	}
+	free(pool);
+	delete pp;
+	free(fields);
+	free(offs);
+	free(aligns);
+	free(sizes);
+	my_scanf_free(fmt);
+	return records;
+}
+
+
+#if __cplusplus >= 202002L
+// ================= 编译期格式 scan<"fmt"> =================
+// 格式串作为模板参数，在编译期由 scan_compile_pass 解析，并逐个检查参数类型与说明符是否匹配。
+// 每个格式实例化为一段直线代码，执行时既不解析格式，也不经过 va_arg。
+// %s 和 %[...] 接受 char[N]（缓冲区大小取 N，语义同 my_sscanf_s）或 std::string，
+// %ms 和 %m[...] 需要 char*，%K 和 %K[...] 需要 uint32_t，%c 需要 char[N]（N >= 2，可能写入 GB2312 双字节字符）。
+//
+//   int id; char key[32]; std::string value;
+//   int n = scan<"%d %[^=] %s">(line, id, key, value);
+
+// 可作为模板参数的格式串
+template <size_t N>
+struct scan_fmt {
+	char s[N];
+	constexpr scan_fmt(const char (&str)[N]) {
+		for (size_t i = 0; i < N; i++) s[i] = str[i];
+	}
+};
+
+// 编译期指令表
+template <scan_fmt F>
+struct scan_program {
+	static constexpr int count(int want_sets) {
+		int ns = 0;
+		int n = scan_compile_pass(F.s, nullptr, nullptr, &ns);
+		return want_sets ? ns : n;
+	}
+	static constexpr int nops = count(0);
+	static constexpr int nsets = count(1);
+
+	struct tables {
+		scan_op ops[nops > 0 ? nops : 1];
+		scan_charset sets[nsets > 0 ? nsets : 1];
+		int arg[nops > 0 ? nops : 1];          // 指令写入的参数下标，-1 表示不取参数
+		int prec[nops > 0 ? nops : 1];         // .* 精度对应的参数下标，-1 表示没有
+		bool star_before[nops > 0 ? nops : 1]; // 执行该指令前是否已经出现过 %*
+		int nargs;
+		bool bad;                              // 格式非法
+	};
+
+	static constexpr tables build() {
+		tables t = {};
+		int ns = 0;
+		scan_compile_pass(F.s, t.ops, t.sets, &ns);
+		int a = 0;
+		bool star = false;
+		for (int k = 0; k < nops; k++) {
+			const scan_op& op = t.ops[k];
+			t.star_before[k] = star;
+			t.arg[k] = -1;
+			t.prec[k] = -1;
+			if (op.kind == SCAN_OP_BAD) t.bad = true;
+			if (op.kind != SCAN_OP_CONV) continue;
+			if (op.suppress) star = true;
+			if (op.prec_arg) t.prec[k] = a++;
+			if (!op.suppress && op.conv != '%') t.arg[k] = a++;
+		}
+		t.nargs = a;
+		return t;
+	}
+	static constexpr tables t = build();
+};
+
+template <class T> struct scan_is_char_array : std::false_type {};
+template <size_t N> struct scan_is_char_array<char[N]> : std::true_type {};
+
+// 说明符 conv（长度修饰符 len）能否写入类型 T
+template <char conv, unsigned char len, bool span, bool alloc, bool intern, class T>
+constexpr bool scan_arg_ok() {
+	if constexpr (alloc) {
+		return std::is_same_v<T, char*>;
+	}
+	else if constexpr (intern) {
+		return std::is_same_v<T, uint32_t>;
+	}
+	else if constexpr (span) {
+		return std::is_same_v<T, my_scanf_span> || std::is_same_v<T, std::string_view>;
+	}
+	else if constexpr (conv == 'd' || conv == 'i') {
+		switch (len) {
+		case SCAN_LEN_HH: return std::is_same_v<T, signed char>;
+		case SCAN_LEN_H: return std::is_same_v<T, short>;
+		case SCAN_LEN_L: return std::is_same_v<T, long>;
+		case SCAN_LEN_LL: return std::is_same_v<T, long long>;
+		case SCAN_LEN_I64: return std::is_same_v<T, int64_t>;
+		case SCAN_LEN_Z: return std::is_same_v<T, ptrdiff_t>;
+		default: return std::is_same_v<T, int>;
+		}
+	}
+	else if constexpr (conv == 'u' || conv == 'x' || conv == 'X') {
+		switch (len) {
+		case SCAN_LEN_HH: return std::is_same_v<T, unsigned char>;
+		case SCAN_LEN_H: return std::is_same_v<T, unsigned short>;
+		case SCAN_LEN_L: return std::is_same_v<T, unsigned long>;
+		case SCAN_LEN_LL: return std::is_same_v<T, unsigned long long>;
+		case SCAN_LEN_I64: return std::is_same_v<T, uint64_t>;
+		case SCAN_LEN_Z: return std::is_same_v<T, size_t>;
+		default: return std::is_same_v<T, unsigned int>;
+		}
+	}
+	else if constexpr (scan_is_float_conv(conv)) {
+		switch (len) {
+		case SCAN_LEN_L: return std::is_same_v<T, double>;
+		case SCAN_LEN_LD: return std::is_same_v<T, long double>;
+		default: return std::is_same_v<T, float>;
+		}
+	}
+	else if constexpr (conv == 'p') {
+		return std::is_same_v<T, void*>;
+	}
+	else if constexpr (conv == 's' || conv == '[') {
+		return scan_is_char_array<T>::value || std::is_same_v<T, std::string>;
+	}
+	else if constexpr (conv == 'c') {
+		return scan_is_char_array<T>::value && sizeof(T) >= 2;
+	}
+	else if constexpr (conv == 'n') {
+		switch (len) {
+		case SCAN_LEN_HH: return std::is_same_v<T, signed char>;
+		case SCAN_LEN_H: return std::is_same_v<T, short>;
+		case SCAN_LEN_L: return std::is_same_v<T, long>;
+		case SCAN_LEN_LL: return std::is_same_v<T, long long>;
+		case SCAN_LEN_I64: return std::is_same_v<T, int64_t>;
+		case SCAN_LEN_Z: return std::is_same_v<T, size_t>;
+		default: return std::is_same_v<T, int>;
+		}
+	}
+	else {
+		return false;
+	}
+}
+
+template <scan_fmt F, class Tuple, int K>
+constexpr void scan_check_arg() {
+	using P = scan_program<F>;
+	constexpr int a = P::t.arg[K];
+	constexpr int pr = P::t.prec[K];
+	if constexpr (pr >= 0) {
+		static_assert(std::is_integral_v<std::remove_cvref_t<std::tuple_element_t<pr, Tuple>>>,
+			"scan<>: .* 精度参数必须是整数");
+	}
+	if constexpr (a >= 0) {
+		using A = std::tuple_element_t<a, Tuple>;
+		static_assert(std::is_lvalue_reference_v<A> && !std::is_const_v<std::remove_reference_t<A>>,
+			"scan<>: 输出参数必须是可写的左值");
+		static_assert(scan_arg_ok<P::t.ops[K].conv, P::t.ops[K].len_mod, (bool)P::t.ops[K].span,
+			(bool)P::t.ops[K].alloc, (bool)P::t.ops[K].intern, std::remove_cvref_t<A>>(),
+			"scan<>: 参数类型与说明符不匹配");
+	}
+}
+
+template <scan_fmt F, class Tuple, size_t... K>
+constexpr void scan_check_args(std::index_sequence<K...>) {
+	(scan_check_arg<F, Tuple, (int)K>(), ...);
+}
+
+// %V 的输出：my_scanf_span 或 std::string_view
+template <class T>
+inline void scan_store_span(T& out, const char* p, size_t n) {
+	if constexpr (std::is_same_v<T, std::string_view>) {
+		out = std::string_view(p, n);
+	}
+	else {
+		out.ptr = p;
+		out.len = n;
+	}
+}
+
+typedef struct scan_state {
+	const char* input; // 输入开头，用于 %n 和错误报告
+	const char* p;     // 当前位置
+	const char* end;   // 输入结尾
+	int count;         // 成功赋值的参数个数
+} scan_state;
+
+template <scan_fmt F, int K>
+inline bool scan_fail(const scan_state& st, int code = MY_SCANF_ERR_MATCH) {
+	constexpr scan_op op = scan_program<F>::t.ops[K];
+	if (st.p >= st.end && (code == MY_SCANF_ERR_MATCH || code == MY_SCANF_ERR_LITERAL)) code = MY_SCANF_ERR_INPUT;
+	scan_error(code, op.spec, F.s, F.s + op.fmt_off, st.input, st.end, st.p, 0);
+	return false;
+}
+
+// 执行第 K 条指令，返回是否继续
+template <scan_fmt F, int K, class Tuple>
+inline bool scan_step(scan_state& st, Tuple& args) {
+	using P = scan_program<F>;
+	constexpr scan_op op = P::t.ops[K];
+	constexpr int a = P::t.arg[K];
+
+	if constexpr (!P::t.star_before[K] && op.kind != SCAN_OP_SPACE && !(op.kind == SCAN_OP_CONV && op.conv == 'n')) {
+		if (st.p >= st.end) return scan_fail<F, K>(st, MY_SCANF_ERR_INPUT);
+	}
+	if constexpr (op.kind == SCAN_OP_SPACE) {
+		st.p = skip_whitespace(st.p, st.end);
+	}
+	else if constexpr (op.kind == SCAN_OP_LITERAL) {
+		if (st.p >= st.end || *st.p != op.conv) return scan_fail<F, K>(st, MY_SCANF_ERR_LITERAL);
+		st.p++;
+	}
+	else if constexpr (op.conv == 'd' || op.conv == 'i') {
+		st.p = skip_whitespace(st.p, st.end);
+		int64_t val;
+		if (int r = scan_int(&st.p, st.end, op.width, op.len_mod, &val); r <= 0) return scan_fail<F, K>(st, r < 0 ? MY_SCANF_ERR_RANGE : MY_SCANF_ERR_MATCH);
+		if constexpr (a >= 0) {
+			auto& out = std::get<a>(args);
+			out = (std::remove_reference_t<decltype(out)>)val;
+			st.count++;
+		}
+	}
+	else if constexpr (op.conv == 'u' || op.conv == 'x' || op.conv == 'X') {
+		st.p = skip_whitespace(st.p, st.end);
+		uint64_t val;
+		if (int r = scan_uint(&st.p, st.end, op.width, op.conv == 'u' ? 10 : 16, op.len_mod, &val); r <= 0) return scan_fail<F, K>(st, r < 0 ? MY_SCANF_ERR_RANGE : MY_SCANF_ERR_MATCH);
+		if constexpr (a >= 0) {
+			auto& out = std::get<a>(args);
+			out = (std::remove_reference_t<decltype(out)>)val;
+			st.count++;
+		}
+	}
+	else if constexpr (scan_is_float_conv(op.conv)) {
+		st.p = skip_whitespace(st.p, st.end);
+		using T = std::conditional_t<op.len_mod == SCAN_LEN_LD, long double,
+			std::conditional_t<op.len_mod == SCAN_LEN_L, double, float>>;
+		T val;
+		bool ok;
+		if constexpr (op.len_mod == SCAN_LEN_LD) ok = scan_long_double(&st.p, st.end, op.width, &val);
+		else if constexpr (op.len_mod == SCAN_LEN_L) ok = scan_double(&st.p, st.end, op.width, &val);
+		else ok = scan_float(&st.p, st.end, op.width, &val);
+		if (!ok) return scan_fail<F, K>(st);
+		if constexpr (a >= 0) {
+			std::get<a>(args) = val;
+			st.count++;
+		}
+	}
+	else if constexpr (op.conv == 'p') {
+		st.p = skip_whitespace(st.p, st.end);
+		uintptr_t val;
+		if (int r = scan_pointer(&st.p, st.end, op.width, &val); r <= 0) return scan_fail<F, K>(st, r < 0 ? MY_SCANF_ERR_RANGE : MY_SCANF_ERR_MATCH);
+		if constexpr (a >= 0) {
+			std::get<a>(args) = (void*)val;
+			st.count++;
+		}
+	}
+	else if constexpr (op.conv == 's') {
+		st.p = skip_whitespace(st.p, st.end);
+		if constexpr (a >= 0) {
+			if (st.p >= st.end) return scan_fail<F, K>(st);
+			auto& out = std::get<a>(args);
+			if constexpr (op.alloc || op.intern) {
+				const char* start = st.p;
+				size_t n = scan_word(&st.p, st.end, op.width, NULL, SIZE_MAX);
+				if (n == 0) return scan_fail<F, K>(st);
+				if (int err = scan_own_str(&op, &out, start, n)) {
+					st.p = start;
+					return scan_fail<F, K>(st, err);
 				}
-				break;
 			}
-			case 'n': { // 记录已读取的字符数
-				if (!suppress) {
-					*va_arg(args, int*) = (int)(p - input);
+			else if constexpr (op.span) {
+				const char* start = st.p;
+				size_t n = scan_word(&st.p, st.end, op.width, NULL, SIZE_MAX);
+				if (n == 0) return scan_fail<F, K>(st);
+				scan_store_span(out, start, n);
+			}
+			else if constexpr (std::is_same_v<std::remove_reference_t<decltype(out)>, std::string>) {
+				const char* start = st.p;
+				size_t n = scan_word(&st.p, st.end, op.width, NULL, SIZE_MAX);
+				if (n == 0) return scan_fail<F, K>(st);
+				out.assign(start, n);
+			}
+			else {
+				if (scan_word(&st.p, st.end, op.width, out, sizeof(out)) == 0) return scan_fail<F, K>(st);
+			}
+			st.count++;
+		}
+		else {
+			if (!scan_word_skip(&st.p, st.end, op.width) && st.p < st.end) return scan_fail<F, K>(st);
+		}
+	}
+	else if constexpr (op.conv == '[') {
+		const scan_charset* cs = &P::t.sets[op.set];
+		if constexpr (a >= 0) {
+			auto& out = std::get<a>(args);
+			size_t n;
+			if constexpr (op.alloc || op.intern) {
+				const char* start = st.p;
+				n = scan_set(&st.p, st.end, op.width, cs, NULL, SIZE_MAX);
+				if (int err = n > 0 ? scan_own_str(&op, &out, start, n) : MY_SCANF_ERR_NONE) {
+					st.p = start;
+					return scan_fail<F, K>(st, err);
 				}
-				break;
 			}
-			case '%': {
-				if (*p++ != '%') {
-					throw_format_error(input, format, p - 1, f);
-					return count;
+			else if constexpr (op.span) {
+				const char* start = st.p;
+				n = scan_set(&st.p, st.end, op.width, cs, NULL, SIZE_MAX);
+				scan_store_span(out, start, n);
+			}
+			else if constexpr (std::is_same_v<std::remove_reference_t<decltype(out)>, std::string>) {
+				const char* start = st.p;
+				n = scan_set(&st.p, st.end, op.width, cs, NULL, SIZE_MAX);
+				out.assign(start, n);
+			}
+			else {
+				n = scan_set(&st.p, st.end, op.width, cs, out, sizeof(out));
+			}
+			if (n > 0) {
+				st.count++;
+			}
+			else {
+				scan_set_recover(&st.p, st.end, cs);
+			}
+		}
+		else if (!scan_set_skip(&st.p, st.end, op.width, cs)) {
+			scan_set_recover(&st.p, st.end, cs);
+		}
+	}
+	else if constexpr (op.conv == 'c') {
+		if (st.p >= st.end) {
+			if constexpr (a >= 0) return scan_fail<F, K>(st);
+			return true;
+		}
+		if constexpr (a >= 0) {
+			scan_char(&st.p, st.end, std::get<a>(args));
+			st.count++;
+		}
+		else {
+			scan_char(&st.p, st.end, NULL);
+		}
+	}
+	else if constexpr (op.conv == 'n') {
+		if constexpr (a >= 0) {
+			auto& out = std::get<a>(args);
+			out = (std::remove_reference_t<decltype(out)>)(st.p - st.input);
+		}
+	}
+	else if constexpr (op.conv == '%') {
+		if (st.p >= st.end || *st.p != '%') return scan_fail<F, K>(st, MY_SCANF_ERR_LITERAL);
+		st.p++;
+	}
+	return true;
+}
+
+template <scan_fmt F, class Tuple, size_t... K>
+inline void scan_run(scan_state& st, Tuple& args, std::index_sequence<K...>) {
+	(void)(... && scan_step<F, (int)K>(st, args));
+}
+
+// 按编译期格式 F 解析 input（不要求以 '\0' 结尾），返回成功赋值的参数个数
+template <scan_fmt F, class... Args>
+inline int scan(std::string_view input, Args&&... args) {
+	using P = scan_program<F>;
+	static_assert(!P::t.bad, "scan<>: 格式串非法");
+	static_assert(sizeof...(Args) == P::t.nargs, "scan<>: 参数个数与格式不符");
+	scan_check_args<F, std::tuple<Args&&...>>(std::make_index_sequence<P::nops>());
+
+	auto tuple = std::forward_as_tuple(args...);
+	const char* p = input.data() ? input.data() : "";
+	scan_state st = { p, p, p + input.size(), 0 };
+	g_scan_error.code = MY_SCANF_ERR_NONE;
+	scan_run<F>(st, tuple, std::make_index_sequence<P::nops>());
+	return st.count;
+}
+
+template <scan_fmt F, class... Args>
+inline int scan(const char* input, Args&&... args) {
+	return scan<F>(std::string_view(input, strlen(input)), std::forward<Args>(args)...);
+}
+#endif
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+// ================= 协程异步扫描 =================
+// co_await scanner.next_record(fmt, args...) 取下一条记录并按 my_sscanf 的规则解析。
+// 缓冲区中已有完整的记录时不挂起；否则从字节源读取，源暂时没有数据时挂起协程，数据到达后由源的事件循环恢复。
+// 挂起和恢复都不分配内存，一个线程可以同时等待成千上万个缓慢的生产者。
+// 字节源是可替换的接口，Linux 上提供基于 epoll 的管道/套接字源 my_scan_fd_source。
+
+#define MY_SCAN_AGAIN (-2)
+#define SCAN_ASYNC_BUF_SIZE 4096
+
+// 异步字节源
+class my_scan_async_source {
+public:
+	virtual ~my_scan_async_source() {}
+	// 读取最多 n 字节，不阻塞：返回读到的字节数；暂时没有数据返回 MY_SCAN_AGAIN；输入结束返回 0；出错返回 -1
+	virtual long long read(char* buf, size_t n) = 0;
+	// 有数据可读（或输入结束、出错）时调用一次 fn(arg)
+	virtual void wait_readable(void (*fn)(void*), void* arg) = 0;
+};
+
+class my_scan_async {
+public:
+	explicit my_scan_async(my_scan_async_source& src, char sep = '\n') : src_(&src), sep_(sep) {}
+	~my_scan_async() { free(buf_); }
+	my_scan_async(const my_scan_async&) = delete;
+	my_scan_async& operator=(const my_scan_async&) = delete;
+
+	// 等待下一条记录，结果为 1，没有更多记录时为 0，读取出错为 -1。记录在下一次等待前有效
+	struct line_awaiter {
+		my_scan_async* s;
+		bool await_ready() { return (s->ret_ = s->take()) != MY_SCAN_AGAIN; }
+		void await_suspend(std::coroutine_handle<> h) { s->suspend(h); }
+		int await_resume() { return s->ret_; }
+	};
+	line_awaiter next_line() { return line_awaiter{ this }; }
+	std::string_view line() const { return std::string_view(rec_, len_); }
+
+	// 等待下一条记录并解析，结果同 my_sscanf_n（或 my_sscanf_s_n），没有更多记录或读取出错时为 EOF
+	template <int Safe, class... Args>
+	struct record_awaiter {
+		my_scan_async* s;
+		const char* format;
+		std::tuple<Args...> args;
+		bool await_ready() { return (s->ret_ = s->take()) != MY_SCAN_AGAIN; }
+		void await_suspend(std::coroutine_handle<> h) { s->suspend(h); }
+		int await_resume() {
+			if (s->ret_ <= 0) return EOF;
+			return std::apply([this](Args... a) {
+				return Safe ? my_sscanf_s_n(s->rec_, s->len_, format, a...) : my_sscanf_n(s->rec_, s->len_, format, a...);
+			}, args);
+		}
+	};
+	template <class... Args>
+	record_awaiter<0, Args...> next_record(const char* format, Args... args) {
+		return record_awaiter<0, Args...>{ this, format, std::tuple<Args...>(args...) };
+	}
+	template <class... Args>
+	record_awaiter<1, Args...> next_record_s(const char* format, Args... args) {
+		return record_awaiter<1, Args...>{ this, format, std::tuple<Args...>(args...) };
+	}
+
+private:
+	// 取下一条记录：1 成功，0 没有更多记录，-1 出错，MY_SCAN_AGAIN 需要等待数据
+	int take() {
+		for (;;) {
+			size_t avail = lim_ - pos_;
+			size_t i = scanned_ + scan_isa.find_byte(buf_ + pos_ + scanned_, avail - scanned_, sep_);
+			if (i < avail) {
+				emit(i, i + 1);
+				return 1;
+			}
+			scanned_ = avail;
+			if (err_) return -1;
+			if (eof_) {
+				if (avail == 0) return 0;
+				emit(avail, avail); // 最后一条记录没有分隔符
+				return 1;
+			}
+			// 未读部分移到开头，满了则扩大一倍
+			if (pos_ > 0) {
+				memmove(buf_, buf_ + pos_, avail);
+				lim_ = avail;
+				pos_ = 0;
+			}
+			if (lim_ == cap_) {
+				size_t cap = cap_ ? cap_ * 2 : SCAN_ASYNC_BUF_SIZE;
+				char* buf = (char*)realloc(buf_, cap);
+				if (!buf) return -1;
+				buf_ = buf;
+				cap_ = cap;
+			}
+			long long n = src_->read(buf_ + lim_, cap_ - lim_);
+			if (n == MY_SCAN_AGAIN) return MY_SCAN_AGAIN;
+			if (n < 0) err_ = true;
+			else if (n == 0) eof_ = true;
+			else lim_ += (size_t)n;
+		}
+	}
+	void emit(size_t len, size_t used) {
+		rec_ = buf_ + pos_;
+		len_ = len;
+		pos_ += used;
+		scanned_ = 0;
+		if (sep_ == '\n' && len_ > 0 && rec_[len_ - 1] == '\r') len_--;
+	}
+	void suspend(std::coroutine_handle<> h) {
+		waiter_ = h;
+		src_->wait_readable(&my_scan_async::on_readable, this);
+	}
+	// 数据到达：凑齐一条记录（或输入结束）才恢复协程，否则继续等待
+	static void on_readable(void* arg) {
+		my_scan_async* s = (my_scan_async*)arg;
+		s->ret_ = s->take();
+		if (s->ret_ == MY_SCAN_AGAIN) {
+			s->src_->wait_readable(&my_scan_async::on_readable, s);
+			return;
+		}
+		s->waiter_.resume();
+	}
+
+	my_scan_async_source* src_;
+	char* buf_ = nullptr;
+	size_t cap_ = 0;
+	size_t pos_ = 0;
+	size_t lim_ = 0;
+	size_t scanned_ = 0; // [pos_, pos_ + scanned_) 已确认没有分隔符
+	const char* rec_ = "";
+	size_t len_ = 0;
+	int ret_ = 0;
+	char sep_;
+	bool eof_ = false;
+	bool err_ = false;
+	std::coroutine_handle<> waiter_;
+};
+
+// 即发即弃的协程类型：立即开始执行，结束时自动销毁，便于在事件循环上启动扫描协程
+struct my_scan_detached {
+	struct promise_type {
+		my_scan_detached get_return_object() { return {}; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_never final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { abort(); }
+	};
+};
+
+#ifdef __linux__
+// epoll 事件循环：run 处理就绪的源，直到没有源在等待
+class my_scan_epoll {
+public:
+	my_scan_epoll() : ep_(epoll_create1(EPOLL_CLOEXEC)) {}
+	~my_scan_epoll() {
+		if (ep_ >= 0) close(ep_);
+	}
+	my_scan_epoll(const my_scan_epoll&) = delete;
+	my_scan_epoll& operator=(const my_scan_epoll&) = delete;
+	bool ok() const { return ep_ >= 0; }
+
+	// 返回处理的事件数，出错返回 -1
+	long long run() {
+		long long handled = 0;
+		while (waiting_ > 0 || !ready_.empty()) {
+			// 不支持 epoll 的源（普通文件）总是就绪，直接回调
+			while (!ready_.empty()) {
+				firing_.clear();
+				firing_.swap(ready_);
+				for (size_t i = 0; i < firing_.size(); i++) {
+					if (!firing_[i]) continue; // 回调中被销毁的源
+					handled++;
+					fire(firing_[i]);
 				}
-				break;
+				firing_.clear();
 			}
-			default:
-				throw_format_error(input, format, p, f);
-				return count;
+			if (waiting_ == 0) break;
+			nev_ = epoll_wait(ep_, ev_, 256, -1);
+			if (nev_ < 0) {
+				nev_ = 0;
+				if (errno == EINTR) continue;
+				return -1;
 			}
-			f++;
+			for (int i = 0; i < nev_; i++) {
+				if (!ev_[i].data.ptr) continue;
+				waiting_--;
+				handled++;
+				fire(ev_[i].data.ptr);
+			}
+			nev_ = 0;
+		}
+		return handled;
+	}
+
+private:
+	friend class my_scan_fd_source;
+	static void fire(void* src);
+	// 源在等待中被销毁（取消）时撤销它尚未处理的回调
+	void cancel(void* src) {
+		for (auto& r : ready_) if (r == src) r = nullptr;
+		for (auto& r : firing_) if (r == src) r = nullptr;
+		for (int i = 0; i < nev_; i++) if (ev_[i].data.ptr == src) ev_[i].data.ptr = nullptr;
+	}
+	int ep_;
+	size_t waiting_ = 0;
+	std::vector<void*> ready_;  // 总是就绪的源
+	std::vector<void*> firing_; // 正在回调的就绪源
+	struct epoll_event ev_[256];
+	int nev_ = 0;               // ev_ 中正在处理的事件数
+};
+
+// 文件描述符源：设为非阻塞，等待时以 EPOLLONESHOT 登记，一次等待只回调一次。不负责关闭 fd
+class my_scan_fd_source : public my_scan_async_source {
+public:
+	my_scan_fd_source(my_scan_epoll& loop, int fd) : loop_(&loop), fd_(fd) {
+		int fl = fcntl(fd, F_GETFL);
+		if (fl >= 0) fcntl(fd, F_SETFL, fl | O_NONBLOCK);
+	}
+	// 协程仍在等待时也可以销毁（取消等待）：撤销登记，run 不会再为它阻塞或回调
+	~my_scan_fd_source() override {
+		if (fn_) {
+			if (!always_ready_) loop_->waiting_--;
+			loop_->cancel(this);
+			fn_ = nullptr;
+		}
+		if (registered_) epoll_ctl(loop_->ep_, EPOLL_CTL_DEL, fd_, NULL);
+	}
+
+	long long read(char* buf, size_t n) override {
+		for (;;) {
+			ssize_t got = ::read(fd_, buf, n);
+			if (got >= 0) return (long long)got;
+			if (errno == EINTR) continue;
+			if (errno == EAGAIN || errno == EWOULDBLOCK) return MY_SCAN_AGAIN;
+			return -1;
+		}
+	}
+
+	void wait_readable(void (*fn)(void*), void* arg) override {
+		fn_ = fn;
+		arg_ = arg;
+		if (!always_ready_) {
+			struct epoll_event ev = {};
+			ev.events = EPOLLIN | EPOLLRDHUP | EPOLLONESHOT;
+			ev.data.ptr = this;
+			int r = epoll_ctl(loop_->ep_, registered_ ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, fd_, &ev);
+			if (r == 0) {
+				registered_ = true;
+				loop_->waiting_++;
+				return;
+			}
+			// 普通文件等不支持 epoll 的 fd 总是可读；其他错误也交给 read 报告
+			always_ready_ = true;
+		}
+		loop_->ready_.push_back(this);
+	}
+
+private:
+	friend class my_scan_epoll;
+	my_scan_epoll* loop_;
+	int fd_;
+	bool registered_ = false;
+	bool always_ready_ = false;
+	void (*fn_)(void*) = nullptr;
+	void* arg_ = nullptr;
+};
+
+inline void my_scan_epoll::fire(void* p) {
+	my_scan_fd_source* src = (my_scan_fd_source*)p;
+	void (*fn)(void*) = src->fn_;
+	src->fn_ = nullptr;
+	if (fn) fn(src->arg_);
+}
+#endif
+#endif
+
+#ifdef MY_SCANF_BENCH
+// ================= 性能测试 =================
+// 以 -DMY_SCANF_BENCH 编译时，main 只运行这里的性能测试
+
+static double bench_ns(std::chrono::steady_clock::time_point t0, long n) {
+	return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / n;
+}
+
+static int bench_count_fields(void* ctx, int worker, int count, void* const* fields, const char* line, size_t len) {
+	(void)worker; (void)fields; (void)line; (void)len;
+	((std::atomic<long long>*)ctx)->fetch_add(count, std::memory_order_relaxed);
+	return 0;
+}
+
+// 长短悬殊的记录：前四分之一是 40 字节的心跳行，其余是 8KB 的堆栈行。按字节平均切分时，
+// 分到心跳行的线程要解析的行数是其他线程的数百倍
+static void bench_skewed() {
+	const char* path = "scan_bench_skewed.txt";
+	FILE* fp = fopen(path, "wb");
+	if (!fp) return;
+	const size_t total = 64 * 1024 * 1024;
+	std::vector<char> trace(8192, 'x');
+	memcpy(trace.data(), "java.lang.IllegalStateException at ", 36);
+	trace[8191] = '\n';
+	size_t written = 0;
+	for (long i = 0; written < total / 4; i++) written += fprintf(fp, "%010ld host-%02ld heartbeat ok seq=%06ld\n", 1700000000 + i, i % 64, i % 1000000);
+	for (long i = 0; written < total; i++) written += fprintf(fp, "%010ld host-%02ld ", 1700000000 + i, i % 64) + fwrite(trace.data(), 1, trace.size(), fp);
+	fclose(fp);
+
+	int threads = (int)std::thread::hardware_concurrency();
+	if (threads < 4) threads = 4;
+	printf("\nskewed corpus %zu MB, %d threads\n", written >> 20, threads);
+	const char* names[] = { "static", "chunked", "steal" };
+	const int scheds[] = { MY_SCAN_SCHED_STATIC, MY_SCAN_SCHED_CHUNKED, MY_SCAN_SCHED_STEAL };
+	std::vector<my_scan_thread_stats> st(threads);
+	for (int k = 0; k < 3; k++) {
+		std::atomic<long long> fields(0);
+		my_scan_parallel_opts opts = {};
+		opts.threads = threads;
+		opts.schedule = scheds[k];
+		opts.stats = st.data();
+		opts.nstats = threads;
+		auto t0 = std::chrono::steady_clock::now();
+		long long lines = my_scan_file_parallel(path, "%d %s %[^\n]", bench_count_fields, &fields, &opts);
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+		double slow = 0, fast = 1e30;
+		unsigned long long steals = 0;
+		for (int w = 0; w < threads; w++) {
+			if (st[w].seconds > slow) slow = st[w].seconds;
+			if (st[w].seconds < fast) fast = st[w].seconds;
+			steals += st[w].steals;
+		}
+		printf("%-8s %8.1f ms  slowest %8.1f ms  fastest %8.1f ms  tail %8.1f ms  steals %llu  (%lld lines)\n",
+			names[k], ms, slow * 1e3, fast * 1e3, (slow - fast) * 1e3, steals, lines);
+	}
+	remove(path);
+}
+
+static void scan_bench() {
+	const char* line = "12345 hostname.example.com=some_value_here 0x1f";
+	const long n = 2000000;
+	int d = 0;
+	unsigned int x = 0;
+	char key[64], value[64];
+	printf("isa: %s (MY_SCANF_ISA)\n", my_scanf_isa());
+
+	auto t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) my_sscanf_s(line, "%d %[^=]=%s %x", &d, key, sizeof(key), value, sizeof(value), &x);
+	printf("my_sscanf_s          %8.1f ns/line\n", bench_ns(t0, n));
+
+	const my_scanf_format* fmt = my_scanf_compile("%d %[^=]=%s %x");
+	t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) my_sscanf_s_compiled(line, fmt, &d, key, sizeof(key), value, sizeof(value), &x);
+	printf("my_sscanf_s_compiled %8.1f ns/line\n", bench_ns(t0, n));
+	my_scanf_free(fmt);
+
+#if __cplusplus >= 202002L
+	t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) scan<"%d %[^=]=%s %x">(line, d, key, value, x);
+	printf("scan<>               %8.1f ns/line\n", bench_ns(t0, n));
+#endif
+	printf("d=%d key=%s value=%s x=%x\n", d, key, value, x);
+
+	// %m：每 1024 行重置一次区域
+	my_scanf_arena* arena = my_scanf_arena_create(NULL, 256 * 1024);
+	my_scanf_arena* prev = my_scanf_use_arena(arena);
+	char* mkey = NULL;
+	char* mvalue = NULL;
+	t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) {
+		if ((i & 1023) == 0) my_scanf_arena_reset(arena);
+		my_sscanf(line, "%d %m[^=]=%ms %x", &d, &mkey, &mvalue, &x);
+	}
+	printf("my_sscanf %%m arena   %8.1f ns/line\n", bench_ns(t0, n));
+	printf("key=%s value=%s\n", mkey, mvalue);
+	my_scanf_use_arena(prev);
+	my_scanf_arena_free(arena);
+
+	// %K：两个字段都在表中，只查找
+	my_scanf_intern* table = my_scanf_intern_create(0);
+	my_scanf_intern* prev_table = my_scanf_set_intern(table);
+	uint32_t ikey = 0, ivalue = 0;
+	t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) my_sscanf(line, "%d %K[^=]=%K %x", &d, &ikey, &ivalue, &x);
+	printf("my_sscanf %%K intern  %8.1f ns/line\n", bench_ns(t0, n));
+	printf("key=%s value=%s\n", my_scanf_intern_str(table, ikey, NULL), my_scanf_intern_str(table, ivalue, NULL));
+	my_scanf_set_intern(prev_table);
+	my_scanf_intern_free(table);
+
+	const char* padded = "alpha                           beta                            gamma";
+	char c1[32], c2[32], c3[32];
+	t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) my_sscanf_s(padded, "%s %s %s", c1, sizeof(c1), c2, sizeof(c2), c3, sizeof(c3));
+	printf("my_sscanf_s padded   %8.1f ns/line\n", bench_ns(t0, n));
+
+	// 中文字段：“北京市海淀区中关村大街” “用户名=张三”
+	const char* gb = "\xB1\xB1\xBE\xA9\xCA\xD0\xBA\xA3\xB5\xED\xC7\xF8\xD6\xD0\xB9\xD8\xB4\xE5\xB4\xF3\xBD\xD6 "
+		"\xD3\xC3\xBB\xA7\xC3\xFB=\xD5\xC5\xC8\xFD";
+	t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) my_sscanf_s(gb, "%s %[^=]=%s", c1, sizeof(c1), c2, sizeof(c2), c3, sizeof(c3));
+	printf("my_sscanf_s GB2312   %8.1f ns/line\n", bench_ns(t0, n));
+
+	const char* floats = "1.5 -0.25 3.14159 2.71828 1e-3 6.02214076e23 0.1 100.5 -42.125 9.81";
+	float fv[10];
+	t0 = std::chrono::steady_clock::now();
+	for (long i = 0; i < n; i++) {
+		my_sscanf(floats, "%f %f %f %f %f %f %f %f %f %f",
+			&fv[0], &fv[1], &fv[2], &fv[3], &fv[4], &fv[5], &fv[6], &fv[7], &fv[8], &fv[9]);
+	}
+	printf("my_sscanf 10 x %%f    %8.1f ns/line\n", bench_ns(t0, n));
+	printf("f[5]=%g f[9]=%g\n", fv[5], fv[9]);
+
+	bench_skewed();
+}
+#endif
+
+#ifdef MY_SCANF_TEST
+// ================= 自测 =================
+// 以 -DMY_SCANF_TEST 编译时，main 只运行这里的自测，返回失败的检查数（0 表示全部通过）。
+// 各项把输入按随机大小切开后送入被测接口，与整行调用 my_sscanf_n 的结果对照；
+// 适合在 -fsanitize=address 或 -fsanitize=thread 下运行。
+
+static std::atomic<int> g_test_failed; // 检查可能在工作线程中失败
+
+#define TEST_CHECK(cond) do { \
+	if (!(cond)) { \
+		if (g_test_failed++ < 20) printf("  FAIL %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+	} \
+} while (0)
+
+// 测试用的记录：整数、浮点数、GB2312 词，每 5 行一个 CRLF
+static std::string test_records(int n, std::vector<std::string>* lines) {
+	std::string all;
+	for (int i = 0; i < n; i++) {
+		char b[128];
+		snprintf(b, sizeof(b), "%d %d.%06d \xC4\xE3\xBA\xC3w%d%s", i * 7919, i, i * 37 % 1000000, i, i % 5 ? "" : "\r");
+		if (lines) lines->push_back(b);
+		all += b;
+		all += '\n';
+	}
+	return all;
+}
+
+// 按 "%d %lf %s" 解析一条记录后的规范化结果，字段为 my_scan_fields_fn 的输出；未赋值的字段不参与比较
+static std::string test_fields_str(int count, void* const* fields, const char* line, size_t len) {
+	char b[64];
+	snprintf(b, sizeof(b), "%d|%d|%.17g|", count, count >= 1 ? *(int*)fields[0] : 0, count >= 2 ? *(double*)fields[1] : 0.0);
+	std::string out = b;
+	if (count >= 3) out.append(((const my_scanf_span*)fields[2])->ptr, ((const my_scanf_span*)fields[2])->len);
+	out += '|';
+	out.append(line, len);
+	return out;
+}
+
+// 整行解析的期望结果（去掉行末的 '\r'）
+static std::vector<std::string> test_expect(const std::vector<std::string>& lines) {
+	std::vector<std::string> out;
+	for (const std::string& l : lines) {
+		size_t len = l.size() - (!l.empty() && l.back() == '\r');
+		int d = 0;
+		double x = 0;
+		my_scanf_span s = {};
+		int count = my_sscanf_n(l.data(), len, "%d %lf %V", &d, &x, &s);
+		void* fields[3] = { &d, &x, &s };
+		out.push_back(test_fields_str(count, fields, l.data(), len));
+	}
+	return out;
+}
+
+// 收集回调的结果，第 stop_at 条返回非 0（只返回一次，其他线程之后的回调不会替它停下）；并行扫描会并发回调。
+// yield 让每次回调都让出 CPU，单核上各线程也会交替进入各自的段
+struct test_sink {
+	std::vector<std::string> got;
+	size_t stop_at;
+	bool yield;
+	std::mutex mu;
+};
+
+static int test_collect(void* ctx, int worker, int count, void* const* fields, const char* line, size_t len) {
+	(void)worker;
+	test_sink* sink = (test_sink*)ctx;
+	if (sink->yield) std::this_thread::yield();
+	std::string s = test_fields_str(count, fields, line, len);
+	std::lock_guard<std::mutex> lock(sink->mu);
+	sink->got.push_back(s);
+	return sink->stop_at && sink->got.size() == sink->stop_at;
+}
+
+// 写出测试用的临时文件，返回路径
+static const char* test_write_file(const char* name, const std::string& data) {
+	FILE* f = fopen(name, "wb");
+	TEST_CHECK(f != NULL);
+	if (f) {
+		fwrite(data.data(), 1, data.size(), f);
+		fclose(f);
+	}
+	return name;
+}
+
+static std::vector<std::string> test_reader_records(my_scanf_reader* r) {
+	std::vector<std::string> v;
+	const char* p;
+	size_t n;
+	int ret;
+	while ((ret = my_scanf_reader_next(r, &p, &n)) > 0) v.push_back(std::string(p, n));
+	if (ret < 0) v.push_back("<error>");
+	return v;
+}
+
+// 预读读取器：各种块大小和队列深度下切出的记录与同步读取器一致，包括跨越多个块的长行
+static void test_readahead() {
+	std::string data;
+	unsigned seed = 5;
+	for (int i = 0; i < 20000; i++) {
+		seed = seed * 1103515245 + 12345;
+		int len = i == 777 ? 5000 : (int)((seed >> 16) % 40);
+		for (int k = 0; k < len; k++) data += (char)('a' + (i + k) % 26);
+		data += i % 3 ? "\n" : "\r\n";
+	}
+	data += "tail";
+	const char* path = test_write_file("my_scanf_test_readahead.tmp", data);
+
+	FILE* f = fopen(path, "rb");
+	my_scanf_reader* r = my_scanf_reader_open(f, 0);
+	std::vector<std::string> expect = test_reader_records(r);
+	my_scanf_reader_close(r);
+	fclose(f);
+	TEST_CHECK(expect.size() == 20001 && expect.back() == "tail");
+
+	const size_t sizes[] = { 7, 4096, 0 };
+	const int depths[] = { 1, 2, 5 };
+	for (size_t bs : sizes) {
+		for (int depth : depths) {
+			r = my_scanf_reader_open_readahead(path, bs, depth);
+			TEST_CHECK(r != NULL);
+			if (!r) continue;
+			TEST_CHECK(test_reader_records(r) == expect);
+			my_scanf_reader_stats st;
+			my_scanf_reader_get_stats(r, &st);
+			TEST_CHECK(st.bytes == data.size());
+			my_scanf_reader_close(r);
+		}
+	}
+
+	// 读了一条就关闭，预读线程要能退出
+	r = my_scanf_reader_open_readahead(path, 64, 3);
+	const char* p;
+	size_t n;
+	TEST_CHECK(my_scanf_reader_next(r, &p, &n) == 1);
+	my_scanf_reader_close(r);
+
+	int d, count = 0;
+	r = my_scanf_reader_open_readahead(path, 0, 2);
+	while (my_rscanf(r, "%d", &d) != EOF) count++;
+	TEST_CHECK(count == 20001);
+	my_scanf_reader_close(r);
+	remove(path);
+
+	TEST_CHECK(my_scanf_reader_open_readahead("my_scanf_test_missing.tmp", 0, 2) == NULL);
+	path = test_write_file("my_scanf_test_empty.tmp", "");
+	r = my_scanf_reader_open_readahead(path, 0, 2);
+	TEST_CHECK(my_scanf_reader_next(r, &p, &n) == 0);
+	my_scanf_reader_close(r);
+	remove(path);
+}
+
+// my_scan_file_parallel：各种调度、线程数和块大小下得到的记录集合与 my_scan_stream 相同，有序模式下顺序也相同
+static void test_parallel() {
+	std::string files[5];
+	for (int i = 0; i < 10000; i++) files[0] += std::to_string(i) + " 1.5 ok\n";
+	for (int i = 0; i < 100; i++) files[0] += std::to_string(i) + " 2 " + std::string(8000, 't') + "\n"; // 长行集中在末尾
+	unsigned seed = 3;
+	for (int i = 0; i < 8000; i++) {
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 50 == 0) files[1] += std::to_string(i) + " 3 " + std::string((seed >> 8) % 9000, 's') + "\r\n";
+		else files[1] += std::to_string(i) + " 4 \xC4\xE3\n";
+	}
+	files[1] += "77 5 nonl";
+	// files[2] 为空文件
+	files[3] = "5 6 " + std::string(200000, 'q'); // 没有换行的长记录
+	files[4] = "\n\n\n1 7 a\n\n";
+
+	const int schedules[] = { MY_SCAN_SCHED_AUTO, MY_SCAN_SCHED_STEAL, MY_SCAN_SCHED_CHUNKED, MY_SCAN_SCHED_STATIC };
+	const int threads[] = { 1, 2, 3, 8 };
+	const size_t grains[] = { 0, 1, 100, 4096 };
+	for (const std::string& data : files) {
+		const char* path = test_write_file("my_scanf_test_parallel.tmp", data);
+		test_sink ref = {};
+		my_scan_stream* st = my_scan_stream_open("%d %lf %s", test_collect, &ref);
+		my_scan_stream_feed(st, data.data(), data.size());
+		my_scan_stream_finish(st);
+		my_scan_stream_close(st);
+		std::vector<std::string> sorted = ref.got;
+		std::sort(sorted.begin(), sorted.end());
+
+		for (int sched : schedules) for (int th : threads) for (size_t g : grains) for (int ord = 0; ord < 2; ord++) {
+			if (g == 1 && (ord || sched == MY_SCAN_SCHED_CHUNKED || sched == MY_SCAN_SCHED_STATIC)) continue; // 每行一块太慢
+			test_sink sink = {};
+			my_scan_thread_stats stats[8] = {};
+			my_scan_parallel_opts o = {};
+			o.threads = th;
+			o.ordered = ord;
+			o.chunk_size = g;
+			o.schedule = sched;
+			o.stats = stats;
+			o.nstats = 8;
+			long long r = my_scan_file_parallel(path, "%d %lf %s", test_collect, &sink, &o);
+			unsigned long long lines = 0;
+			for (const my_scan_thread_stats& s : stats) lines += s.lines;
+			TEST_CHECK(r == (long long)ref.got.size() && lines == ref.got.size());
+			if (ord) {
+				TEST_CHECK(sink.got == ref.got);
+			} else {
+				std::sort(sink.got.begin(), sink.got.end());
+				TEST_CHECK(sink.got == sorted);
+			}
+		}
+
+		remove(path);
+	}
+
+	// 提前停止：并发回调时其他线程最多再各回调一行。默认块大小下每个线程的段都有上千行，
+	// 只在领取下一段之前检查停止是不够的
+	std::string lines;
+	for (int i = 0; i < 10000; i++) lines += std::to_string(i) + " 1.5 ok\n";
+	const char* path = test_write_file("my_scanf_test_parallel.tmp", lines);
+	for (int sched : { MY_SCAN_SCHED_STEAL, MY_SCAN_SCHED_STATIC, MY_SCAN_SCHED_CHUNKED }) {
+		for (size_t g : { (size_t)64, (size_t)0 }) {
+			for (int th : { 2, 8 }) {
+				test_sink sink = {};
+				sink.stop_at = 200;
+				sink.yield = true;
+				my_scan_parallel_opts o = {};
+				o.threads = th;
+				o.chunk_size = g;
+				o.schedule = sched;
+				long long r = my_scan_file_parallel(path, "%d %lf %s", test_collect, &sink, &o);
+				TEST_CHECK(r >= 200 && r <= 200 + th);
+			}
+		}
+	}
+	remove(path);
+}
+
+#ifndef _WIN32
+// my_scan_stream：socketpair 两端都按 1~64 字节随机切分，记录可能断在字段、数字或 GB2312 双字节中间
+static void test_stream_fragments() {
+	std::vector<std::string> lines;
+	std::string all = test_records(3000, &lines);
+	std::vector<std::string> expect = test_expect(lines);
+
+	int sv[2];
+	TEST_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sv) == 0);
+	std::thread writer([&] {
+		unsigned seed = 7;
+		size_t off = 0;
+		while (off < all.size()) {
+			seed = seed * 1103515245 + 12345;
+			size_t n = 1 + (seed >> 16) % 64;
+			if (n > all.size() - off) n = all.size() - off;
+			ssize_t w = write(sv[0], all.data() + off, n);
+			if (w <= 0) break;
+			off += (size_t)w;
+		}
+		close(sv[0]);
+	});
+
+	test_sink sink = {};
+	my_scan_stream* st = my_scan_stream_open("%d %lf %s", test_collect, &sink);
+	TEST_CHECK(st != NULL);
+	unsigned seed = 11;
+	long long records = 0;
+	char buf[64];
+	for (;;) {
+		seed = seed * 1103515245 + 12345;
+		ssize_t n = read(sv[1], buf, 1 + (seed >> 16) % sizeof(buf));
+		if (n <= 0) break;
+		records += my_scan_stream_feed(st, buf, (size_t)n);
+		TEST_CHECK(my_scan_stream_pending(st) < 64);
+	}
+	records += my_scan_stream_finish(st);
+	writer.join();
+	close(sv[1]);
+	my_scan_stream_close(st);
+	TEST_CHECK(records == 3000);
+	TEST_CHECK(sink.got == expect);
+
+	// 最后一条没有换行、逐字节送入，断在 GB2312 双字节之间
+	sink.got.clear();
+	st = my_scan_stream_open("%d %lf %s", test_collect, &sink);
+	const char* tail = "5 1.5 \xC4\xE3";
+	for (const char* q = tail; *q; q++) my_scan_stream_feed(st, q, 1);
+	TEST_CHECK(my_scan_stream_finish(st) == 1);
+	TEST_CHECK(sink.got.size() == 1 && sink.got[0] == "3|5|1.5|\xC4\xE3|5 1.5 \xC4\xE3");
+	my_scan_stream_close(st);
+}
+
+// my_scan_pipeline：各种线程数、在途批数和批大小下，回调收到的记录、顺序和提前停止都与 my_scan_stream 一致
+static void test_pipeline() {
+	std::string data;
+	unsigned seed = 1;
+	for (int i = 0; i < 5000; i++) {
+		seed = seed * 1103515245 + 12345;
+		int k = (seed >> 16) % 10;
+		char b[64];
+		if (k == 0) data += std::string((seed >> 8) % 3000, 'x') + "\n"; // 比批长的记录
+		else if (k == 1) snprintf(b, sizeof(b), "%d 0.5 crlf\r\n", i), data += b;
+		else if (k == 2) data += "\n";
+		else snprintf(b, sizeof(b), "%d %d.25 \xC4\xE3w%u\n", i, i % 97, seed), data += b;
+	}
+	data += "99 1 last-no-newline";
+
+	const size_t stops[] = { 0, 1, 777 };
+	std::vector<std::string> expect[3];
+	for (int si = 0; si < 3; si++) {
+		test_sink sink = {};
+		sink.stop_at = stops[si];
+		my_scan_stream* st = my_scan_stream_open("%d %lf %s", test_collect, &sink);
+		my_scan_stream_feed(st, data.data(), data.size());
+		my_scan_stream_finish(st);
+		my_scan_stream_close(st);
+		expect[si] = sink.got;
+	}
+
+	const int workers[] = { 1, 2, 5 };
+	const int batches[] = { 0, 1, 7 };
+	const size_t sizes[] = { 1, 16, 0 };
+	for (int w : workers) for (int b : batches) for (size_t sz : sizes) for (int si = 0; si < 3; si++) {
+		int fds[2];
+		TEST_CHECK(pipe(fds) == 0);
+		// 写端随机切分，读端的每次 read 都可能断在记录中间
+		std::thread writer([&] {
+			unsigned ws = 7;
+			size_t off = 0;
+			while (off < data.size()) {
+				ws = ws * 1103515245 + 12345;
+				size_t n = 1 + (ws >> 16) % 5000;
+				if (n > data.size() - off) n = data.size() - off;
+				ssize_t r = write(fds[1], data.data() + off, n);
+				if (r <= 0) break; // 提前停止后读端已关闭
+				off += (size_t)r;
+			}
+			close(fds[1]);
+		});
+		test_sink sink = {};
+		sink.stop_at = stops[si];
+		my_scan_pipeline_stats st;
+		my_scan_pipeline_opts o = { w, b, sz, 0, &st };
+		long long r = my_scan_pipeline(fds[0], "%d %lf %s", test_collect, &sink, &o);
+		close(fds[0]);
+		writer.join();
+		TEST_CHECK(r == (long long)sink.got.size());
+		TEST_CHECK(sink.got == expect[si]);
+	}
+}
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine) && defined(__linux__)
+// 可以从外部销毁的协程，用于测试取消
+struct test_task {
+	struct promise_type {
+		test_task get_return_object() { return { std::coroutine_handle<promise_type>::from_promise(*this) }; }
+		std::suspend_never initial_suspend() noexcept { return {}; }
+		std::suspend_always final_suspend() noexcept { return {}; }
+		void return_void() {}
+		void unhandled_exception() { abort(); }
+	};
+	std::coroutine_handle<promise_type> h;
+};
+
+static int g_async_done;
+
+static my_scan_detached test_async_consume(my_scan_async& sc, int id, int expect) {
+	int seq = 0, v;
+	char word[32], want[32];
+	for (;;) {
+		int r = co_await sc.next_record_s("%d %s", &v, word, sizeof(word));
+		if (r == EOF) break;
+		snprintf(want, sizeof(want), "w%d_%d", id, seq);
+		TEST_CHECK(r == 2 && v == seq && strcmp(word, want) == 0);
+		seq++;
+	}
+	TEST_CHECK(seq == expect);
+	g_async_done++;
+}
+
+static my_scan_detached test_async_lines(my_scan_async& sc, std::string* out) {
+	while (co_await sc.next_line() == 1) {
+		out->append(sc.line());
+		out->push_back('|');
+	}
+	g_async_done++;
+}
+
+static test_task test_async_count(my_scan_async& sc, int* got) {
+	int x;
+	while (co_await sc.next_record("%d", &x) != EOF) ++*got;
+}
+
+// 读到一条记录后销毁另一个协程和它的源
+static test_task test_async_kill(my_scan_async& sc, std::unique_ptr<my_scan_fd_source>& victim, test_task& vt,
+	std::unique_ptr<my_scan_async>& vsc, int* got) {
+	int x;
+	if (co_await sc.next_record("%d", &x) != EOF) {
+		victim.reset();
+		vt.h.destroy();
+		vsc.reset();
+		*got += 100;
+	}
+}
+
+// my_scan_async：一个 epoll 循环同时读多个管道，写端随机切分、交错写入；普通文件作为始终就绪的源
+static void test_async() {
+	const int N = 100, M = 200;
+	int rfd[N], wfd[N];
+	for (int i = 0; i < N; i++) {
+		int p[2];
+		TEST_CHECK(pipe(p) == 0);
+		rfd[i] = p[0];
+		wfd[i] = p[1];
+	}
+	std::thread writer([&] {
+		std::vector<std::string> data(N);
+		std::vector<size_t> off(N, 0);
+		for (int i = 0; i < N; i++) {
+			for (int s = 0; s < M; s++) data[i] += std::to_string(s) + " w" + std::to_string(i) + "_" + std::to_string(s) + (s % 3 ? "\n" : "\r\n");
 		}
-		else {
-			if (isspace(*f)) {
-				f++;
-				p = skip_whitespace(p);
-			}
-			else {
-				if (*f++ != *p++) {
-					throw_format_error(input, format, p - 1, f - 1);
-					return count;
-				}
+		unsigned seed = 5;
+		int left = N;
+		while (left) {
+			seed = seed * 1103515245 + 12345;
+			int i = (seed >> 16) % N;
+			if (off[i] == data[i].size()) continue;
+			seed = seed * 1103515245 + 12345;
+			size_t n = 1 + (seed >> 16) % 40;
+			if (n > data[i].size() - off[i]) n = data[i].size() - off[i];
+			if (write(wfd[i], data[i].data() + off[i], n) < 0) break;
+			off[i] += n;
+			if (off[i] == data[i].size()) {
+				close(wfd[i]);
+				left--;
 			}
+			if ((seed >> 8) % 500 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
 		}
+	});
+
+	g_async_done = 0;
+	my_scan_epoll loop;
+	std::vector<std::unique_ptr<my_scan_fd_source>> srcs;
+	std::vector<std::unique_ptr<my_scan_async>> scs;
+	for (int i = 0; i < N; i++) {
+		srcs.emplace_back(new my_scan_fd_source(loop, rfd[i]));
+		scs.emplace_back(new my_scan_async(*srcs.back()));
+		test_async_consume(*scs.back(), i, M);
 	}
+	FILE* f = tmpfile();
+	fputs("a b\r\n\nlong", f);
+	fflush(f);
+	rewind(f);
+	my_scan_fd_source fsrc(loop, fileno(f));
+	my_scan_async fsc(fsrc);
+	std::string lines;
+	test_async_lines(fsc, &lines);
+	loop.run();
+	writer.join();
+	TEST_CHECK(g_async_done == N + 1);
+	TEST_CHECK(lines == "a b||long|");
+	scs.clear();
+	srcs.clear();
+	for (int i = 0; i < N; i++) close(rfd[i]);
+	fclose(f);
 
-	va_end(args);
-	return count;
+	// 取消：等待中的源先于协程销毁后，run 不会恢复已销毁的协程，也不会一直等下去
+	int a[2], b[2], c[2];
+	TEST_CHECK(pipe(a) == 0 && pipe(b) == 0 && pipe(c) == 0);
+	my_scan_epoll loop2;
+	int got = 0;
+	{
+		// 同一批就绪事件中，前一个源的回调销毁了后一个源
+		std::unique_ptr<my_scan_fd_source> victim(new my_scan_fd_source(loop2, b[0]));
+		std::unique_ptr<my_scan_async> vsc(new my_scan_async(*victim));
+		test_task vt = test_async_count(*vsc, &got);
+		my_scan_fd_source ksrc(loop2, a[0]);
+		my_scan_async ksc(ksrc);
+		test_task kt = test_async_kill(ksc, victim, vt, vsc, &got);
+		TEST_CHECK(write(b[1], "5\n", 2) == 2 && write(a[1], "1\n", 2) == 2);
+		// 等待中的管道源和始终就绪的普通文件源在 run 之前取消
+		FILE* tf = tmpfile();
+		my_scan_fd_source* ps = new my_scan_fd_source(loop2, c[0]);
+		my_scan_fd_source* fs = new my_scan_fd_source(loop2, fileno(tf));
+		my_scan_async* pa = new my_scan_async(*ps);
+		my_scan_async* fa = new my_scan_async(*fs);
+		test_task pt = test_async_count(*pa, &got);
+		test_task ft = test_async_count(*fa, &got);
+		delete ps;
+		delete fs;
+		pt.h.destroy();
+		ft.h.destroy();
+		delete pa;
+		delete fa;
+		fclose(tf);
+		close(a[1]);
+		loop2.run();
+		kt.h.destroy();
+	}
+	TEST_CHECK(got == 100 || got == 101);
+	for (int fd : { a[0], b[0], b[1], c[0], c[1] }) close(fd);
 }
-int my_sscanf(const char* input, const char* format, ...) {
-	va_list args;
-	va_start(args, format);
-	return my_vsscanf(input, format, args);
+#endif
+#endif
+
+#if __cplusplus >= 202002L
+// scan<>：同一批随机输入上，返回值和每个输出都与 my_sscanf_s_n 相同
+static void test_scan_template() {
+	static const char alpha[] = "0123456789 \t+-.eE=xabf,\xC4\xE3";
+	unsigned seed = 9;
+	auto rnd = [&seed]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 16;
+	};
+	for (int it = 0; it < 30000; it++) {
+		std::string in;
+		size_t len = rnd() % 30;
+		for (size_t i = 0; i < len; i++) in += alpha[rnd() % (sizeof(alpha) - 1)];
+		{
+			int d1 = -1, d2 = -1, n1 = -1, n2 = -1;
+			char k1[8] = "?", k2[8] = "?";
+			unsigned x1 = 0, x2 = 0;
+			int r1 = my_sscanf_s_n(in.data(), in.size(), "%d %[^=]=%x%n", &d1, k1, sizeof(k1), &x1, &n1);
+			int r2 = scan<"%d %[^=]=%x%n">(in, d2, k2, x2, n2);
+			TEST_CHECK(r1 == r2 && d1 == d2 && strcmp(k1, k2) == 0 && x1 == x2 && n1 == n2);
+		}
+		{
+			double a1 = 0, a2 = 0;
+			float f1 = 0, f2 = 0;
+			char c1[3] = {}, c2[3] = {};
+			char s1[4] = "?", s2[4] = "?";
+			int r1 = my_sscanf_s_n(in.data(), in.size(), "%lf%c %3s %*d%f", &a1, c1, s1, sizeof(s1), &f1);
+			int r2 = scan<"%lf%c %3s %*d%f">(in, a2, c2, s2, f2);
+			TEST_CHECK(r1 == r2 && memcmp(&a1, &a2, sizeof(a1)) == 0 && memcmp(c1, c2, sizeof(c1)) == 0 &&
+				strcmp(s1, s2) == 0 && memcmp(&f1, &f2, sizeof(f1)) == 0);
+		}
+		{
+			unsigned char h1 = 0, h2 = 0;
+			long long q1 = 0, q2 = 0;
+			my_scanf_span v1 = {};
+			std::string_view v2;
+			std::string w2 = "?";
+			char w1[32] = "?";
+			int r1 = my_sscanf_s_n(in.data(), in.size(), "%hhu%lld,%V[0-9a-f] %s", &h1, &q1, &v1, w1, sizeof(w1));
+			int r2 = scan<"%hhu%lld,%V[0-9a-f] %s">(in, h2, q2, v2, w2);
+			TEST_CHECK(r1 == r2 && h1 == h2 && q1 == q2 && std::string_view(v1.ptr ? v1.ptr : "", v1.len) == v2);
+			if (r1 == 4) TEST_CHECK(w2 == w1);
+		}
+	}
+	// 出错位置也与 my_sscanf 相同
+	int d = 0;
+	scan<"%d,%d">("12x", d, d);
+	my_scanf_error e1 = *my_scanf_last_error();
+	my_sscanf("12x", "%d,%d", &d, &d);
+	const my_scanf_error* e2 = my_scanf_last_error();
+	TEST_CHECK(e1.code == e2->code && e1.spec == e2->spec && e1.input_off == e2->input_off && e1.format_off == e2->format_off);
 }
+#endif
 
-// 支持 GB2312 和扩展格式的 my_sscanf_s 函数，%s 和 %[...] 必须提供 sizeof(str)
-int my_vsscanf_s(const char* input, const char* format, va_list args) {
-	int count = 0;          // 成功解析的参数计数
-	const char* p = input;  // 输入字符串指针
-	const char* f = format; // 格式字符串指针
-	bool hasStar = false;
+// 整数：各长度修饰符的上下界和越界（越界为匹配失败，见 MY_SCANF_ERR_RANGE），以及字段宽度限制的数字个数
+static void test_ints() {
+	char lmax[32], lmin[32], lover[32], zmax[32], zover[32];
+	snprintf(lmax, sizeof(lmax), "%ld", LONG_MAX);
+	snprintf(lmin, sizeof(lmin), "%ld", LONG_MIN);
+	snprintf(lover, sizeof(lover), "%lu", (unsigned long)LONG_MAX + 1);
+	snprintf(zmax, sizeof(zmax), "%llu", (unsigned long long)SIZE_MAX);
+	snprintf(zover, sizeof(zover), "%llu0", (unsigned long long)SIZE_MAX);
+	struct {
+		const char* format;
+		const char* input;
+		int ret;
+		size_t size;           // 输出的字节数
+		unsigned long long bits; // 按 size 截断后的值
+		int used;              // %n，读取的字符数
+	} cases[] = {
+		{ "%hhd", "127", 1, 1, 0x7f, 3 },
+		{ "%hhd", "-128", 1, 1, 0x80, 4 },
+		{ "%hhd", "128", 0, 1, 0, 0 },
+		{ "%hhd", "-129", 0, 1, 0, 0 },
+		{ "%hhu", "255", 1, 1, 0xff, 3 },
+		{ "%hhu", "256", 0, 1, 0, 0 },
+		{ "%hhx", "ff", 1, 1, 0xff, 2 },
+		{ "%hhx", "100", 0, 1, 0, 0 },
+		{ "%hd", "32767", 1, 2, 0x7fff, 5 },
+		{ "%hd", "-32768", 1, 2, 0x8000, 6 },
+		{ "%hd", "32768", 0, 2, 0, 0 },
+		{ "%hu", "65535", 1, 2, 0xffff, 5 },
+		{ "%hu", "65536", 0, 2, 0, 0 },
+		{ "%d", "2147483647", 1, 4, 0x7fffffff, 10 },
+		{ "%d", "-2147483648", 1, 4, 0x80000000, 11 },
+		{ "%d", "2147483648", 0, 4, 0, 0 },
+		{ "%d", "-2147483649", 0, 4, 0, 0 },
+		{ "%i", "-017", 1, 4, 0xffffffef, 4 }, // %i 与 %d 相同，按十进制
+		{ "%u", "4294967295", 1, 4, 0xffffffff, 10 },
+		{ "%u", "4294967296", 0, 4, 0, 0 },
+		{ "%u", "-1", 1, 4, 0xffffffff, 2 },
+		{ "%x", "ffffffff", 1, 4, 0xffffffff, 8 },
+		{ "%x", "100000000", 0, 4, 0, 0 },
+		{ "%ld", lmax, 1, sizeof(long), (unsigned long long)LONG_MAX, (int)strlen(lmax) },
+		{ "%ld", lmin, 1, sizeof(long), (unsigned long long)(long long)LONG_MIN, (int)strlen(lmin) },
+		{ "%ld", lover, 0, sizeof(long), 0, 0 },
+		{ "%lld", "9223372036854775807", 1, 8, 0x7fffffffffffffffULL, 19 },
+		{ "%lld", "-9223372036854775808", 1, 8, 0x8000000000000000ULL, 20 },
+		{ "%lld", "9223372036854775808", 0, 8, 0, 0 },
+		{ "%lld", "-9223372036854775809", 0, 8, 0, 0 },
+		{ "%llu", "18446744073709551615", 1, 8, 0xffffffffffffffffULL, 20 },
+		{ "%llu", "18446744073709551616", 0, 8, 0, 0 },
+		{ "%llx", "ffffffffffffffff", 1, 8, 0xffffffffffffffffULL, 16 },
+		{ "%llx", "10000000000000000", 0, 8, 0, 0 },
+		{ "%I64d", "-9223372036854775808", 1, 8, 0x8000000000000000ULL, 20 },
+		{ "%I64d", "9223372036854775808", 0, 8, 0, 0 },
+		{ "%zu", zmax, 1, sizeof(size_t), (unsigned long long)SIZE_MAX, (int)strlen(zmax) },
+		{ "%zu", zover, 0, sizeof(size_t), 0, 0 },
+		// 字段宽度包括符号和 0x 前缀，前导零也计入
+		{ "%3d", "12345", 1, 4, 123, 3 },
+		{ "%2d", "-12", 1, 4, 0xffffffff, 2 },
+		{ "%1d", "-", 0, 4, 0, 0 },
+		{ "%3u", "+12", 1, 4, 12, 3 },
+		{ "%4x", "0x1f", 1, 4, 0x1f, 4 },
+		{ "%3x", "0x1f", 1, 4, 1, 3 },
+		{ "%10d", "00000000012", 1, 4, 1, 10 },
+		{ "%d", "000000000000000000000000000042", 1, 4, 42, 30 },
+		{ "%3hhd", "1270", 1, 1, 127, 3 },
+	};
+	for (const auto& c : cases) {
+		unsigned char v[16] = {};
+		int used = 0;
+		char fmt[32];
+		snprintf(fmt, sizeof(fmt), "%s%%n", c.format);
+		int r = my_sscanf(c.input, fmt, v, &used);
+		uint8_t b1;
+		uint16_t b2;
+		uint32_t b4;
+		uint64_t b8;
+		unsigned long long bits;
+		switch (c.size) {
+		case 1: memcpy(&b1, v, 1); bits = b1; break;
+		case 2: memcpy(&b2, v, 2); bits = b2; break;
+		case 4: memcpy(&b4, v, 4); bits = b4; break;
+		default: memcpy(&b8, v, 8); bits = b8; break;
+		}
+		TEST_CHECK(r == c.ret);
+		if (r == 1) TEST_CHECK(bits == c.bits && used == c.used);
+		else TEST_CHECK(bits == 0 && my_scanf_last_error()->code == (c.input[0] == '-' && !c.input[1] ? MY_SCANF_ERR_MATCH : MY_SCANF_ERR_RANGE));
+	}
+	// 越界的字段之后不再解析
+	int a = 0, b = 0;
+	unsigned char h = 0;
+	TEST_CHECK(my_sscanf("2147483648 5", "%d %d", &a, &b) == 0 && b == 0);
+	TEST_CHECK(my_sscanf("7 300 5", "%d %hhu %d", &a, &h, &b) == 1 && a == 7 && h == 0 && b == 0);
+}
 
-	while (*f && (hasStar || *p)) {
-		if (*f == '%') {
-			f++; // 跳过 %
+// 浮点数：非规格化数、舍入的中点、溢出、十六进制浮点等边界，以及一批随机数字串，
+// %f、%lf、%Lf 的结果和读取的长度与 C 库 strtof、strtod、strtold 逐位相同。
+// （glibc 的 sscanf 在 "1e"、"0x" 这类输入上多读取的字符无法退回，与 strtod 不同，不作对照）
+static bool test_same_float(long double a, long double b) {
+	return (a == b && signbit(a) == signbit(b)) || (a != a && b != b);
+}
 
-			// 检查 * 标志（跳过赋值）
-			int suppress = 0;
-			if (*f == '*') {
-				hasStar = true;
-				suppress = 1;
-				f++;
-			}
+static void test_floats() {
+	std::vector<std::string> inputs = {
+		"0", "-0", "1", "0.1", "3.14159", "1e10", "-2.5E-3", ".5", "5.", "+.5e+1",
+		// 非规格化数和下溢
+		"4.9406564584124654e-324", "2.4703282292062327e-324", "2.4703282292062328e-324", "2.2250738585072011e-308",
+		"2.2250738585072014e-308", "1e-320", "1e-400", "1.401298464324817e-45", "7e-46", "1.1754942e-38",
+		// 舍入的中点
+		"9007199254740993", "9007199254740995", "2.00000000000000011102230246251565404236316680908203125",
+		"1.00000000000000011102230246251565404236316680908203124", "16777217", "16777219", "0.500000000000000166533453693773481063544750213623046875",
+		"123456789012345678901234567890", "0.000000000000000000000000000000000000000000000000001",
+		// 溢出
+		"1.7976931348623157e308", "1.7976931348623158e308", "1.797693134862315808e308", "1e309", "-1e400",
+		"3.4028235e38", "3.4028236e38", "1e39", "1.18973149535723176502e4932", "1e5000",
+		// 十六进制浮点
+		"0x1p0", "0x1.8p1", "-0X1.FFFFFFFFFFFFFP1023", "0x1p-1074", "0x1p-1075", "0x1.0000000000001p-1022",
+		"0x1.00000000000008p0", "0x1.00000000000018p0", "0x.8p1", "0x1p", "0x", "0x1.fffffep127", "0x1p128",
+		// 特殊值和不完整的输入
+		"inf", "-INFINITY", "nan", "NaN(123)", "1e", "1e+", "-", ".", "e5",
+	};
+	unsigned seed = 6;
+	for (int i = 0; i < 5000; i++) {
+		std::string s;
+		seed = seed * 1103515245 + 12345;
+		int digits = 1 + (seed >> 16) % 25;
+		for (int k = 0; k < digits; k++) {
+			seed = seed * 1103515245 + 12345;
+			s += (char)('0' + (seed >> 16) % 10);
+			if (k == (int)((seed >> 8) % 30)) s += '.';
+		}
+		seed = seed * 1103515245 + 12345;
+		if ((seed >> 16) % 2) s += "e" + std::to_string((int)((seed >> 4) % 700) - 350);
+		inputs.push_back(s);
+	}
 
-			// 解析字段宽度
-			int width = parse_number(&f);
+	for (const std::string& in : inputs) {
+		const char* p = in.c_str();
+		char* e = NULL;
+		float f1 = strtof(p, &e), f2 = 0;
+		int n1 = (int)(e - p), n2 = -1;
+		TEST_CHECK(my_sscanf(p, "%f%n", &f2, &n2) == (n1 ? 1 : 0));
+		TEST_CHECK(!n1 || (test_same_float(f1, f2) && n1 == n2));
+		double d1 = strtod(p, &e), d2 = 0;
+		n1 = (int)(e - p);
+		TEST_CHECK(my_sscanf(p, "%lf%n", &d2, &n2) == (n1 ? 1 : 0));
+		TEST_CHECK(!n1 || (test_same_float(d1, d2) && n1 == n2));
+		long double l1 = strtold(p, &e), l2 = 0;
+		n1 = (int)(e - p);
+		TEST_CHECK(my_sscanf(p, "%Lf%n", &l2, &n2) == (n1 ? 1 : 0));
+		TEST_CHECK(!n1 || (test_same_float(l1, l2) && n1 == n2));
+	}
+}
 
-			// 解析精度（暂未使用）
-			int precision = -1;
-			if (*f == '.') {
-				f++;
-				if (*f == '*') {
-					precision = va_arg(args, int);
-					f++;
-				}
-				else {
-					precision = parse_number(&f);
-				}
-			}
+// CPU 分派：CPU 支持的每个级别的各个内核，在同一批随机输入上与 scalar 级别的结果逐项相同。
+// 输入复制到恰好大小的堆内存中，在 -fsanitize=address 下可发现越界读取
+static void test_isa_levels() {
+	static const char alpha[] = "  \t\n\r0123456789abcdefABCDEFxyz_-.,;[]^\xA1\xB0\xC4\xE3\xFE\x80\xFF";
+	const int levels = scan_isa_supported() + 1;
+	unsigned seed = 9;
+	auto rnd = [&seed]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 16;
+	};
+	for (int it = 0; it < 20000; it++) {
+		size_t len = rnd() % 300;
+		// 长段同类字符，向量化路径才会处理整块
+		std::vector<char> buf(len);
+		for (size_t i = 0; i < len; ) {
+			char c = alpha[rnd() % (sizeof(alpha) - 1)];
+			size_t run = rnd() % 4 ? 1 : rnd() % 80;
+			for (; run && i < len; run--) buf[i++] = c;
+		}
+		const char* p = buf.data();
+		scan_charset cs = {};
+		for (int c = 0; c < 256; c++) {
+			if (rnd() % 3 == 0) cs.raw[c >> 3] |= (uint8_t)(1 << (c & 7));
+		}
+		scan_charset_build(&cs, rnd() % 2);
 
-			// 检查长度修饰符
-			char length_mod[4] = { 0 }; // 支持 hh, h, l, ll, I64
-			if (*f == 'h') {
-				length_mod[0] = *f++;
-				if (*f == 'h') length_mod[1] = *f++; // hh
-			}
-			else if (*f == 'l') {
-				length_mod[0] = *f++;
-				if (*f == 'l') length_mod[1] = *f++; // ll
-			}
-			else if (*f == 'I' && *(f + 1) == '6' && *(f + 2) == '4') {
-				length_mod[0] = 'I';
-				length_mod[1] = '6';
-				length_mod[2] = '4';
-				f += 3; // I64
-			}
+		const scan_isa_table& ref = scan_isa_levels[0];
+		uint64_t rv = 0, v = 0;
+		int ro = 0, o = 0;
+		for (int l = 1; l < levels; l++) {
+			const scan_isa_table& t = scan_isa_levels[l];
+			TEST_CHECK(t.span_space(p, len) == ref.span_space(p, len));
+			TEST_CHECK(t.span_word(p, len) == ref.span_word(p, len));
+			TEST_CHECK(t.span_gb2312(p, len) == ref.span_gb2312(p, len));
+			TEST_CHECK(t.span_set(p, len, &cs) == ref.span_set(p, len, &cs));
+			TEST_CHECK(t.find_byte(p, len, '\n') == ref.find_byte(p, len, '\n'));
+			size_t skip = ref.span_space(p, len); // 数字从空白之后开始
+			TEST_CHECK(t.digits10(p + skip, p + len, &v, &o) == ref.digits10(p + skip, p + len, &rv, &ro) && v == rv && o == ro);
+			TEST_CHECK(t.digits16(p + skip, p + len, &v, &o) == ref.digits16(p + skip, p + len, &rv, &ro) && v == rv && o == ro);
+		}
+	}
+}
 
-			// 处理格式说明符
-			switch (*f) {
-			case 'd': case 'i': { // 有符号十进制整数
-				p = skip_whitespace(p);
-				char* end;
-				int64_t val = strtoll(p, &end, 10);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					if (strcmp(length_mod, "hh") == 0) {
-						*va_arg(args, signed char*) = (signed char)val;
-					}
-					else if (length_mod[0] == 'h') {
-						*va_arg(args, short*) = (short)val;
-					}
-					else if (strcmp(length_mod, "ll") == 0) {
-						*va_arg(args, long long*) = val;
-					}
-					else if (strcmp(length_mod, "I64") == 0) {
-						*va_arg(args, int64_t*) = val;
-					}
-					else if (length_mod[0] == 'l') {
-						*va_arg(args, long*) = (long)val;
-					}
-					else {
-						*va_arg(args, int*) = (int)val;
-					}
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'u': { // 无符号十进制整数
-				p = skip_whitespace(p);
-				char* end;
-				uint64_t val = strtoull(p, &end, 10);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					if (strcmp(length_mod, "hh") == 0) {
-						*va_arg(args, unsigned char*) = (unsigned char)val;
-					}
-					else if (length_mod[0] == 'h') {
-						*va_arg(args, unsigned short*) = (unsigned short)val;
-					}
-					else if (length_mod[0] == 'l') {
-						*va_arg(args, unsigned long*) = (unsigned long)val;
-					}
-					else {
-						*va_arg(args, unsigned int*) = (unsigned int)val;
-					}
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'x': case 'X': { // 十六进制整数
-				p = skip_whitespace(p);
-				char* end;
-				uint64_t val = strtoull(p, &end, 16);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					if (strcmp(length_mod, "ll") == 0) {
-						*va_arg(args, unsigned long long*) = val;
-					}
-					else if (length_mod[0] == 'l') {
-						*va_arg(args, unsigned long*) = (unsigned long)val;
-					}
-					else {
-						*va_arg(args, unsigned int*) = (unsigned int)val;
-					}
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'f': { // 浮点数
-				p = skip_whitespace(p);
-				char* end;
-				float val = strtof(p, &end);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					*va_arg(args, float*) = val;
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 'p': { // 指针地址（十六进制）
-				p = skip_whitespace(p);
-				if (!*p || (*p != '0' && *(p + 1) != 'x')) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				p += 2; // 跳过 "0x"
-				char* end;
-				uintptr_t val = (uintptr_t)strtoull(p, &end, 16);
-				if (end == p) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					*va_arg(args, void**) = (void*)val;
-					count++;
-				}
-				p = end;
-				break;
-			}
-			case 's': { // 字符串（支持 GB2312）
-				p = skip_whitespace(p);
-				if (!*p && !suppress) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					char* str = va_arg(args, char*);
-					size_t size = va_arg(args, size_t); // 必须提供缓冲区大小
-
-					size_t i = 0;
-					while (*p && !isspace((unsigned char)*p) &&
-						(width == 0 || i < (size_t)width) && i < size - 1) {
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1) && i + 1 < size - 1) {
-							str[i++] = *p++;
-							str[i++] = *p++;
-						}
-						else {
-							str[i++] = *p++;
-						}
-					}
-					str[i] = '\0';
-					if (i == 0) {
-						throw_format_error(input, format, p, f);
-						return count;
-					}
-					count++;
-				}
-				else {
-					int read = 0;
-					while (*p && !isspace((unsigned char)*p) && (width == 0 || width > 0)) {
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-							p += 2;
-							if (width) width -= 2;
-							read = 1;
-						}
-						else {
-							p++;
-							if (width) width--;
-							read = 1;
-						}
-					}
-					if (!read && *p) {
-						throw_format_error(input, format, p, f);
-						return count;
-					}
-				}
-				break;
-			}
-			case '[': { // 扫描集（支持 %[...] 和 %[^...]）
-				f++; // 跳过 [
-				int invert = 0;
-				if (*f == '^') {
-					invert = 1;
-					f++;
-				}
-				char charset[256] = { 0 };
-				int first = 1;
-				while (*f && (*f != ']' || first)) {
-					first = 0;
-					if (*f == '-' && !first && *(f + 1) != ']') {
-						char start = *(f - 1);
-						char end = *(f + 1);
-						for (char c = start; c <= end; c++) {
-							charset[(unsigned char)c] = 1;
-						}
-						f += 2;
-					}
-					else {
-						charset[(unsigned char)*f] = 1;
-						f++;
-					}
-				}
-				if (*f != ']') {
-					throw_format_error(input, format, p, f);
-					return 0;
-				}
-				f++; // 跳过 ]
+// 结构体扫描：结果与按成员写出长度修饰符的 my_sscanf_s 相同；成员类型或大小与说明符不符时创建失败
+struct test_rec {
+	signed char a;
+	unsigned short b;
+	int c;
+	long long d;
+	float f;
+	double g;
+	long double h;
+	char s[6];
+	my_scanf_span v;
+	char* m;
+	void* p;
+	char cc[3];
+	int n;
+};
 
-				if (!suppress) {
-					char* str = va_arg(args, char*);
-					size_t size = va_arg(args, size_t); // 必须提供缓冲区大小
-
-					size_t i = 0;
-					while (*p && (width == 0 || i < (size_t)width) && i < size - 1) {
-						int match = invert ? !charset[(unsigned char)*p] : charset[(unsigned char)*p];
-						if (!match) break;
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1) && i + 1 < size - 1) {
-							str[i++] = *p++;
-							str[i++] = *p++;
-						}
-						else {
-							str[i++] = *p++;
-						}
-					}
-					str[i] = '\0';
-					if (i > 0) {
-						count++;
-					}
-					else {
-						p = skip_whitespace(p);
-						while (*p && !isspace((unsigned char)*p) && charset[(unsigned char)*p]) {
-							p++;
-						}
-						p = skip_whitespace(p);
-					}
-				}
-				else {
-					int read = 0;
-					while (*p && (width == 0 || width > 0)) {
-						int match = invert ? !charset[(unsigned char)*p] : charset[(unsigned char)*p];
-						if (!match) break;
-						if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-							p += 2;
-							if (width) width -= 2;
-							read = 1;
-						}
-						else {
-							p++;
-							if (width) width--;
-							read = 1;
-						}
-					}
-					if (!read) {
-						p = skip_whitespace(p);
-						while (*p && !isspace((unsigned char)*p) && charset[(unsigned char)*p]) {
-							p++;
-						}
-						p = skip_whitespace(p);
-					}
-				}
-				break;
-			}
-			case 'c': { // 单个字符（支持 GB2312）
-				if (!*p && !suppress) {
-					throw_format_error(input, format, p, f);
-					return count;
-				}
-				if (!suppress) {
-					char* ch = va_arg(args, char*);
-					if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-						*ch++ = *p++;
-						*ch = *p++;
-					}
-					else {
-						*ch = *p++;
-					}
-					count++;
-				}
-				else {
-					if (is_gb2312_lead_byte((unsigned char)*p) && *(p + 1)) {
-						p += 2;
-					}
-					else {
-						p++;
-					}
-				}
-				break;
-			}
-			case 'n': { // 记录已读取的字符数
-				if (!suppress) {
-					*va_arg(args, int*) = (int)(p - input);
-				}
-				break;
-			}
-			case '%': {
-				if (*p++ != '%') {
-					throw_format_error(input, format, p - 1, f);
-					return count;
-				}
-				break;
-			}
-			default:
-				throw_format_error(input, format, p, f);
-				return count;
-			}
-			f++;
+static void test_schema() {
+	const char* format = "%d %u %x %d %f %f %f %s %V %ms %p %c%n";
+	const my_scan_field fields[] = {
+		MY_SCAN_FIELD(test_rec, a, MY_SCAN_INT),
+		MY_SCAN_FIELD(test_rec, b, MY_SCAN_INT),
+		MY_SCAN_FIELD(test_rec, c, MY_SCAN_INT),
+		MY_SCAN_FIELD(test_rec, d, MY_SCAN_INT),
+		MY_SCAN_FIELD(test_rec, f, MY_SCAN_FLOAT),
+		MY_SCAN_FIELD(test_rec, g, MY_SCAN_FLOAT),
+		MY_SCAN_FIELD(test_rec, h, MY_SCAN_FLOAT),
+		MY_SCAN_FIELD(test_rec, s, MY_SCAN_STR),
+		MY_SCAN_FIELD(test_rec, v, MY_SCAN_SPAN),
+		MY_SCAN_FIELD(test_rec, m, MY_SCAN_PTR),
+		MY_SCAN_FIELD(test_rec, p, MY_SCAN_PTR),
+		MY_SCAN_FIELD(test_rec, cc, MY_SCAN_STR),
+		MY_SCAN_FIELD(test_rec, n, MY_SCAN_INT),
+		MY_SCAN_FIELD(test_rec, n, MY_SCAN_INT),
+	};
+	const int nf = 13;
+	const my_scan_schema* schema = my_scan_schema_create(format, fields, nf);
+	TEST_CHECK(schema != NULL);
+	if (!schema) return;
+
+	static const char* const inputs[] = {
+		"-5 65535 7fffffff -9000000000 1.5 2.25 3.125 abcde key val 0x10Z",
+		"127 1 ff 1 1e-40 1e308 1e4000 abcdefgh \xC4\xE3 \xBA\xC3 0 \xC4\xE3",
+		"-128 65536",
+		"1 2 3 4 5 6 7 x",
+		"",
+	};
+	for (const char* in : inputs) {
+		test_rec r, e;
+		memset(&r, 0x55, sizeof(r));
+		memset(&e, 0x55, sizeof(e));
+		r.m = e.m = NULL;
+		int rr = my_scan_into(&r, schema, in);
+		int re = my_sscanf_s(in, "%hhd %hu %x %lld %f %lf %Lf %s %V %ms %p %c%n", &e.a, &e.b, &e.c, &e.d, &e.f, &e.g, &e.h,
+			e.s, sizeof(e.s), &e.v, &e.m, &e.p, e.cc, &e.n);
+		TEST_CHECK(rr == re && r.a == e.a && r.b == e.b && r.c == e.c && r.d == e.d);
+		TEST_CHECK(memcmp(&r.f, &e.f, sizeof(r.f)) == 0 && memcmp(&r.g, &e.g, sizeof(r.g)) == 0 && (r.h == e.h || rr < 7));
+		TEST_CHECK(memcmp(r.s, e.s, sizeof(r.s)) == 0 && r.v.ptr == e.v.ptr && r.v.len == e.v.len);
+		TEST_CHECK((r.m && e.m) ? strcmp(r.m, e.m) == 0 : r.m == e.m);
+		TEST_CHECK(r.p == e.p && memcmp(r.cc, e.cc, sizeof(r.cc)) == 0 && r.n == e.n);
+		free(r.m);
+		free(e.m);
+	}
+	test_rec rows[3] = {};
+	const char* const lines[] = { "1 2 3 4 5 6 7 s v m 0x1 c", "1 2", "8 9 a 4 5 6 7 s v m 0x1 c" };
+	TEST_CHECK(my_scan_into_array(rows, sizeof(test_rec), 3, schema, lines) == 2 && rows[2].c == 10 && rows[1].c == 0);
+	for (test_rec& r : rows) free(r.m);
+	my_scan_schema_free(schema);
+
+	// 逐个把一项改成不符的类型或大小
+	struct bad { int i; int type; size_t size; } const bads[] = {
+		{ 0, MY_SCAN_INT, 3 },            // 整数没有 3 字节
+		{ 0, MY_SCAN_FLOAT, 4 },          // %d 写入浮点成员
+		{ 4, MY_SCAN_INT, 4 },            // %f 写入整数成员
+		{ 4, MY_SCAN_FLOAT, 2 },          // 没有 2 字节的浮点数
+		{ 7, MY_SCAN_INT, 6 },            // %s 写入整数成员
+		{ 7, MY_SCAN_STR, 0 },            // 空缓冲区
+		{ 8, MY_SCAN_STR, 16 },           // %V 只能写入片段
+		{ 9, MY_SCAN_STR, 8 },            // %ms 写入指针
+		{ 10, MY_SCAN_PTR, 1 },           // %p 的成员不是指针大小
+		{ 11, MY_SCAN_STR, 1 },           // %c 至少 2 字节
+		{ 12, MY_SCAN_FLOAT, sizeof(double) }, // %n 写入浮点成员
+	};
+	for (const bad& b : bads) {
+		my_scan_field f[14];
+		memcpy(f, fields, sizeof(f));
+		f[b.i].type = b.type;
+		f[b.i].size = b.size;
+		TEST_CHECK(my_scan_schema_create(format, f, nf) == NULL);
+	}
+	// 字段个数与格式不符
+	TEST_CHECK(my_scan_schema_create(format, fields, nf - 1) == NULL);
+	TEST_CHECK(my_scan_schema_create(format, fields, nf + 1) == NULL);
+	TEST_CHECK(my_scan_schema_create(format, NULL, nf) == NULL);
+	TEST_CHECK(my_scan_schema_create(format, fields, -1) == NULL);
+	TEST_CHECK(my_scan_schema_create(NULL, fields, nf) == NULL);
+	// %K 只能写入 4 字节整数
+	my_scan_field k = { 0, MY_SCAN_INT, 8 };
+	TEST_CHECK(my_scan_schema_create("%K", &k, 1) == NULL);
+	k.size = 4;
+	schema = my_scan_schema_create("%K", &k, 1);
+	TEST_CHECK(schema != NULL);
+	my_scan_schema_free(schema);
+}
+
+// %ms 与区域：小字符串首尾相接地分配在初始缓冲区中，用完后追加块；重置后按同样的顺序复用，
+// 没有设置区域的线程和恢复 NULL 之后用 malloc 分配（由 free 释放，ASan 下可检查）
+static void test_arena() {
+	char buf[64];
+	my_scanf_arena* a = my_scanf_arena_create(buf, sizeof(buf));
+	TEST_CHECK(a != NULL);
+	if (!a) return;
+	TEST_CHECK(my_scanf_use_arena(a) == NULL);
+
+	char *s1 = NULL, *s2 = NULL;
+	TEST_CHECK(my_sscanf("host01 abc", "%ms %m[a-z]", &s1, &s2) == 2);
+	TEST_CHECK(s1 == buf && strcmp(s1, "host01") == 0 && s2 == buf + 7 && strcmp(s2, "abc") == 0);
+	TEST_CHECK(my_scanf_arena_used(a) == 11);
+	// 没有匹配时不分配，参数保持原值
+	s2 = NULL;
+	TEST_CHECK(my_sscanf("123", "%m[a-z]", &s2) == 0 && s2 == NULL && my_scanf_arena_used(a) == 11);
+
+	// 两轮按同样的顺序分配：第一轮超出初始缓冲区后追加块，第二轮重置后得到完全相同的地址
+	std::vector<char*> first;
+	std::string big(8000, 'x'); // 一轮共约 80KB，超过第一个追加块
+	for (int round = 0; round < 2; round++) {
+		my_scanf_arena_reset(a);
+		TEST_CHECK(my_scanf_arena_used(a) == 0);
+		size_t used = 0;
+		for (int i = 0; i < 100; i++) {
+			char* s = NULL;
+			const char* in = i % 10 ? "short" : big.c_str();
+			TEST_CHECK(my_sscanf(in, "%ms", &s) == 1 && s && strcmp(s, in) == 0);
+			used += strlen(in) + 1;
+			if (round == 0) first.push_back(s);
+			else TEST_CHECK(s == first[i]);
 		}
-		else {
-			if (isspace(*f)) {
-				f++;
-				p = skip_whitespace(p);
-			}
-			else {
-				if (*f++ != *p++) {
-					throw_format_error(input, format, p - 1, f - 1);
-					return count;
-				}
+		TEST_CHECK(my_scanf_arena_used(a) == used);
+		TEST_CHECK(first[0] < buf || first[0] >= buf + sizeof(buf)); // 8001 字节放不进初始缓冲区
+		TEST_CHECK(first[1] == first[0] + big.size() + 1);           // 之后的分配接在追加的块中
+	}
+
+	// 其他线程没有区域
+	std::thread t([] {
+		char* s = NULL;
+		TEST_CHECK(my_sscanf("thread", "%ms", &s) == 1 && strcmp(s, "thread") == 0);
+		free(s);
+	});
+	t.join();
+	size_t used = my_scanf_arena_used(a);
+
+	// 恢复 malloc
+	TEST_CHECK(my_scanf_use_arena(NULL) == a);
+	char* m = NULL;
+	TEST_CHECK(my_sscanf("heap", "%ms", &m) == 1 && strcmp(m, "heap") == 0 && (m < buf || m >= buf + sizeof(buf)));
+	TEST_CHECK(my_scanf_arena_used(a) == used);
+	free(m);
+	my_scanf_arena_free(a);
+
+	// 区域自己分配初始缓冲区；释放正在使用的区域后本线程恢复 malloc
+	a = my_scanf_arena_create(NULL, 128);
+	TEST_CHECK(a != NULL);
+	my_scanf_use_arena(a);
+	TEST_CHECK(my_sscanf("x y", "%ms %ms", &s1, &s2) == 2 && s2 == s1 + 2 && my_scanf_arena_used(a) == 4);
+	my_scanf_arena_free(a);
+	TEST_CHECK(my_scanf_use_arena(NULL) == NULL);
+}
+
+// %K：多个线程驻留同一批词，编号从 0 起连续，同一个词在所有线程中得到同一个编号，
+// 由编号取回的字符串与原词相同（跨越编号索引的多个段和哈希表扩容）；没有设置表时是格式错误
+static void test_intern() {
+	uint32_t id = 77;
+	my_scanf_intern* prev = my_scanf_set_intern(NULL);
+	TEST_CHECK(my_sscanf("abc", "%K", &id) == 0 && id == 77);
+	TEST_CHECK(my_scanf_last_error()->code == MY_SCANF_ERR_FORMAT);
+
+	my_scanf_intern* t = my_scanf_intern_create(4);
+	TEST_CHECK(t != NULL);
+	if (!t) {
+		my_scanf_set_intern(prev);
+		return;
+	}
+	// 预先登记的取值得到固定的编号；空字符串也可以登记
+	TEST_CHECK(my_scanf_intern_add(t, "ERROR", 5, &id) == 0 && id == 0);
+	TEST_CHECK(my_scanf_intern_add(t, "", 0, &id) == 0 && id == 1);
+	TEST_CHECK(my_scanf_intern_add(t, "ERROR", 5, &id) == 0 && id == 0);
+	TEST_CHECK(my_scanf_intern_add(t, NULL, 1, &id) == -1);
+	my_scanf_set_intern(t);
+
+	const int nwords = 5000;
+	std::vector<std::string> words;
+	for (int i = 0; i < nwords; i++) words.push_back((i % 3 ? "w" : "\xC4\xE3") + std::to_string(i * 7919 % 100003));
+	const int nthreads = 4;
+	std::vector<std::vector<uint32_t> > ids(nthreads, std::vector<uint32_t>(nwords));
+	std::vector<std::thread> th;
+	for (int k = 0; k < nthreads; k++) {
+		th.emplace_back([&, k] {
+			// 各线程按不同的顺序遇到这些词（步长与 nwords 互素），每个词出现两次
+			static const int step[] = { 1, 3, 7, 9 };
+			for (int r = 0; r < 2 * nwords; r++) {
+				int i = (r * step[k] + k * 101) % nwords;
+				std::string line = "x " + words[i] + " ERROR";
+				uint32_t a = 0, e = 0;
+				if (my_sscanf(line.c_str(), "%*s %K %K", &a, &e) != 2 || e != 0) g_test_failed++;
+				ids[k][i] = a;
 			}
+		});
+	}
+	for (std::thread& x : th) x.join();
+	TEST_CHECK(my_scanf_intern_count(t) == (uint32_t)nwords + 2);
+	std::vector<bool> seen(nwords + 2);
+	for (int i = 0; i < nwords; i++) {
+		uint32_t a = ids[0][i];
+		for (int k = 1; k < nthreads; k++) TEST_CHECK(ids[k][i] == a);
+		TEST_CHECK(a >= 2 && a < (uint32_t)nwords + 2 && !seen[a]);
+		if (a < seen.size()) seen[a] = true;
+		size_t len = 0;
+		const char* s = my_scanf_intern_str(t, a, &len);
+		TEST_CHECK(s && len == words[i].size() && memcmp(s, words[i].data(), len) == 0 && s[len] == '\0');
+		TEST_CHECK(my_scanf_intern_str(t, a, NULL) == s); // 同一份副本
+	}
+	TEST_CHECK(my_scanf_intern_str(t, (uint32_t)nwords + 2, NULL) == NULL);
+
+	// %K[...] 没有匹配时参数保持原值；my_sscanf_s 中 %K 不取缓冲区大小参数
+	id = 77;
+	TEST_CHECK(my_sscanf("123", "%K[a-z]", &id) == 0 && id == 77);
+	uint32_t a = 0, b = 0;
+	TEST_CHECK(my_sscanf_s(("ERROR " + words[1]).c_str(), "%K %K[a-z0-9]", &a, &b) == 2 && a == 0 && b == ids[0][1]);
+
+	my_scanf_set_intern(prev);
+	my_scanf_intern_free(t);
+}
+
+// %V：片段与同样宽度、同样字符集的 %s / %[...] 复制出的字符串相同，GB2312 双字节字符同样不拆开
+static void test_span() {
+	static const char* const fmts[][2] = {
+		{ "%V %3V", "%s %3s" },
+		{ "%V[a-z\xC4\xE3]%V", "%[a-z\xC4\xE3]%s" },
+		{ "%4V[^,],%V", "%4[^,],%s" },
+		{ "%*d%V[^ ]", "%*d%[^ ]" },
+		{ "%1V%2V", "%1s%2s" },
+		{ "%2V[^a]%5V[\x80-\xFF]", "%2[^a]%5[\x80-\xFF]" },
+	};
+	static const char alpha[] = "  ,az019\xC4\xE3\xB0\xA1\x80\xFF";
+	unsigned seed = 11;
+	auto rnd = [&seed]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 16;
+	};
+	for (int it = 0; it < 30000; it++) {
+		std::string in;
+		size_t len = rnd() % 16;
+		for (size_t i = 0; i < len; i++) in += alpha[rnd() % (sizeof(alpha) - 1)];
+		const char* const* f = fmts[it % (sizeof(fmts) / sizeof(fmts[0]))];
+		my_scanf_span sp[2] = {};
+		char s[2][32] = {};
+		int rv = my_sscanf_n(in.data(), in.size(), f[0], &sp[0], &sp[1]);
+		int rs = my_sscanf_n(in.data(), in.size(), f[1], s[0], s[1]);
+		TEST_CHECK(rv == rs);
+		for (int i = 0; i < rv && i < 2; i++) {
+			TEST_CHECK(sp[i].ptr >= in.data() && sp[i].ptr + sp[i].len <= in.data() + in.size());
+			TEST_CHECK(sp[i].len == strlen(s[i]) && memcmp(sp[i].ptr, s[i], sp[i].len) == 0);
 		}
 	}
 
-	va_end(args);
-	return count;
+	// 宽度在 GB2312 双字节字符中间结束时读完整个字符；结尾只有首字节时单独成为一个字符
+	const char* in = "\xC4\xE3\xBA\xC3x \xC4";
+	my_scanf_span a = {}, b = {}, c = {};
+	TEST_CHECK(my_sscanf(in, "%3V%V %V", &a, &b, &c) == 3);
+	TEST_CHECK(a.ptr == in && a.len == 4 && b.ptr == in + 4 && b.len == 1 && c.ptr == in + 6 && c.len == 1);
+	// %V[...] 没有匹配时计为失败，但片段仍写入（len 为 0）
+	a.len = 9;
+	TEST_CHECK(my_sscanf(in, "%V[0-9]", &a) == 0 && a.ptr == in && a.len == 0);
+	// my_sscanf_s 中 %V 不取缓冲区大小参数
+	char w[8];
+	TEST_CHECK(my_sscanf_s("ab cd", "%V %s", &a, w, sizeof(w)) == 2 && a.len == 2 && strcmp(w, "cd") == 0);
 }
-int my_sscanf_s(const char* input, const char* format, ...) {
-	va_list args;
-	va_start(args, format);
-	return my_vsscanf_s(input, format, args);
+
+#ifndef _WIN32
+// 映射文件扫描：普通文件走映射，FIFO 无法映射而改用记录读取器，两者逐行的结果都与整行 my_sscanf_n 相同
+struct test_line_out {
+	int d;
+	double x;
+	my_scanf_span s;
+	test_sink sink;
+};
+
+static int test_line_collect(void* ctx, int count, const char* line, size_t len) {
+	test_line_out* o = (test_line_out*)ctx;
+	void* fields[3] = { &o->d, &o->x, &o->s };
+	return test_collect(&o->sink, 0, count, fields, line, len);
 }
 
+static long long test_scan_mmap(const char* path, bool safe, size_t stop_at, std::vector<std::string>* got) {
+	test_line_out o = {};
+	o.sink.stop_at = stop_at;
+	long long r = safe ? my_scan_file_mmap_s(path, "%d %lf %V", test_line_collect, &o, &o.d, &o.x, &o.s)
+		: my_scan_file_mmap(path, "%d %lf %V", test_line_collect, &o, &o.d, &o.x, &o.s);
+	*got = o.sink.got;
+	return r;
+}
 
-// 从文件中解析当前一行的 my_fscanf，无需 sizeof(str)
-int my_fscanf(const FILE* fp, const char* format, ...) {
-	va_list args;
-	va_start(args, format);
-	int count = 0; // 当前行解析项数
-	char buffer[1024]; // 行缓冲区
+static void test_file_mmap() {
+	std::vector<std::string> lines;
+	std::string data = test_records(3000, &lines);
+	data += "\n5 6.5 tail"; // 空行和没有换行的最后一行
+	lines.push_back("");
+	lines.push_back("5 6.5 tail");
+	const std::vector<std::string> expect = test_expect(lines);
+	const char* path = test_write_file("my_scanf_test_mmap.tmp", data);
+	const char* fifo = "my_scanf_test_mmap.fifo";
+	remove(fifo);
+	TEST_CHECK(mkfifo(fifo, 0600) == 0);
 
-	// 文件指针必须有效
-	if (!fp) {
-		va_end(args);
-		return -1; // 文件无效，返回 -1
+	const size_t stops[] = { 0, 1, 100 };
+	for (size_t stop : stops) for (int safe = 0; safe < 2; safe++) {
+		std::vector<std::string> want(expect.begin(), stop ? expect.begin() + stop : expect.end());
+		std::vector<std::string> got;
+		TEST_CHECK(test_scan_mmap(path, safe, stop, &got) == (long long)want.size() && got == want);
+
+		// 提前停止后读端关闭，写端收到 EPIPE 后结束
+		std::thread writer([&] {
+			int fd = open(fifo, O_WRONLY);
+			if (fd < 0) return;
+			for (size_t off = 0; off < data.size(); ) {
+				ssize_t n = write(fd, data.data() + off, std::min<size_t>(4096, data.size() - off));
+				if (n <= 0) break;
+				off += (size_t)n;
+			}
+			close(fd);
+		});
+		TEST_CHECK(test_scan_mmap(fifo, safe, stop, &got) == (long long)want.size() && got == want);
+		writer.join();
 	}
 
-	// 读取当前行
-	if (fgets(buffer, sizeof(buffer), (FILE*)fp) == NULL) {
-		va_end(args);
-		return 0; // 读取失败或到达文件末尾，返回 0
+	std::vector<std::string> got;
+	TEST_CHECK(test_scan_mmap(test_write_file("my_scanf_test_mmap.tmp", ""), false, 0, &got) == 0 && got.empty());
+	remove(path);
+	remove(fifo);
+	TEST_CHECK(test_scan_mmap(path, false, 0, &got) == -1);
+}
+#endif
+
+#ifndef _WIN32
+// 按长度解析：记录紧贴在不可访问的页之前，任何越界读取都会使自测崩溃；
+// 结果与同一记录复制到普通缓冲区中的解析结果相同，各级内核在页尾的结果与 scalar 级别相同
+static void test_page_end() {
+	const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+	char* base = (char*)mmap(NULL, page * 2, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	TEST_CHECK(base != MAP_FAILED);
+	if (base == MAP_FAILED) return;
+	TEST_CHECK(mprotect(base + page, page, PROT_NONE) == 0);
+	char* end = base + page;
+
+	static const char* const fmts[] = { "%d %s%zn", "%lf%c%n", "%x %[^,],%d", "%s %lf %d", "%*s %i%n",
+		"%[a-z0-9 ]%zn", "%lld%hhd", "%d%%%d" };
+	static const char alpha[] = "0123456789  \t,.eEx+-abz%\xC4\xE3";
+	unsigned seed = 5;
+	auto rnd = [&seed]() {
+		seed = seed * 1103515245 + 12345;
+		return seed >> 16;
+	};
+	for (int it = 0; it < 20000; it++) {
+		size_t len = rnd() % 100;
+		char* p = end - len;
+		for (size_t i = 0; i < len; i++) p[i] = alpha[rnd() % (sizeof(alpha) - 1)];
+		std::string copy(p, len);
+		const char* fm = fmts[it % (sizeof(fmts) / sizeof(fmts[0]))];
+		union { int i; long long q; double d; size_t z; char s[128]; } ua[3], ub[3];
+		memset(ua, 0x55, sizeof(ua));
+		memset(ub, 0x55, sizeof(ub));
+		int ra = my_sscanf_n(p, len, fm, &ua[0], &ua[1], &ua[2]);
+		int rb = my_sscanf_n(copy.data(), len, fm, &ub[0], &ub[1], &ub[2]);
+		TEST_CHECK(ra == rb && memcmp(ua, ub, sizeof(ua)) == 0);
 	}
 
-	// 移除末尾换行符
-	size_t len = strlen(buffer);
-	if (len > 0 && buffer[len - 1] == '\n') {
-		buffer[len - 1] = '\0';
+	// 格式末尾的空白和 %zn 在输入用完后仍执行，得到整条记录的长度；%V 可以指到最后一个字节
+	static const char rec[] = "42 key=\xC4\xE3value  ";
+	const size_t rlen = sizeof(rec) - 1;
+	memcpy(end - rlen, rec, rlen);
+	int d = 0;
+	size_t n = 0;
+	my_scanf_span key = {}, val = {};
+	TEST_CHECK(my_sscanf_n(end - rlen, rlen, "%d %V[^=]=%V %zn", &d, &key, &val, &n) == 3);
+	TEST_CHECK(d == 42 && key.len == 3 && val.ptr == end - rlen + 7 && val.len == 7 && n == rlen);
+	memcpy(end - 3, "123", 3);
+	TEST_CHECK(my_sscanf_n(end - 3, 3, "%d%zn", &d, &n) == 1 && d == 123 && n == 3);
+
+	const int levels = scan_isa_supported() + 1;
+	scan_charset cs = {};
+	for (int c = 'a'; c <= 'z'; c++) cs.raw[c >> 3] |= (uint8_t)(1 << (c & 7));
+	scan_charset_build(&cs, 0);
+	const scan_isa_table& ref = scan_isa_levels[0];
+	for (size_t len = 0; len <= 200; len++) {
+		char* p = end - len;
+		for (size_t i = 0; i < len; i++) p[i] = alpha[rnd() % (sizeof(alpha) - 1)];
+		uint64_t rv = 0, v = 0;
+		int ro = 0, o = 0;
+		for (int l = 1; l < levels; l++) {
+			const scan_isa_table& t = scan_isa_levels[l];
+			TEST_CHECK(t.span_space(p, len) == ref.span_space(p, len));
+			TEST_CHECK(t.span_word(p, len) == ref.span_word(p, len));
+			TEST_CHECK(t.span_gb2312(p, len) == ref.span_gb2312(p, len));
+			TEST_CHECK(t.span_set(p, len, &cs) == ref.span_set(p, len, &cs));
+			TEST_CHECK(t.find_byte(p, len, '\n') == ref.find_byte(p, len, '\n'));
+			TEST_CHECK(t.digits10(p, end, &v, &o) == ref.digits10(p, end, &rv, &ro) && v == rv && o == ro);
+			TEST_CHECK(t.digits16(p, end, &v, &o) == ref.digits16(p, end, &rv, &ro) && v == rv && o == ro);
+		}
 	}
+	munmap(base, page * 2);
+}
+#endif
 
-	// 创建 va_list 副本
-	va_list args_copy;
-	va_copy(args_copy, args);
+// 格式缓存：多个线程轮流使用比缓存容量多的格式，不断淘汰和重新编译；
+// 出错时诊断回调中再调用 my_sscanf（嵌套进入读者纪元），外层正在使用的格式不能被回收
+static std::atomic<long> g_test_nested;
 
-	// 调用 my_sscanf 解析当前行
-	count = my_vsscanf(buffer, format, args_copy);
+static void test_cache_diag(void* ctx, const my_scanf_diag_info* info) {
+	(void)ctx;
+	char fmt[32], in[32];
+	for (int i = 0; i < 4; i++) {
+		long k = g_test_nested.fetch_add(1, std::memory_order_relaxed);
+		snprintf(fmt, sizeof(fmt), "n%ld=%%d,%%d", k % 2000);
+		snprintf(in, sizeof(in), "n%ld=%ld,7", k % 2000, k);
+		int a = -1, b = -1;
+		TEST_CHECK(my_sscanf(in, fmt, &a, &b) == 2 && a == (int)k && b == 7);
+	}
+	// 嵌套的调用返回后，外层的格式仍然有效
+	TEST_CHECK(info->format[0] == 'f' && strstr(info->format, " %d %d") != NULL);
+}
 
-	va_end(args_copy);
-	va_end(args);
-	return count;
+static void test_format_cache() {
+	const int formats = SCAN_CACHE_SETS * SCAN_CACHE_WAYS * 2 + 100;
+	std::atomic<int> bad(0);
+	g_test_nested = 0;
+	my_scanf_set_diag(test_cache_diag, NULL, 0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.push_back(std::thread([&, t] {
+			char fmt[32], in[64];
+			for (int round = 0; round < 3; round++) {
+				for (int i = 0; i < formats; i++) {
+					int k = (i * 7 + t * 131) % formats;
+					snprintf(fmt, sizeof(fmt), "f%d %%d %%d", k);
+					// 每 5 个输入中有一个第二个字段出错，触发诊断回调
+					if (i % 5 == 0) snprintf(in, sizeof(in), "f%d %d x", k, t);
+					else snprintf(in, sizeof(in), "f%d %d %d", k, t, i);
+					int a = -1, b = -1;
+					int r = my_sscanf(in, fmt, &a, &b);
+					if (i % 5 == 0 ? r != 1 || a != t : r != 2 || a != t || b != i) bad++;
+				}
+			}
+		}));
+	}
+	for (std::thread& th : threads) th.join();
+	my_scanf_set_diag(NULL, NULL, 0);
+	TEST_CHECK(bad == 0);
+	TEST_CHECK(g_test_nested == 4 * 4 * 3 * ((formats + 4) / 5));
 }
 
-// 从文件中解析当前一行的 my_fscanf_s，%s 和 %[...] 必须提供 sizeof(str)
-int my_fscanf_s(const FILE* fp, const char* format, ...) {
-	va_list args;
-	va_start(args, format);
-	int count = 0; // 当前行解析项数
-	char buffer[1024]; // 行缓冲区
+// 错误报告：各错误码的位置；诊断回调中的解析不改变外层错误，也不再次回调；回调按秒限流
+struct test_diag_state {
+	int calls;
+	unsigned long long dropped;
+	my_scanf_error seen;
+};
 
-	// 文件指针必须有效
-	if (!fp) {
-		va_end(args);
-		return -1; // 文件无效，返回 -1
+static void test_diag_hook(void* ctx, const my_scanf_diag_info* info) {
+	test_diag_state* st = (test_diag_state*)ctx;
+	st->calls++;
+	st->dropped += info->dropped;
+	st->seen = info->err;
+	// 回调中的解析成功和失败都不影响外层的错误
+	int x;
+	TEST_CHECK(my_sscanf("7", "%d", &x) == 1 && my_scanf_last_error()->code == MY_SCANF_ERR_NONE);
+	TEST_CHECK(my_sscanf("q", "%d", &x) == 0 && my_scanf_last_error()->code == MY_SCANF_ERR_MATCH);
+}
+
+static void test_errors() {
+	struct {
+		const char* input;
+		const char* format;
+		int ret, code, spec;
+		size_t input_off, format_off;
+	} cases[] = {
+		{ "12 34", "%d %d", 2, MY_SCANF_ERR_NONE, 0, 0, 0 },
+		{ "12", "%d %d", 1, MY_SCANF_ERR_INPUT, 1, 2, 4 },
+		{ "12x", "%d,%d", 1, MY_SCANF_ERR_LITERAL, 1, 2, 2 },
+		{ "1,2", "%d%%%d", 1, MY_SCANF_ERR_LITERAL, 1, 1, 3 },
+		{ "a", "%d", 0, MY_SCANF_ERR_MATCH, 0, 0, 1 },
+		{ "200", "%hhd", 0, MY_SCANF_ERR_RANGE, 0, 3, 3 },
+		{ "5 6", "%d %y", 1, MY_SCANF_ERR_FORMAT, 1, 2, 4 },
+		// MY_SCANF_ERR_NOMEM 需要分配失败，这里无法稳定触发
+	};
+	for (const auto& c : cases) {
+		int a = 0, b = 0;
+		TEST_CHECK(my_sscanf(c.input, c.format, &a, &b) == c.ret);
+		const my_scanf_error* e = my_scanf_last_error();
+		TEST_CHECK(e->code == c.code);
+		if (c.code != MY_SCANF_ERR_NONE) {
+			TEST_CHECK(e->spec == c.spec && e->input_off == c.input_off && e->format_off == c.format_off);
+		}
 	}
+	TEST_CHECK(strcmp(my_scanf_strerror(MY_SCANF_ERR_RANGE), "integer out of range") == 0);
+
+	// 回调中调用 my_sscanf：外层错误保持不变，回调中的失败不再回调
+	test_diag_state st = {};
+	my_scanf_set_diag(test_diag_hook, &st, 0);
+	int x = 0, y = 0;
+	TEST_CHECK(my_sscanf("12x", "%d,%d", &x, &y) == 1);
+	const my_scanf_error* e = my_scanf_last_error();
+	TEST_CHECK(st.calls == 1 && st.seen.code == MY_SCANF_ERR_LITERAL);
+	TEST_CHECK(e->code == MY_SCANF_ERR_LITERAL && e->spec == 1 && e->input_off == 2 && e->format_off == 2);
+
+	// 限流：每秒最多 3 次，其余计入下一次回调的 dropped
+	st = test_diag_state();
+	my_scanf_set_diag(test_diag_hook, &st, 3);
+	for (int i = 0; i < 20; i++) my_sscanf("q", "%d", &x);
+	int first = st.calls;
+	TEST_CHECK(first >= 3 && first <= 6); // 可能跨过一秒的边界
+	std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+	my_sscanf("q", "%d", &x);
+	TEST_CHECK(st.calls == first + 1 && st.dropped == (unsigned long long)(20 - first));
+	my_scanf_set_diag(NULL, NULL, 0);
+}
 
-	// 读取当前行
-	if (fgets(buffer, sizeof(buffer), (FILE*)fp) == NULL) {
-		va_end(args);
-		return 0; // 读取失败或到达文件末尾，返回 0
+// my_scan_batch：%n 不影响整行是否有效，位图跨 64 行的字边界，列按 SCAN_COLUMN_ALIGN 对齐
+static void test_batch() {
+	const my_scanf_format* fmt = my_scanf_compile("%d %hhd %s%n %lf");
+	TEST_CHECK(fmt != NULL);
+	if (!fmt) return;
+	const size_t n = 150;
+	std::vector<std::string> text(n);
+	std::vector<const char*> lines(n);
+	for (size_t r = 0; r < n; r++) {
+		char b[64];
+		if (r % 7 == 3) snprintf(b, sizeof(b), "%d %d w%d", (int)r, (int)(r % 100), (int)r); // 缺最后一个字段
+		else snprintf(b, sizeof(b), "%d %d w%d %d.5", (int)r, (int)(r % 100), (int)r, (int)r);
+		text[r] = b;
+		lines[r] = text[r].c_str();
 	}
 
-	// 移除末尾换行符
-	size_t len = strlen(buffer);
-	if (len > 0 && buffer[len - 1] == '\n') {
-		buffer[len - 1] = '\0';
+	void** cols = my_scan_columns_alloc(fmt, n);
+	TEST_CHECK(cols != NULL);
+	if (!cols) {
+		my_scanf_free(fmt);
+		return;
 	}
-	// 创建 va_list 副本
-	va_list args_copy;
-	va_copy(args_copy, args);
-	// 调用 my_sscanf_s 解析当前行
-	count = my_vsscanf_s(buffer, format, args_copy);
+	for (int i = 0; i < 5; i++) TEST_CHECK(cols[i] && (uintptr_t)cols[i] % SCAN_COLUMN_ALIGN == 0);
+	TEST_CHECK(cols[5] == NULL);
 
-	va_end(args);
-	return count;
+	uint64_t valid[(n + 63) / 64];
+	int counts[n];
+	long long full = my_scan_batch(fmt, lines.data(), NULL, n, cols, valid, counts);
+	long long expect_full = 0;
+	for (size_t r = 0; r < n; r++) {
+		bool ok = r % 7 != 3;
+		expect_full += ok;
+		TEST_CHECK(counts[r] == (ok ? 4 : 3));
+		TEST_CHECK(((valid[r / 64] >> (r % 64)) & 1) == (uint64_t)ok);
+		TEST_CHECK(((int*)cols[0])[r] == (int)r && ((signed char*)cols[1])[r] == (signed char)(r % 100));
+		const my_scanf_span* s = &((my_scanf_span*)cols[2])[r];
+		TEST_CHECK(std::string(s->ptr, s->len) == "w" + std::to_string(r));
+		TEST_CHECK(((int*)cols[3])[r] == (int)(s->ptr + s->len - lines[r]));
+		if (ok) TEST_CHECK(((double*)cols[4])[r] == r + 0.5);
+	}
+	TEST_CHECK(full == expect_full);
+	// 不需要位图和计数时可传 NULL
+	TEST_CHECK(my_scan_batch(fmt, lines.data(), NULL, n, cols, NULL, NULL) == expect_full);
+	my_scan_columns_free(cols);
+	my_scanf_free(fmt);
+}
+
+// my_fscanf_stream：只消耗格式匹配到的字符，之后的读取从正确位置继续
+static void test_fscanf_stream() {
+	FILE* f = tmpfile();
+	TEST_CHECK(f != NULL);
+	if (!f) return;
+	fputs("HDR 42 rest of line\nnext 3.5e2x \xC4\xE3\xBA\xC3 tail", f);
+	rewind(f);
+	char w[16], rest[64];
+	int d = 0, n = 0;
+	double x = 0;
+	TEST_CHECK(my_fscanf_stream_s(f, "%s %d%n", w, sizeof(w), &d, &n) == 2);
+	TEST_CHECK(strcmp(w, "HDR") == 0 && d == 42 && n == 6);
+	TEST_CHECK(fgets(rest, sizeof(rest), f) && strcmp(rest, " rest of line\n") == 0);
+	TEST_CHECK(my_fscanf_stream(f, "%s %lf", w, &x) == 2 && strcmp(w, "next") == 0 && x == 350);
+	TEST_CHECK(fgetc(f) == 'x');
+	// %V 是格式错误，不读取输入
+	my_scanf_span sp = {};
+	long pos = ftell(f);
+	TEST_CHECK(my_fscanf_stream(f, "%V", &sp) == 0 && ftell(f) == pos);
+	TEST_CHECK(my_scanf_last_error()->code == MY_SCANF_ERR_FORMAT && my_scanf_last_error()->spec == 0);
+	// 宽度按字符计，GB2312 双字节不会被截断
+	TEST_CHECK(my_fscanf_stream_s(f, " %2s", w, sizeof(w)) == 1 && strcmp(w, "\xC4\xE3") == 0);
+	TEST_CHECK(my_fscanf_stream(f, "%*s %s", w) == 1 && strcmp(w, "tail") == 0);
+	TEST_CHECK(my_fscanf_stream(f, "%d", &d) == EOF);
+	fclose(f);
+
+#ifndef _WIN32
+	// 与 glibc fscanf 对照返回值、结果和文件位置。字母表中不含 'x'、'e'，输入不超过 8 个字符：
+	// 十六进制浮点、"1e" 这类回退超过一个字符的情况以及整数溢出，两者的约定本来就不同
+	static const char* const fmts[] = { "%d %s", "%d%c%d", "%lf %[a-z]%n", "%x,%d", "%*d %3s %lf", "%[a-z]%d",
+		"%s%n", "%5d%d", "%lf%lf", "%d.%d", "%c%c%c", "%*[a-z] %d" };
+	static const char alpha[] = "0123456789 abcyz.,+-\t\n";
+	unsigned seed = 3;
+	for (int it = 0; it < 20000; it++) {
+		char in[16];
+		seed = seed * 1103515245 + 12345;
+		int len = (seed >> 16) % 9;
+		for (int i = 0; i < len; i++) {
+			seed = seed * 1103515245 + 12345;
+			in[i] = alpha[(seed >> 16) % (sizeof(alpha) - 1)];
+		}
+		in[len] = 0;
+		const char* fm = fmts[it % (sizeof(fmts) / sizeof(fmts[0]))];
+		// fmemopen 不接受长度 0，空输入先读掉一个字符
+		FILE* a = fmemopen(in, len ? len : 1, "r");
+		FILE* b = fmemopen(in, len ? len : 1, "r");
+		if (!len) {
+			fgetc(a);
+			fgetc(b);
+		}
+		union { int i; double d; char s[32]; } ua[3], ub[3];
+		memset(ua, 0x55, sizeof(ua));
+		memset(ub, 0x55, sizeof(ub));
+		int ra = fscanf(a, fm, &ua[0], &ua[1], &ua[2]);
+		int rb = my_fscanf_stream(b, fm, &ub[0], &ub[1], &ub[2]);
+		TEST_CHECK(ra == rb && ftell(a) == ftell(b) && memcmp(ua, ub, sizeof(ua)) == 0);
+		fclose(a);
+		fclose(b);
+	}
+#endif
+}
+
+static int scan_selftest() {
+	printf("format cache\n");
+	test_format_cache();
+#if __cplusplus >= 202002L
+	printf("scan<>\n");
+	test_scan_template();
+#endif
+	printf("integers\n");
+	test_ints();
+	printf("floats\n");
+	test_floats();
+	printf("span\n");
+	test_span();
+	printf("schema\n");
+	test_schema();
+	printf("arena\n");
+	test_arena();
+	printf("intern\n");
+	test_intern();
+	printf("isa levels\n");
+	test_isa_levels();
+	printf("batch\n");
+	test_batch();
+	printf("fscanf stream\n");
+	test_fscanf_stream();
+	printf("errors\n");
+	test_errors();
+	printf("readahead reader\n");
+	test_readahead();
+	printf("parallel scan\n");
+	test_parallel();
+#ifndef _WIN32
+	signal(SIGPIPE, SIG_IGN); // 提前停止后管道的写端会收到 EPIPE
+	printf("mmap file\n");
+	test_file_mmap();
+	printf("page end\n");
+	test_page_end();
+	printf("stream fragments\n");
+	test_stream_fragments();
+	printf("pipeline\n");
+	test_pipeline();
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine) && defined(__linux__)
+	printf("async\n");
+	test_async();
+#endif
+#endif
+	int failed = g_test_failed.load();
+	printf(failed ? "%d check(s) failed\n" : "all passed\n", failed);
+	return failed;
 }
+#endif
 
 
 // 测试代码
 int main() {
+#ifdef MY_SCANF_BENCH
+	scan_bench();
+	return 0;
+#endif
+#ifdef MY_SCANF_TEST
+	return scan_selftest() ? 1 : 0;
+#endif
+
+	// 演示程序把匹配失败输出到 stderr
+	my_scanf_set_diag(my_scanf_diag_stderr, NULL, 0);
 
 	FILE* fp = fopen("test.txt", "r");
 	if (!fp) {